@@ -0,0 +1,695 @@
+//
+// Thread-safe binary buddy allocator working on an explicit handle
+// addresses are offsets into a pool of mPoolSize bytes made of mPoolSize / mMaxBlock roots, blocks are split down to
+// mMinBlock. Free blocks of each order are kept in lists linked through arrays indexed by block number, so finding the
+// buddy of a freed block and unlinking it are O(1).
+// The small orders can be served from per-thread caches that never take the shared lock.
+// In lazy mode freed blocks are parked in per-order stacks without merging and handed out again as they are, they are
+// only merged when an allocation fails or an order crosses its watermark.
+// All bookkeeping lives in one anonymous mapping that is touched lazily and never comes from malloc, so the allocator
+// can back malloc itself.
+//
+
+#ifndef SRTN_BUDDY_BUDDYALLOCATOR_H
+#define SRTN_BUDDY_BUDDYALLOCATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define BUDDY_MAX_ORDERS 31
+#define BUDDY_CACHE_ORDERS 4 //the smallest orders can have a per-thread cache
+#define BUDDY_CACHE_DEPTH 32 //blocks kept per cached order and thread
+#define BUDDY_MAX_HANDLES 8 //live allocators with per-thread caches at the same time
+#define BUDDY_BATCH 64 //BuddyAllocMany sorts its requests in chunks of this many
+
+typedef struct BuddyAllocator {
+    pthread_mutex_t mLock;
+    int mPoolSize;
+    int mMinBlock;
+    int mMaxBlock;
+    int mMinShift; //log2(mMinBlock)
+    int mOrders; //number of block sizes from mMinBlock to mMaxBlock
+    int mBlocks; //number of mMinBlock blocks in the pool
+    int *mpNext; //free list links, indexed by block number (address / mMinBlock)
+    int *mpPrev;
+    int *mpWork; //scratch links for walking a batch of freed blocks while they are pushed and merged
+    unsigned char *mpFreeTag; //order + 1 of the free block starting at this block number, 0 if none starts here
+    unsigned char *mpAllocTag; //order + 1 of the allocated block starting at this block number, 0 if none starts here
+    size_t mMapSize; //size of the mapping holding this struct and the arrays above
+    int mHeads[BUDDY_MAX_ORDERS]; //first free block number of each order, -1 if the order is empty
+    unsigned int mNonEmpty; //bit k is set if order k has a free block, finds the order to split in one step
+    int mFreeCount[BUDDY_MAX_ORDERS]; //blocks in the free list of each order
+    int mFreeMem; //bytes sitting in the shared free lists and the lazy stacks
+    int mLazyWatermark; //lazy blocks an order may hold before they are merged, 0 merges eagerly
+    int mLazyHeads[BUDDY_MAX_ORDERS]; //stacks of freed but unmerged blocks, linked through mpNext
+    int mLazyCount[BUDDY_MAX_ORDERS];
+    unsigned long mSplits;
+    unsigned long mMerges;
+    unsigned long mSplitsAvoided; //splits a lazy hit did not need
+    unsigned long mMergesAvoided; //merges a lazy free did not do
+    int mCacheOrders; //orders below this one use per-thread caches, 0 disables caching
+    int mSlot; //index of this allocator in the per-thread cache table
+    unsigned long mSerial; //tells a cache slot of a destroyed allocator from one of its successor
+    pthread_key_t mCacheKey; //flushes the cache of a thread when it exits
+} BuddyAllocator;
+
+typedef struct BuddyStats {
+    unsigned long mSplits;
+    unsigned long mMerges;
+    unsigned long mSplitsAvoided;
+    unsigned long mMergesAvoided;
+} BuddyStats;
+
+typedef struct BuddyCache {
+    unsigned long mSerial; //serial of the allocator owning this slot, 0 if unused
+    BuddyAllocator *mpOwner;
+    int mCount[BUDDY_CACHE_ORDERS];
+    int mBlocks[BUDDY_CACHE_ORDERS][BUDDY_CACHE_DEPTH];
+} BuddyCache;
+
+__thread BuddyCache tBuddyCaches[BUDDY_MAX_HANDLES] __attribute__((tls_model("initial-exec")));
+BuddyAllocator *gpBuddyHandles[BUDDY_MAX_HANDLES];
+unsigned long gBuddySerial = 0;
+pthread_mutex_t gBuddyHandlesLock = PTHREAD_MUTEX_INITIALIZER;
+
+void BuddyFlushCache(BuddyAllocator *);
+
+void BuddyCacheDestructor(void *);
+
+int BuddyOrderSize(const BuddyAllocator *pBuddy, int order) {
+    return pBuddy->mMinBlock << order;
+}
+
+/*
+** int order = BuddyOrderOf(const BuddyAllocator *pBuddy, int size)
+** smallest order whose blocks fit size, may be >= mOrders if size is larger than a root
+*/
+int BuddyOrderOf(const BuddyAllocator *pBuddy, int size) {
+    if (size <= pBuddy->mMinBlock)
+        return 0;
+    return 32 - __builtin_clz((unsigned int) (size - 1)) - pBuddy->mMinShift;
+}
+
+void BuddyPush(BuddyAllocator *pBuddy, int block, int order) {
+    int head = pBuddy->mHeads[order];
+    pBuddy->mpNext[block] = head;
+    pBuddy->mpPrev[block] = -1;
+    if (head != -1)
+        pBuddy->mpPrev[head] = block;
+    pBuddy->mHeads[order] = block;
+    pBuddy->mNonEmpty |= 1u << order;
+    pBuddy->mpFreeTag[block] = (unsigned char) (order + 1);
+    pBuddy->mFreeCount[order]++;
+    pBuddy->mFreeMem += BuddyOrderSize(pBuddy, order);
+}
+
+void BuddyUnlink(BuddyAllocator *pBuddy, int block, int order) {
+    int next = pBuddy->mpNext[block], prev = pBuddy->mpPrev[block];
+    if (prev != -1)
+        pBuddy->mpNext[prev] = next;
+    else if ((pBuddy->mHeads[order] = next) == -1)
+        pBuddy->mNonEmpty &= ~(1u << order);
+    if (next != -1)
+        pBuddy->mpPrev[next] = prev;
+    pBuddy->mpFreeTag[block] = 0;
+    pBuddy->mFreeCount[order]--;
+    pBuddy->mFreeMem -= BuddyOrderSize(pBuddy, order);
+}
+
+/*
+** BuddyAllocator *pBuddy = BuddyCreate(int pool_size, int min_block, int max_block, int cache_orders)
+** create an allocator for a pool of pool_size bytes made of max_block roots, blocks are never split below min_block
+** min_block and max_block must be powers of 2 and pool_size a multiple of max_block
+** cache_orders is the number of small orders served from per-thread caches, 0 for a single threaded user
+** returns NULL if the parameters are invalid or memory is exhausted
+*/
+BuddyAllocator *BuddyCreate(int pool_size, int min_block, int max_block, int cache_orders) {
+    if (min_block <= 0 || (min_block & (min_block - 1)) || (max_block & (max_block - 1)) || max_block < min_block ||
+        pool_size % max_block)
+        return NULL;
+    int blocks = pool_size / min_block;
+    int orders = __builtin_ctz((unsigned int) max_block) - __builtin_ctz((unsigned int) min_block) + 1;
+    if (orders > BUDDY_MAX_ORDERS)
+        return NULL;
+    //one zero filled mapping for the handle and every array, zero means "no block starts here" for both tag arrays
+    size_t header = (sizeof(BuddyAllocator) + 63) & ~(size_t) 63;
+    size_t map_size = header + (size_t) blocks * (3 * sizeof(int) + 2);
+    char *pMap = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (pMap == MAP_FAILED)
+        return NULL;
+    BuddyAllocator *pBuddy = (BuddyAllocator *) pMap;
+    pBuddy->mMapSize = map_size;
+    pBuddy->mpNext = (int *) (pMap + header);
+    pBuddy->mpPrev = pBuddy->mpNext + blocks;
+    pBuddy->mpWork = pBuddy->mpPrev + blocks;
+    pBuddy->mpFreeTag = (unsigned char *) (pBuddy->mpWork + blocks);
+    pBuddy->mpAllocTag = pBuddy->mpFreeTag + blocks;
+    pBuddy->mPoolSize = pool_size;
+    pBuddy->mMinBlock = min_block;
+    pBuddy->mMaxBlock = max_block;
+    pBuddy->mMinShift = __builtin_ctz((unsigned int) min_block);
+    pBuddy->mOrders = orders;
+    pBuddy->mBlocks = blocks;
+    pBuddy->mCacheOrders = cache_orders < BUDDY_CACHE_ORDERS ? cache_orders : BUDDY_CACHE_ORDERS;
+    if (pBuddy->mCacheOrders > pBuddy->mOrders)
+        pBuddy->mCacheOrders = pBuddy->mOrders;
+    for (int i = 0; i < BUDDY_MAX_ORDERS; ++i)
+        pBuddy->mHeads[i] = pBuddy->mLazyHeads[i] = -1;
+    //push the roots from the highest address down so the lowest address ends up at the head
+    int root_blocks = max_block / min_block;
+    for (int block = pBuddy->mBlocks - root_blocks; block >= 0; block -= root_blocks)
+        BuddyPush(pBuddy, block, pBuddy->mOrders - 1);
+    pthread_mutex_init(&pBuddy->mLock, NULL);
+
+    pBuddy->mSlot = -1;
+    if (pBuddy->mCacheOrders) { //claim a slot in the per-thread cache table
+        pthread_mutex_lock(&gBuddyHandlesLock);
+        for (int i = 0; i < BUDDY_MAX_HANDLES; ++i) {
+            if (!gpBuddyHandles[i]) {
+                gpBuddyHandles[i] = pBuddy;
+                pBuddy->mSlot = i;
+                pBuddy->mSerial = ++gBuddySerial;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&gBuddyHandlesLock);
+        if (pBuddy->mSlot == -1) //table full, run without caches
+            pBuddy->mCacheOrders = 0;
+        else
+            pthread_key_create(&pBuddy->mCacheKey, BuddyCacheDestructor);
+    }
+    return pBuddy;
+}
+
+/*
+** void BuddyDestroy(BuddyAllocator *pBuddy)
+** release the allocator, blocks still cached by other threads are simply dropped
+*/
+void BuddyDestroy(BuddyAllocator *pBuddy) {
+    if (pBuddy->mSlot != -1) {
+        pthread_key_delete(pBuddy->mCacheKey);
+        pthread_mutex_lock(&gBuddyHandlesLock);
+        gpBuddyHandles[pBuddy->mSlot] = NULL;
+        pthread_mutex_unlock(&gBuddyHandlesLock);
+    }
+    pthread_mutex_destroy(&pBuddy->mLock);
+    munmap(pBuddy, pBuddy->mMapSize);
+}
+
+/*
+** BuddyAllocator *pCopy = BuddyClone(BuddyAllocator *pBuddy)
+** independent copy of the allocator state, used to try a sequence of operations before doing it for real
+** the copy has no per-thread caches, blocks cached by threads of the original stay allocated in it
+*/
+BuddyAllocator *BuddyClone(BuddyAllocator *pBuddy) {
+    char *pMap = mmap(NULL, pBuddy->mMapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1,
+                      0);
+    if (pMap == MAP_FAILED)
+        return NULL;
+    pthread_mutex_lock(&pBuddy->mLock);
+    memcpy(pMap, pBuddy, pBuddy->mMapSize);
+    pthread_mutex_unlock(&pBuddy->mLock);
+    BuddyAllocator *pCopy = (BuddyAllocator *) pMap;
+    pCopy->mpNext = (int *) (pMap + ((char *) pBuddy->mpNext - (char *) pBuddy));
+    pCopy->mpPrev = pCopy->mpNext + pCopy->mBlocks;
+    pCopy->mpWork = pCopy->mpPrev + pCopy->mBlocks;
+    pCopy->mpFreeTag = (unsigned char *) (pCopy->mpWork + pCopy->mBlocks);
+    pCopy->mpAllocTag = pCopy->mpFreeTag + pCopy->mBlocks;
+    pCopy->mCacheOrders = 0;
+    pCopy->mSlot = -1;
+    pthread_mutex_init(&pCopy->mLock, NULL);
+    return pCopy;
+}
+
+/*
+** BuddyCache *pCache = BuddyThreadCache(BuddyAllocator *pBuddy)
+** cache of the calling thread for this allocator, set up on first use
+*/
+BuddyCache *BuddyThreadCache(BuddyAllocator *pBuddy) {
+    BuddyCache *pCache = &tBuddyCaches[pBuddy->mSlot];
+    if (pCache->mSerial != pBuddy->mSerial) { //first use by this thread, or left over from a destroyed allocator
+        for (int i = 0; i < BUDDY_CACHE_ORDERS; ++i)
+            pCache->mCount[i] = 0;
+        pCache->mSerial = pBuddy->mSerial;
+        pCache->mpOwner = pBuddy;
+        pthread_setspecific(pBuddy->mCacheKey, pCache); //so the cache is flushed when the thread exits
+    }
+    return pCache;
+}
+
+/*
+** int addr = BuddyAllocLocked(BuddyAllocator *pBuddy, int order)
+** take a block of the given order from the shared lists, splitting a larger one if needed, -1 if none is free
+** the caller holds the lock
+*/
+int BuddyAllocLocked(BuddyAllocator *pBuddy, int order) {
+    unsigned int fits = pBuddy->mNonEmpty >> order; //orders from this one up that have a free block
+    if (!fits)
+        return -1;
+    int found = order + __builtin_ctz(fits);
+    int block = pBuddy->mHeads[found];
+    BuddyUnlink(pBuddy, block, found);
+    while (found != order) { //split down, the upper half of every split goes back to the free lists
+        found--;
+        BuddyPush(pBuddy, block + (1 << found), found);
+        pBuddy->mSplits++;
+    }
+    pBuddy->mpAllocTag[block] = (unsigned char) (order + 1);
+    return block << pBuddy->mMinShift;
+}
+
+/*
+** void BuddyFreeLocked(BuddyAllocator *pBuddy, int block, int order)
+** put a block back into the shared lists, merging it with its buddy as long as the buddy is free
+** the caller holds the lock
+*/
+void BuddyFreeLocked(BuddyAllocator *pBuddy, int block, int order) {
+    while (order < pBuddy->mOrders - 1) { //roots never merge
+        int buddy = block ^ (1 << order);
+        if (pBuddy->mpFreeTag[buddy] != order + 1)
+            break;
+        BuddyUnlink(pBuddy, buddy, order);
+        if (buddy < block)
+            block = buddy;
+        order++;
+        pBuddy->mMerges++;
+    }
+    BuddyPush(pBuddy, block, order);
+}
+
+/*
+** int merges = BuddyMergeDepth(BuddyAllocator *pBuddy, int block, int order)
+** number of merges freeing this block right now would do, without doing them
+*/
+int BuddyMergeDepth(BuddyAllocator *pBuddy, int block, int order) {
+    int depth = 0;
+    while (order < pBuddy->mOrders - 1 && pBuddy->mpFreeTag[block ^ (1 << order)] == order + 1) {
+        block &= ~(1 << order);
+        order++;
+        depth++;
+    }
+    return depth;
+}
+
+/*
+** void BuddyLazyFlushOrder(BuddyAllocator *pBuddy, int order)
+** merge every lazy block of this order into the free lists, the caller holds the lock
+*/
+void BuddyLazyFlushOrder(BuddyAllocator *pBuddy, int order) {
+    while (pBuddy->mLazyHeads[order] != -1) {
+        int block = pBuddy->mLazyHeads[order];
+        pBuddy->mLazyHeads[order] = pBuddy->mpNext[block];
+        pBuddy->mLazyCount[order]--;
+        pBuddy->mFreeMem -= BuddyOrderSize(pBuddy, order); //BuddyPush adds it back
+        BuddyFreeLocked(pBuddy, block, order);
+    }
+}
+
+/*
+** int flushed = BuddyLazyFlush(BuddyAllocator *pBuddy)
+** merge every lazy block, smallest orders first so merged blocks can keep merging, return 0 if there was none
+** the caller holds the lock
+*/
+int BuddyLazyFlush(BuddyAllocator *pBuddy) {
+    int flushed = 0;
+    for (int order = 0; order < pBuddy->mOrders; ++order) {
+        flushed |= pBuddy->mLazyCount[order] != 0;
+        BuddyLazyFlushOrder(pBuddy, order);
+    }
+    return flushed;
+}
+
+/*
+** void BuddyFreeLazy(BuddyAllocator *pBuddy, int block, int order)
+** park a freed block on the lazy stack of its order, merging the whole stack first if it reached the watermark
+** the caller holds the lock
+*/
+void BuddyFreeLazy(BuddyAllocator *pBuddy, int block, int order) {
+    if (pBuddy->mLazyCount[order] >= pBuddy->mLazyWatermark)
+        BuddyLazyFlushOrder(pBuddy, order);
+    int depth = BuddyMergeDepth(pBuddy, block, order);
+    pBuddy->mMergesAvoided += depth;
+    pBuddy->mpPrev[block] = depth; //remembered so a hit can count the splits it saves
+    pBuddy->mpNext[block] = pBuddy->mLazyHeads[order];
+    pBuddy->mLazyHeads[order] = block;
+    pBuddy->mLazyCount[order]++;
+    pBuddy->mFreeMem += BuddyOrderSize(pBuddy, order);
+}
+
+/*
+** int addr = BuddyAllocLazy(BuddyAllocator *pBuddy, int order)
+** allocate preferring a lazy block of the exact order, merging all lazy blocks if nothing else fits
+** the caller holds the lock
+*/
+int BuddyAllocLazy(BuddyAllocator *pBuddy, int order) {
+    int block = pBuddy->mLazyHeads[order];
+    if (block != -1) {
+        pBuddy->mLazyHeads[order] = pBuddy->mpNext[block];
+        pBuddy->mLazyCount[order]--;
+        pBuddy->mFreeMem -= BuddyOrderSize(pBuddy, order);
+        pBuddy->mSplitsAvoided += pBuddy->mpPrev[block];
+        pBuddy->mpAllocTag[block] = (unsigned char) (order + 1);
+        return block << pBuddy->mMinShift;
+    }
+    int addr = BuddyAllocLocked(pBuddy, order);
+    if (addr == -1 && BuddyLazyFlush(pBuddy)) //the lazy blocks may merge into what we need
+        addr = BuddyAllocLocked(pBuddy, order);
+    return addr;
+}
+
+/*
+** void BuddySetLazy(BuddyAllocator *pBuddy, int watermark)
+** switch lazy merging on with a per-order watermark, or off with 0 which merges every parked block
+*/
+void BuddySetLazy(BuddyAllocator *pBuddy, int watermark) {
+    pthread_mutex_lock(&pBuddy->mLock);
+    pBuddy->mLazyWatermark = watermark > 0 ? watermark : 0;
+    if (!pBuddy->mLazyWatermark)
+        BuddyLazyFlush(pBuddy);
+    pthread_mutex_unlock(&pBuddy->mLock);
+}
+
+/*
+** int addr = BuddyAlloc(BuddyAllocator *pBuddy, int size)
+** allocate the smallest block that fits size, return its address or -1 if no block is available
+*/
+int BuddyAlloc(BuddyAllocator *pBuddy, int size) {
+    int order = BuddyOrderOf(pBuddy, size);
+    if (order >= pBuddy->mOrders || size <= 0)
+        return -1;
+
+    BuddyCache *pCache = NULL;
+    if (order < pBuddy->mCacheOrders) {
+        pCache = BuddyThreadCache(pBuddy);
+        if (pCache->mCount[order]) { //cache hit, no lock needed
+            int block = pCache->mBlocks[order][--pCache->mCount[order]];
+            pBuddy->mpAllocTag[block] = (unsigned char) (order + 1);
+            return block << pBuddy->mMinShift;
+        }
+    }
+
+    pthread_mutex_lock(&pBuddy->mLock);
+    int addr = pBuddy->mLazyWatermark ? BuddyAllocLazy(pBuddy, order) : BuddyAllocLocked(pBuddy, order);
+    pthread_mutex_unlock(&pBuddy->mLock);
+    if (addr == -1 && pCache) { //blocks parked in our own cache may merge into what we need
+        BuddyFlushCache(pBuddy);
+        pthread_mutex_lock(&pBuddy->mLock);
+        addr = pBuddy->mLazyWatermark ? BuddyAllocLazy(pBuddy, order) : BuddyAllocLocked(pBuddy, order);
+        pthread_mutex_unlock(&pBuddy->mLock);
+    }
+    return addr;
+}
+
+/*
+** void BuddyFree(BuddyAllocator *pBuddy, int addr)
+** free a block returned by BuddyAlloc, its size is known from the address
+*/
+void BuddyFree(BuddyAllocator *pBuddy, int addr) {
+    int block = addr >> pBuddy->mMinShift;
+    if (addr < 0 || addr >= pBuddy->mPoolSize || (addr & (pBuddy->mMinBlock - 1)) || !pBuddy->mpAllocTag[block]) {
+        fprintf(stderr, "BUDDY: *** Invalid free of address %d\n", addr);
+        return;
+    }
+    int order = pBuddy->mpAllocTag[block] - 1;
+    pBuddy->mpAllocTag[block] = 0;
+
+    if (order < pBuddy->mCacheOrders) {
+        BuddyCache *pCache = BuddyThreadCache(pBuddy);
+        if (pCache->mCount[order] < BUDDY_CACHE_DEPTH) { //park it for the next allocation of this order
+            pCache->mBlocks[order][pCache->mCount[order]++] = block;
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&pBuddy->mLock);
+    if (pBuddy->mLazyWatermark)
+        BuddyFreeLazy(pBuddy, block, order);
+    else
+        BuddyFreeLocked(pBuddy, block, order);
+    pthread_mutex_unlock(&pBuddy->mLock);
+}
+
+/*
+** int allocated = BuddyAllocMany(BuddyAllocator *pBuddy, const int *pSizes, int count, int *pAddrs)
+** allocate count blocks under one lock, pAddrs[i] gets the address for pSizes[i] or -1 if it did not fit
+** the largest requests go first so the halves split off for them serve the smaller ones, returns how many succeeded
+** the batch bypasses the per-thread caches
+*/
+int BuddyAllocMany(BuddyAllocator *pBuddy, const int *pSizes, int count, int *pAddrs) {
+    int allocated = 0;
+    pthread_mutex_lock(&pBuddy->mLock);
+    for (int start = 0; start < count; start += BUDDY_BATCH) { //counting sort every chunk by order, largest first
+        int len = count - start < BUDDY_BATCH ? count - start : BUDDY_BATCH;
+        int orders[BUDDY_BATCH], sorted[BUDDY_BATCH], first[BUDDY_MAX_ORDERS + 1] = {0};
+        for (int i = 0; i < len; ++i) {
+            int size = pSizes[start + i];
+            orders[i] = size <= 0 || size > pBuddy->mMaxBlock ? -1 : BuddyOrderOf(pBuddy, size);
+            pAddrs[start + i] = -1;
+            if (orders[i] != -1)
+                first[pBuddy->mOrders - 1 - orders[i] + 1]++;
+        }
+        for (int k = 1; k <= pBuddy->mOrders; ++k)
+            first[k] += first[k - 1];
+        int used = first[pBuddy->mOrders];
+        for (int i = 0; i < len; ++i)
+            if (orders[i] != -1)
+                sorted[first[pBuddy->mOrders - 1 - orders[i]]++] = i;
+        for (int n = 0; n < used; ++n) {
+            int i = sorted[n];
+            int addr = pBuddy->mLazyWatermark ? BuddyAllocLazy(pBuddy, orders[i]) : BuddyAllocLocked(pBuddy, orders[i]);
+            pAddrs[start + i] = addr;
+            allocated += addr != -1;
+        }
+    }
+    pthread_mutex_unlock(&pBuddy->mLock);
+    return allocated;
+}
+
+/*
+** void BuddyFreeMany(BuddyAllocator *pBuddy, const int *pAddrs, int count)
+** free count blocks under one lock, entries of -1 are skipped
+** the blocks are merged level by level from the smallest order up, so blocks freed together merge with each other
+** once instead of every free walking up on its own
+*/
+void BuddyFreeMany(BuddyAllocator *pBuddy, const int *pAddrs, int count) {
+    int work[BUDDY_MAX_ORDERS]; //blocks waiting to be pushed at every order, linked through mpNext
+    for (int order = 0; order < BUDDY_MAX_ORDERS; ++order)
+        work[order] = -1;
+    pthread_mutex_lock(&pBuddy->mLock);
+    for (int i = 0; i < count; ++i) {
+        int addr = pAddrs[i];
+        if (addr == -1)
+            continue;
+        int block = addr >> pBuddy->mMinShift;
+        if (addr < 0 || addr >= pBuddy->mPoolSize || (addr & (pBuddy->mMinBlock - 1)) ||
+            !pBuddy->mpAllocTag[block]) {
+            fprintf(stderr, "BUDDY: *** Invalid free of address %d\n", addr);
+            continue;
+        }
+        int order = pBuddy->mpAllocTag[block] - 1;
+        pBuddy->mpAllocTag[block] = 0;
+        if (pBuddy->mLazyWatermark) {
+            BuddyFreeLazy(pBuddy, block, order);
+            continue;
+        }
+        pBuddy->mpNext[block] = work[order]; //not in any free list, so its links are unused
+        work[order] = block;
+    }
+    for (int order = 0; order < pBuddy->mOrders; ++order) {
+        //pushing reuses mpNext, so walk this order through mpWork and collect merged parents through mpNext
+        for (int block = work[order]; block != -1; block = pBuddy->mpWork[block])
+            pBuddy->mpWork[block] = pBuddy->mpNext[block];
+        for (int block = work[order]; block != -1; block = pBuddy->mpWork[block])
+            BuddyPush(pBuddy, block, order);
+        if (order == pBuddy->mOrders - 1) //roots never merge
+            break;
+        for (int block = work[order]; block != -1; block = pBuddy->mpWork[block]) {
+            int buddy = block ^ (1 << order);
+            //a pair freed in the same batch is seen twice, the first visit merges it and clears both tags
+            if (pBuddy->mpFreeTag[block] != order + 1 || pBuddy->mpFreeTag[buddy] != order + 1)
+                continue;
+            BuddyUnlink(pBuddy, block, order);
+            BuddyUnlink(pBuddy, buddy, order);
+            int parent = block & ~(1 << order);
+            pBuddy->mpNext[parent] = work[order + 1];
+            work[order + 1] = parent;
+            pBuddy->mMerges++;
+        }
+    }
+    pthread_mutex_unlock(&pBuddy->mLock);
+}
+
+/*
+** int grown = BuddyGrowLocked(BuddyAllocator *pBuddy, int block, int order, int target)
+** absorb the buddies from order up to target if every one of them is a whole free block, 0 if one is not
+** the caller holds the lock
+*/
+int BuddyGrowLocked(BuddyAllocator *pBuddy, int block, int order, int target) {
+    if (block & ((1 << target) - 1)) //the block must be the lower half at every level it grows through
+        return 0;
+    for (int k = order; k < target; ++k)
+        if (pBuddy->mpFreeTag[block + (1 << k)] != k + 1)
+            return 0;
+    for (int k = order; k < target; ++k)
+        BuddyUnlink(pBuddy, block + (1 << k), k);
+    return 1;
+}
+
+/*
+** int result = BuddyResize(BuddyAllocator *pBuddy, int addr, int size)
+** resize the allocated block at addr without moving it, return 0 on success or -1 if it cannot stay where it is
+** growing absorbs the free buddies above the block, shrinking splits off the upper halves and frees them
+*/
+int BuddyResize(BuddyAllocator *pBuddy, int addr, int size) {
+    int block = addr >> pBuddy->mMinShift;
+    if (addr < 0 || addr >= pBuddy->mPoolSize || (addr & (pBuddy->mMinBlock - 1)) || !pBuddy->mpAllocTag[block]) {
+        fprintf(stderr, "BUDDY: *** Invalid resize of address %d\n", addr);
+        return -1;
+    }
+    if (size <= 0 || size > pBuddy->mMaxBlock)
+        return -1;
+    int order = pBuddy->mpAllocTag[block] - 1;
+    int target = BuddyOrderOf(pBuddy, size);
+    if (target == order)
+        return 0;
+
+    pthread_mutex_lock(&pBuddy->mLock);
+    int done = 1;
+    if (target < order) { //the split off halves cannot merge, their lower buddies are still ours
+        for (int k = order - 1; k >= target; --k)
+            BuddyPush(pBuddy, block + (1 << k), k);
+    } else {
+        done = BuddyGrowLocked(pBuddy, block, order, target);
+        if (!done && pBuddy->mLazyWatermark && BuddyLazyFlush(pBuddy)) //the buddies may be sitting in lazy stacks
+            done = BuddyGrowLocked(pBuddy, block, order, target);
+    }
+    if (done)
+        pBuddy->mpAllocTag[block] = (unsigned char) (target + 1);
+    pthread_mutex_unlock(&pBuddy->mLock);
+    return done ? 0 : -1;
+}
+
+void BuddyFlushSlot(BuddyCache *pCache) {
+    BuddyAllocator *pBuddy = pCache->mpOwner;
+    pthread_mutex_lock(&pBuddy->mLock);
+    for (int order = 0; order < BUDDY_CACHE_ORDERS; ++order)
+        while (pCache->mCount[order])
+            BuddyFreeLocked(pBuddy, pCache->mBlocks[order][--pCache->mCount[order]], order);
+    pthread_mutex_unlock(&pBuddy->mLock);
+}
+
+/*
+** void BuddyFlushCache(BuddyAllocator *pBuddy)
+** return every block cached by the calling thread to the shared lists
+*/
+void BuddyFlushCache(BuddyAllocator *pBuddy) {
+    if (pBuddy->mSlot == -1 || tBuddyCaches[pBuddy->mSlot].mSerial != pBuddy->mSerial)
+        return;
+    BuddyFlushSlot(&tBuddyCaches[pBuddy->mSlot]);
+}
+
+void BuddyCacheDestructor(void *pCache) { //runs when a thread that used the cache exits
+    BuddyFlushSlot(pCache);
+}
+
+/*
+** int size = BuddyBlockSize(BuddyAllocator *pBuddy, int addr)
+** size of the allocated block starting at addr, 0 if no allocated block starts there
+*/
+int BuddyBlockSize(BuddyAllocator *pBuddy, int addr) {
+    if (addr < 0 || addr >= pBuddy->mPoolSize || (addr & (pBuddy->mMinBlock - 1)))
+        return 0;
+    int tag = pBuddy->mpAllocTag[addr >> pBuddy->mMinShift];
+    return tag ? BuddyOrderSize(pBuddy, tag - 1) : 0;
+}
+
+/*
+** int bytes = BuddyFreeBytes(BuddyAllocator *pBuddy)
+** free bytes in the shared lists and lazy stacks, blocks parked in thread caches count as used
+*/
+int BuddyFreeBytes(BuddyAllocator *pBuddy) {
+    pthread_mutex_lock(&pBuddy->mLock);
+    int bytes = pBuddy->mFreeMem;
+    pthread_mutex_unlock(&pBuddy->mLock);
+    return bytes;
+}
+
+/*
+** int bytes = BuddyLargestFree(BuddyAllocator *pBuddy)
+** size of the largest free block, lazy ones included, 0 if none is free
+*/
+int BuddyLargestFree(BuddyAllocator *pBuddy) {
+    pthread_mutex_lock(&pBuddy->mLock);
+    int order = pBuddy->mOrders - 1;
+    while (order >= 0 && !pBuddy->mFreeCount[order] && !pBuddy->mLazyCount[order])
+        order--;
+    pthread_mutex_unlock(&pBuddy->mLock);
+    return order < 0 ? 0 : pBuddy->mMinBlock << order;
+}
+
+BuddyStats BuddyGetStats(BuddyAllocator *pBuddy) {
+    pthread_mutex_lock(&pBuddy->mLock);
+    BuddyStats stats = {pBuddy->mSplits, pBuddy->mMerges, pBuddy->mSplitsAvoided, pBuddy->mMergesAvoided};
+    pthread_mutex_unlock(&pBuddy->mLock);
+    return stats;
+}
+
+/*
+** int orders = BuddyFreeCounts(BuddyAllocator *pBuddy, int *pCounts)
+** free blocks of every order, lazy ones included, into pCounts[0 .. orders - 1]
+** blocks sitting in per-thread caches are not counted
+*/
+int BuddyFreeCounts(BuddyAllocator *pBuddy, int *pCounts) {
+    pthread_mutex_lock(&pBuddy->mLock);
+    for (int order = 0; order < pBuddy->mOrders; ++order)
+        pCounts[order] = pBuddy->mFreeCount[order] + pBuddy->mLazyCount[order];
+    pthread_mutex_unlock(&pBuddy->mLock);
+    return pBuddy->mOrders;
+}
+
+/*
+** int error = BuddySave(BuddyAllocator *pBuddy, FILE *pFile)
+** write the free lists, lazy stacks, tags and counters, -1 if the write failed
+** blocks sitting in per-thread caches are saved as allocated
+*/
+int BuddySave(BuddyAllocator *pBuddy, FILE *pFile) {
+    int geometry[] = {pBuddy->mPoolSize, pBuddy->mMinBlock, pBuddy->mMaxBlock};
+    size_t state = offsetof(BuddyAllocator, mCacheOrders) - offsetof(BuddyAllocator, mHeads);
+    size_t blocks = (size_t) pBuddy->mBlocks;
+    pthread_mutex_lock(&pBuddy->mLock);
+    int ok = fwrite(geometry, sizeof(geometry), 1, pFile) == 1 && fwrite(pBuddy->mHeads, state, 1, pFile) == 1 &&
+             fwrite(pBuddy->mpNext, sizeof(int), blocks, pFile) == blocks &&
+             fwrite(pBuddy->mpPrev, sizeof(int), blocks, pFile) == blocks &&
+             fwrite(pBuddy->mpFreeTag, 1, blocks, pFile) == blocks &&
+             fwrite(pBuddy->mpAllocTag, 1, blocks, pFile) == blocks;
+    pthread_mutex_unlock(&pBuddy->mLock);
+    return ok ? 0 : -1;
+}
+
+/*
+** int error = BuddyLoad(BuddyAllocator *pBuddy, FILE *pFile)
+** replace the state of pBuddy with one BuddySave wrote, -1 if it was saved from an allocator of other sizes
+*/
+int BuddyLoad(BuddyAllocator *pBuddy, FILE *pFile) {
+    int geometry[3];
+    size_t state = offsetof(BuddyAllocator, mCacheOrders) - offsetof(BuddyAllocator, mHeads);
+    size_t blocks = (size_t) pBuddy->mBlocks;
+    if (fread(geometry, sizeof(geometry), 1, pFile) != 1 || geometry[0] != pBuddy->mPoolSize ||
+        geometry[1] != pBuddy->mMinBlock || geometry[2] != pBuddy->mMaxBlock)
+        return -1;
+    BuddyFlushCache(pBuddy); //cached blocks of the calling thread would be handed out twice
+    pthread_mutex_lock(&pBuddy->mLock);
+    int ok = fread(pBuddy->mHeads, state, 1, pFile) == 1 &&
+             fread(pBuddy->mpNext, sizeof(int), blocks, pFile) == blocks &&
+             fread(pBuddy->mpPrev, sizeof(int), blocks, pFile) == blocks &&
+             fread(pBuddy->mpFreeTag, 1, blocks, pFile) == blocks &&
+             fread(pBuddy->mpAllocTag, 1, blocks, pFile) == blocks;
+    pthread_mutex_unlock(&pBuddy->mLock);
+    return ok ? 0 : -1;
+}
+
+#endif //SRTN_BUDDY_BUDDYALLOCATOR_H
@@ -0,0 +1,255 @@
+//
+// Real memory managed by the buddy allocator
+// an arena is one mmap'd region, optionally backed by huge pages, whose offsets are handed out by a BuddyAllocator.
+// buddy_malloc, buddy_free, buddy_calloc and buddy_realloc work on a process wide arena created on first use,
+// requests the arena cannot serve get their own mapping.
+//
+
+#ifndef SRTN_BUDDY_BUDDYARENA_H
+#define SRTN_BUDDY_BUDDYARENA_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "BuddyAllocator.h"
+
+#define BUDDY_ARENA_MIN_BLOCK 16 //keeps every block aligned like malloc memory
+#define BUDDY_ARENA_DEFAULT_MB 256
+#define BUDDY_LARGE_HEADER 4096 //large mappings keep their size one page before the returned pointer
+
+typedef struct BuddyArena {
+    char *mpBase; //start of the managed memory, aligned to its own size
+    int mSize;
+    int mHugePages; //1 if the memory is backed by explicit huge pages
+    BuddyAllocator *mpBuddy;
+} BuddyArena;
+
+typedef struct BuddyLargeHeader {
+    size_t mMapSize;
+    struct BuddyLargeHeader *mpPrev; //registry of live large mappings
+    struct BuddyLargeHeader *mpNext;
+} BuddyLargeHeader;
+
+/*
+** BuddyArena *pArena = BuddyArenaCreate(int size, int huge_pages)
+** map size bytes (a power of 2) aligned to size so every block is aligned to its own size
+** with huge_pages the arena tries MAP_HUGETLB first and falls back to transparent huge pages
+*/
+BuddyArena *BuddyArenaCreate(int size, int huge_pages) {
+    if (size < BUDDY_ARENA_MIN_BLOCK || (size & (size - 1)))
+        return NULL;
+    BuddyArena *pArena = mmap(NULL, sizeof(BuddyArena), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pArena == MAP_FAILED)
+        return NULL;
+
+    char *pMap = MAP_FAILED;
+    pArena->mHugePages = 0;
+    if (huge_pages) { //explicit huge pages only work if the admin reserved enough of them
+        pMap = mmap(NULL, (size_t) size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                                                                     MAP_HUGETLB, -1, 0);
+        pArena->mHugePages = pMap != MAP_FAILED;
+    }
+    if (pMap == MAP_FAILED) //reserve twice the size so an aligned window can be cut out
+        pMap = mmap(NULL, (size_t) size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1,
+                    0);
+    if (pMap == MAP_FAILED) {
+        munmap(pArena, sizeof(BuddyArena));
+        return NULL;
+    }
+    char *pBase = (char *) (((uintptr_t) pMap + size - 1) & ~((uintptr_t) size - 1));
+    if (!pArena->mHugePages) { //huge page mappings can only be unmapped in huge page units, keep them whole
+        if (pBase > pMap)
+            munmap(pMap, pBase - pMap);
+        munmap(pBase + size, pMap + (size_t) size * 2 - (pBase + size));
+        if (huge_pages)
+            madvise(pBase, size, MADV_HUGEPAGE);
+    }
+
+    pArena->mpBase = pBase;
+    pArena->mSize = size;
+    pArena->mpBuddy = BuddyCreate(size, BUDDY_ARENA_MIN_BLOCK, size, BUDDY_CACHE_ORDERS);
+    if (!pArena->mpBuddy) {
+        munmap(pArena->mHugePages ? pMap : pBase, pArena->mHugePages ? (size_t) size * 2 : size);
+        munmap(pArena, sizeof(BuddyArena));
+        return NULL;
+    }
+    return pArena;
+}
+
+int BuddyArenaOwns(const BuddyArena *pArena, const void *ptr) {
+    return (const char *) ptr >= pArena->mpBase && (const char *) ptr < pArena->mpBase + pArena->mSize;
+}
+
+void *BuddyArenaAlloc(BuddyArena *pArena, size_t size) {
+    if (size > (size_t) pArena->mSize)
+        return NULL;
+    int addr = BuddyAlloc(pArena->mpBuddy, size ? (int) size : 1);
+    return addr == -1 ? NULL : pArena->mpBase + addr;
+}
+
+void BuddyArenaFree(BuddyArena *pArena, void *ptr) {
+    BuddyFree(pArena->mpBuddy, (int) ((char *) ptr - pArena->mpBase));
+}
+
+size_t BuddyArenaUsableSize(BuddyArena *pArena, const void *ptr) {
+    return BuddyBlockSize(pArena->mpBuddy, (int) ((const char *) ptr - pArena->mpBase));
+}
+
+BuddyArena *gpBuddyArena = NULL; //process wide arena behind buddy_malloc
+pthread_once_t gBuddyArenaOnce = PTHREAD_ONCE_INIT;
+
+void BuddyArenaInitDefault() { //size from BUDDY_ARENA_MB, huge pages if BUDDY_HUGE_PAGES=1
+    const char *pSize = getenv("BUDDY_ARENA_MB");
+    const char *pHuge = getenv("BUDDY_HUGE_PAGES");
+    long mb = pSize ? strtol(pSize, NULL, 10) : BUDDY_ARENA_DEFAULT_MB;
+    if (mb <= 0 || mb > 1024)
+        mb = BUDDY_ARENA_DEFAULT_MB;
+    int size = 1 << 20;
+    while (size < mb << 20)
+        size <<= 1;
+    gpBuddyArena = BuddyArenaCreate(size, pHuge && pHuge[0] == '1');
+}
+
+BuddyLargeHeader *gpBuddyLarge = NULL; //every live large mapping, pointers are only ever matched against it
+pthread_mutex_t gBuddyLargeLock = PTHREAD_MUTEX_INITIALIZER;
+
+void *BuddyLargeAlloc(size_t size) {
+    if (size > SIZE_MAX - 2 * BUDDY_LARGE_HEADER)
+        return NULL;
+    size_t map_size = (size + 2 * BUDDY_LARGE_HEADER - 1) & ~(size_t) (BUDDY_LARGE_HEADER - 1);
+    char *pMap = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pMap == MAP_FAILED)
+        return NULL;
+    BuddyLargeHeader *pHeader = (BuddyLargeHeader *) pMap;
+    pHeader->mMapSize = map_size;
+    pHeader->mpPrev = NULL;
+    pthread_mutex_lock(&gBuddyLargeLock);
+    pHeader->mpNext = gpBuddyLarge;
+    if (gpBuddyLarge)
+        gpBuddyLarge->mpPrev = pHeader;
+    gpBuddyLarge = pHeader;
+    pthread_mutex_unlock(&gBuddyLargeLock);
+    return pMap + BUDDY_LARGE_HEADER;
+}
+
+/*
+** BuddyLargeHeader *pHeader = BuddyLargeFind(const void *ptr)
+** NULL if ptr is not the start of a live large mapping, call with gBuddyLargeLock held
+** only the registry is read, a foreign pointer is never dereferenced
+*/
+BuddyLargeHeader *BuddyLargeFind(const void *ptr) {
+    if ((uintptr_t) ptr & (BUDDY_LARGE_HEADER - 1))
+        return NULL;
+    for (BuddyLargeHeader *pHeader = gpBuddyLarge; pHeader; pHeader = pHeader->mpNext)
+        if ((const char *) pHeader + BUDDY_LARGE_HEADER == (const char *) ptr)
+            return pHeader;
+    return NULL;
+}
+
+size_t BuddyLargeSize(const void *ptr) { //usable bytes of a large mapping, 0 if ptr is not one
+    pthread_mutex_lock(&gBuddyLargeLock);
+    BuddyLargeHeader *pHeader = BuddyLargeFind(ptr);
+    size_t size = pHeader ? pHeader->mMapSize - BUDDY_LARGE_HEADER : 0;
+    pthread_mutex_unlock(&gBuddyLargeLock);
+    return size;
+}
+
+void BuddyLargeFree(void *ptr) { //unmap a large mapping, anything else is left alone
+    pthread_mutex_lock(&gBuddyLargeLock);
+    BuddyLargeHeader *pHeader = BuddyLargeFind(ptr);
+    if (pHeader) {
+        if (pHeader->mpPrev)
+            pHeader->mpPrev->mpNext = pHeader->mpNext;
+        else
+            gpBuddyLarge = pHeader->mpNext;
+        if (pHeader->mpNext)
+            pHeader->mpNext->mpPrev = pHeader->mpPrev;
+    }
+    pthread_mutex_unlock(&gBuddyLargeLock);
+    if (pHeader)
+        munmap(pHeader, pHeader->mMapSize);
+}
+
+void *buddy_malloc(size_t size) {
+    pthread_once(&gBuddyArenaOnce, BuddyArenaInitDefault);
+    void *ptr = NULL;
+    if (gpBuddyArena && size <= (size_t) gpBuddyArena->mSize)
+        ptr = BuddyArenaAlloc(gpBuddyArena, size);
+    if (!ptr) //larger than the arena or the arena is exhausted
+        ptr = BuddyLargeAlloc(size);
+    if (!ptr)
+        errno = ENOMEM;
+    return ptr;
+}
+
+void buddy_free(void *ptr) {
+    if (!ptr)
+        return;
+    if (gpBuddyArena && BuddyArenaOwns(gpBuddyArena, ptr)) {
+        BuddyArenaFree(gpBuddyArena, ptr);
+        return;
+    }
+    BuddyLargeFree(ptr);
+}
+
+size_t buddy_usable_size(void *ptr) {
+    if (!ptr)
+        return 0;
+    if (gpBuddyArena && BuddyArenaOwns(gpBuddyArena, ptr))
+        return BuddyArenaUsableSize(gpBuddyArena, ptr);
+    return BuddyLargeSize(ptr);
+}
+
+void *buddy_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *ptr = buddy_malloc(count * size);
+    if (ptr && gpBuddyArena && BuddyArenaOwns(gpBuddyArena, ptr)) //fresh large mappings are already zero
+        memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void *buddy_realloc(void *ptr, size_t size) {
+    if (!ptr)
+        return buddy_malloc(size);
+    if (!size) {
+        buddy_free(ptr);
+        return NULL;
+    }
+    size_t old_size = buddy_usable_size(ptr);
+    if (size <= old_size && (size > old_size / 2 || old_size <= BUDDY_ARENA_MIN_BLOCK)) //still the right block
+        return ptr;
+    if (gpBuddyArena && BuddyArenaOwns(gpBuddyArena, ptr) && size <= (size_t) gpBuddyArena->mpBuddy->mMaxBlock &&
+        !BuddyResize(gpBuddyArena->mpBuddy, (int) ((char *) ptr - gpBuddyArena->mpBase), (int) size))
+        return ptr; //shrunk in place, or grew into free buddies without copying
+    void *pNew = buddy_malloc(size);
+    if (!pNew)
+        return NULL;
+    memcpy(pNew, ptr, old_size < size ? old_size : size);
+    buddy_free(ptr);
+    return pNew;
+}
+
+/*
+** void *ptr = buddy_memalign(size_t alignment, size_t size)
+** buddy blocks are aligned to their own size, so asking for at least alignment bytes is enough
+*/
+void *buddy_memalign(size_t alignment, size_t size) {
+    if (alignment <= BUDDY_ARENA_MIN_BLOCK)
+        return buddy_malloc(size);
+    if (alignment > BUDDY_LARGE_HEADER && size < alignment) //large mappings are only page aligned
+        size = alignment;
+    void *ptr = buddy_malloc(size > alignment ? size : alignment);
+    if (ptr && ((uintptr_t) ptr & (alignment - 1))) {
+        buddy_free(ptr);
+        errno = EINVAL;
+        return NULL;
+    }
+    return ptr;
+}
+
+#endif //SRTN_BUDDY_BUDDYARENA_H
@@ -0,0 +1,185 @@
+//
+// Buddy allocator stored as an implicit complete binary tree
+// node 0 covers the whole pool and the children of node i are 2i + 1 and 2i + 2, every node keeps the order + 1 of the
+// largest free block below it (0 if there is none). Allocation walks down from the root in O(log N) and can choose
+// between both children, which allows placement policies free lists cannot express; freeing walks back up.
+// Best fit trees also keep, per node, a bit for every order of free block below it, so the smallest free block that
+// fits is known at the root and the walk follows the children that hold one.
+// Nodes above mMaxBlock never merge, so the pool behaves like mPoolSize / mMaxBlock roots.
+//
+
+#ifndef SRTN_BUDDY_BUDDYTREE_H
+#define SRTN_BUDDY_BUDDYTREE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum TreePolicy {
+    TREE_LOWEST_ADDRESS, //leftmost block that fits, keeps allocations packed at the start of the pool
+    TREE_BEST_FIT, //split the smallest free block that fits, lowest address among those, keeps large blocks whole
+};
+
+typedef struct BuddyTree {
+    int mPoolSize; //a power of 2
+    int mMinBlock;
+    int mMinShift;
+    int mMaxOrder; //order of mMaxBlock, the largest block handed out
+    int mDepth; //depth of the leaves, the pool is order mDepth
+    int mFreeMem;
+    enum TreePolicy mPolicy;
+    unsigned char *mpLongest; //2 * leaves - 1 nodes
+    unsigned int *mpFreeOrders; //per node, bit k set if a free block of order k is below it, NULL unless best fit
+} BuddyTree;
+
+void BuddyTreeDestroy(BuddyTree *);
+
+/*
+** BuddyTree *pTree = BuddyTreeCreate(int pool_size, int min_block, int max_block, enum TreePolicy policy)
+** all three sizes must be powers of 2, returns NULL if they are not or memory is exhausted
+*/
+BuddyTree *BuddyTreeCreate(int pool_size, int min_block, int max_block, enum TreePolicy policy) {
+    if (min_block <= 0 || (min_block & (min_block - 1)) || (max_block & (max_block - 1)) ||
+        (pool_size & (pool_size - 1)) || max_block < min_block || pool_size < max_block)
+        return NULL;
+    BuddyTree *pTree = malloc(sizeof(BuddyTree));
+    if (!pTree)
+        return NULL;
+    pTree->mPoolSize = pool_size;
+    pTree->mMinBlock = min_block;
+    pTree->mMinShift = __builtin_ctz((unsigned int) min_block);
+    pTree->mMaxOrder = __builtin_ctz((unsigned int) max_block) - pTree->mMinShift;
+    pTree->mDepth = __builtin_ctz((unsigned int) pool_size) - pTree->mMinShift;
+    pTree->mFreeMem = pool_size;
+    pTree->mPolicy = policy;
+    pTree->mpLongest = malloc((2 << pTree->mDepth) - 1);
+    pTree->mpFreeOrders = policy == TREE_BEST_FIT ? malloc(((2 << pTree->mDepth) - 1) * sizeof(unsigned int)) : NULL;
+    if (!pTree->mpLongest || (policy == TREE_BEST_FIT && !pTree->mpFreeOrders)) {
+        BuddyTreeDestroy(pTree);
+        return NULL;
+    }
+    for (int i = 0; i < (2 << pTree->mDepth) - 1; ++i) { //a node at depth d covers a block of order mDepth - d
+        int order = pTree->mDepth - (31 - __builtin_clz((unsigned int) (i + 1)));
+        pTree->mpLongest[i] = (unsigned char) ((order < pTree->mMaxOrder ? order : pTree->mMaxOrder) + 1);
+        if (pTree->mpFreeOrders)
+            pTree->mpFreeOrders[i] = 1u << (pTree->mpLongest[i] - 1);
+    }
+    return pTree;
+}
+
+void BuddyTreeDestroy(BuddyTree *pTree) {
+    free(pTree->mpLongest);
+    free(pTree->mpFreeOrders);
+    free(pTree);
+}
+
+/*
+** void BuddyTreeUpdate(BuddyTree *pTree, int node, int order)
+** recompute a node of the given order from its children, two whole free halves merge unless the node is too large
+*/
+void BuddyTreeUpdate(BuddyTree *pTree, int node, int order) {
+    unsigned char left = pTree->mpLongest[2 * node + 1], right = pTree->mpLongest[2 * node + 2];
+    int merged = left == order && right == order && order <= pTree->mMaxOrder; //both are free blocks of order - 1
+    pTree->mpLongest[node] = merged ? (unsigned char) (order + 1) : left > right ? left : right;
+    if (pTree->mpFreeOrders)
+        pTree->mpFreeOrders[node] = merged ? 1u << order :
+                                    pTree->mpFreeOrders[2 * node + 1] | pTree->mpFreeOrders[2 * node + 2];
+}
+
+/*
+** int addr = BuddyTreeAlloc(BuddyTree *pTree, int size)
+** address of a free block of at least size bytes chosen by the tree's policy, -1 if none is free
+*/
+int BuddyTreeAlloc(BuddyTree *pTree, int size) {
+    int order = size <= pTree->mMinBlock ? 0 : 32 - __builtin_clz((unsigned int) (size - 1)) - pTree->mMinShift;
+    if (size <= 0 || order > pTree->mMaxOrder || pTree->mpLongest[0] < order + 1)
+        return -1;
+    int node = 0;
+    //the order of the smallest free block that fits, best fit walks to the leftmost one of that order
+    int fit = pTree->mpFreeOrders ? __builtin_ctz(pTree->mpFreeOrders[0] >> order) + order : order;
+    for (int node_order = pTree->mDepth; node_order != order; --node_order) {
+        int left = 2 * node + 1, right = left + 1;
+        if (pTree->mpFreeOrders && node_order > fit)
+            node = pTree->mpFreeOrders[left] & (1u << fit) ? left : right;
+        else
+            node = pTree->mpLongest[left] > order ? left : right;
+    }
+    pTree->mpLongest[node] = 0;
+    if (pTree->mpFreeOrders)
+        pTree->mpFreeOrders[node] = 0;
+    int offset = (node + 1 - (1 << (pTree->mDepth - order))) << order; //position among the nodes of its depth
+    for (int node_order = order + 1; node; ++node_order) {
+        node = (node - 1) / 2;
+        BuddyTreeUpdate(pTree, node, node_order);
+    }
+    pTree->mFreeMem -= pTree->mMinBlock << order;
+    return offset << pTree->mMinShift;
+}
+
+/*
+** void BuddyTreeFree(BuddyTree *pTree, int addr)
+** free the block at addr, the allocated node is the lowest ancestor of its leaf marked 0
+*/
+void BuddyTreeFree(BuddyTree *pTree, int addr) {
+    if (addr < 0 || addr >= pTree->mPoolSize || (addr & (pTree->mMinBlock - 1))) {
+        fprintf(stderr, "TREE: *** Invalid free of address %d\n", addr);
+        return;
+    }
+    int block = addr >> pTree->mMinShift;
+    int node = block + (1 << pTree->mDepth) - 1, order = 0;
+    while (pTree->mpLongest[node] && node) { //blocks below an allocated node keep their free values
+        node = (node - 1) / 2;
+        order++;
+    }
+    if (pTree->mpLongest[node] || (block & ((1 << order) - 1))) { //nothing allocated here, or not its start
+        fprintf(stderr, "TREE: *** Invalid free of address %d\n", addr);
+        return;
+    }
+    pTree->mpLongest[node] = (unsigned char) (order + 1);
+    if (pTree->mpFreeOrders)
+        pTree->mpFreeOrders[node] = 1u << order;
+    pTree->mFreeMem += pTree->mMinBlock << order;
+    for (order++; node; ++order) {
+        node = (node - 1) / 2;
+        BuddyTreeUpdate(pTree, node, order);
+    }
+}
+
+int BuddyTreeFreeBytes(const BuddyTree *pTree) {
+    return pTree->mFreeMem;
+}
+
+int BuddyTreeLargestFree(const BuddyTree *pTree) { //the root keeps the order + 1 of the largest free block below it
+    return pTree->mpLongest[0] ? pTree->mMinBlock << (pTree->mpLongest[0] - 1) : 0;
+}
+
+int BuddyTreeSave(const BuddyTree *pTree, FILE *pFile) { //-1 if the write failed
+    int header[] = {pTree->mPoolSize, pTree->mMinBlock, pTree->mMaxOrder, pTree->mFreeMem};
+    size_t nodes = (size_t) (2 << pTree->mDepth) - 1;
+    return fwrite(header, sizeof(header), 1, pFile) == 1 && fwrite(pTree->mpLongest, 1, nodes, pFile) == nodes ? 0 : -1;
+}
+
+/*
+** int error = BuddyTreeLoad(BuddyTree *pTree, FILE *pFile)
+** replace the tree with one BuddyTreeSave wrote, -1 if it was saved from a tree of other sizes
+*/
+int BuddyTreeLoad(BuddyTree *pTree, FILE *pFile) {
+    int header[4];
+    size_t nodes = (size_t) (2 << pTree->mDepth) - 1;
+    if (fread(header, sizeof(header), 1, pFile) != 1 || header[0] != pTree->mPoolSize ||
+        header[1] != pTree->mMinBlock || header[2] != pTree->mMaxOrder)
+        return -1;
+    pTree->mFreeMem = header[3];
+    if (fread(pTree->mpLongest, 1, nodes, pFile) != nodes)
+        return -1;
+    if (pTree->mpFreeOrders) //not saved, rebuilt from the leaves up like frees do
+        for (int node = (int) nodes - 1; node >= 0; --node) {
+            int order = pTree->mDepth - (31 - __builtin_clz((unsigned int) (node + 1)));
+            if (!pTree->mpLongest[node] || pTree->mpLongest[node] == order + 1 || !order) //allocated or one free block
+                pTree->mpFreeOrders[node] = pTree->mpLongest[node] ? 1u << (pTree->mpLongest[node] - 1) : 0;
+            else
+                pTree->mpFreeOrders[node] = pTree->mpFreeOrders[2 * node + 1] | pTree->mpFreeOrders[2 * node + 2];
+        }
+    return 0;
+}
+
+#endif //SRTN_BUDDY_BUDDYTREE_H
@@ -0,0 +1,136 @@
+//
+// Buddy allocators specialized at compile time
+// DEFINE_BUDDY_VARIANT(Name, POOL, MIN, ORDERS) generates a single threaded buddy allocator over POOL bytes whose block
+// sizes are MIN << 0 .. MIN << (ORDERS - 1). Every size is a constant, so the arrays are static, size to order is one
+// __builtin_clz, the order loops have constant bounds the compiler can unroll, and block numbers are shifts.
+// The generated functions are NameInit, NameAlloc, NameFree, NameFreeBytes, NameLargestFree, NameRound, NameSave
+// and NameLoad.
+//
+
+#ifndef SRTN_BUDDY_BUDDYVARIANT_H
+#define SRTN_BUDDY_BUDDYVARIANT_H
+
+#define DEFINE_BUDDY_VARIANT(NAME, POOL, MIN, ORDERS)                                                                  \
+_Static_assert(((MIN) & ((MIN) - 1)) == 0 && (ORDERS) > 0 && (ORDERS) <= 31, #NAME ": bad block sizes");              \
+_Static_assert((POOL) % ((MIN) << ((ORDERS) - 1)) == 0, #NAME ": the pool must be made of whole roots");              \
+                                                                                                                      \
+static int NAME##Next[(POOL) / (MIN)];                                                                                \
+static int NAME##Prev[(POOL) / (MIN)];                                                                                \
+static unsigned char NAME##FreeTag[(POOL) / (MIN)]; /*order + 1 of the free block starting here, 0 if none*/          \
+static unsigned char NAME##AllocTag[(POOL) / (MIN)]; /*order + 1 of the allocated block starting here, 0 if none*/    \
+static int NAME##Heads[ORDERS];                                                                                       \
+static unsigned int NAME##NonEmpty; /*bit k is set if order k has a free block*/                                      \
+static int NAME##FreeMem;                                                                                             \
+                                                                                                                      \
+static inline int NAME##OrderOf(int size) {                                                                           \
+    return size <= (MIN) ? 0 : 32 - __builtin_clz((unsigned int) (size - 1)) - __builtin_ctz(MIN);                    \
+}                                                                                                                     \
+                                                                                                                      \
+static inline void NAME##Push(int block, int order) {                                                                 \
+    int head = NAME##Heads[order];                                                                                    \
+    NAME##Next[block] = head;                                                                                         \
+    NAME##Prev[block] = -1;                                                                                           \
+    if (head != -1)                                                                                                   \
+        NAME##Prev[head] = block;                                                                                     \
+    NAME##Heads[order] = block;                                                                                       \
+    NAME##NonEmpty |= 1u << order;                                                                                    \
+    NAME##FreeTag[block] = (unsigned char) (order + 1);                                                               \
+    NAME##FreeMem += (MIN) << order;                                                                                  \
+}                                                                                                                     \
+                                                                                                                      \
+static inline void NAME##Unlink(int block, int order) {                                                               \
+    int next = NAME##Next[block], prev = NAME##Prev[block];                                                           \
+    if (prev != -1)                                                                                                   \
+        NAME##Next[prev] = next;                                                                                      \
+    else if ((NAME##Heads[order] = next) == -1)                                                                       \
+        NAME##NonEmpty &= ~(1u << order);                                                                             \
+    if (next != -1)                                                                                                   \
+        NAME##Prev[next] = prev;                                                                                      \
+    NAME##FreeTag[block] = 0;                                                                                         \
+    NAME##FreeMem -= (MIN) << order;                                                                                  \
+}                                                                                                                     \
+                                                                                                                      \
+int NAME##Init() {                                                                                                    \
+    for (int i = 0; i < (POOL) / (MIN); ++i)                                                                          \
+        NAME##FreeTag[i] = NAME##AllocTag[i] = 0;                                                                     \
+    for (int i = 0; i < (ORDERS); ++i)                                                                                \
+        NAME##Heads[i] = -1;                                                                                          \
+    NAME##NonEmpty = 0;                                                                                               \
+    NAME##FreeMem = 0;                                                                                                \
+    for (int block = (POOL) / (MIN) - (1 << ((ORDERS) - 1)); block >= 0; block -= 1 << ((ORDERS) - 1))                \
+        NAME##Push(block, (ORDERS) - 1); /*lowest root at the head*/                                                  \
+    return 0;                                                                                                         \
+}                                                                                                                     \
+                                                                                                                      \
+int NAME##Alloc(int size) {                                                                                           \
+    int order = NAME##OrderOf(size);                                                                                  \
+    if (size <= 0 || order >= (ORDERS))                                                                               \
+        return -1;                                                                                                    \
+    unsigned int fits = NAME##NonEmpty >> order;                                                                      \
+    if (!fits)                                                                                                        \
+        return -1;                                                                                                    \
+    int found = order + __builtin_ctz(fits);                                                                          \
+    int block = NAME##Heads[found];                                                                                   \
+    NAME##Unlink(block, found);                                                                                       \
+    while (found != order) { /*split down, upper halves go back to the free lists*/                                   \
+        found--;                                                                                                      \
+        NAME##Push(block + (1 << found), found);                                                                      \
+    }                                                                                                                 \
+    NAME##AllocTag[block] = (unsigned char) (order + 1);                                                              \
+    return block * (MIN);                                                                                             \
+}                                                                                                                     \
+                                                                                                                      \
+void NAME##Free(int addr) {                                                                                           \
+    int block = addr / (MIN);                                                                                         \
+    if (addr < 0 || addr >= (POOL) || addr % (MIN) || !NAME##AllocTag[block]) {                                       \
+        fprintf(stderr, #NAME ": *** Invalid free of address %d\n", addr);                                            \
+        return;                                                                                                       \
+    }                                                                                                                 \
+    int order = NAME##AllocTag[block] - 1;                                                                            \
+    NAME##AllocTag[block] = 0;                                                                                        \
+    for (; order < (ORDERS) - 1; ++order) { /*roots never merge*/                                                     \
+        int buddy = block ^ (1 << order);                                                                             \
+        if (NAME##FreeTag[buddy] != order + 1)                                                                        \
+            break;                                                                                                    \
+        NAME##Unlink(buddy, order);                                                                                   \
+        block &= ~(1 << order);                                                                                       \
+    }                                                                                                                 \
+    NAME##Push(block, order);                                                                                         \
+}                                                                                                                     \
+                                                                                                                      \
+int NAME##FreeBytes() {                                                                                               \
+    return NAME##FreeMem;                                                                                             \
+}                                                                                                                     \
+                                                                                                                      \
+int NAME##LargestFree() {                                                                                             \
+    return NAME##NonEmpty ? (MIN) << (31 - __builtin_clz(NAME##NonEmpty)) : 0;                                        \
+}                                                                                                                     \
+                                                                                                                      \
+int NAME##Round(int size) { /*bytes a request of this size takes*/                                                    \
+    return (MIN) << NAME##OrderOf(size);                                                                              \
+}                                                                                                                     \
+                                                                                                                      \
+int NAME##Save(FILE *pFile) { /*-1 if the write failed*/                                                              \
+    int pool = (POOL);                                                                                                \
+    return fwrite(&pool, sizeof(int), 1, pFile) == 1 && fwrite(NAME##Next, sizeof(NAME##Next), 1, pFile) == 1 &&      \
+           fwrite(NAME##Prev, sizeof(NAME##Prev), 1, pFile) == 1 &&                                                   \
+           fwrite(NAME##FreeTag, sizeof(NAME##FreeTag), 1, pFile) == 1 &&                                             \
+           fwrite(NAME##AllocTag, sizeof(NAME##AllocTag), 1, pFile) == 1 &&                                           \
+           fwrite(NAME##Heads, sizeof(NAME##Heads), 1, pFile) == 1 &&                                                 \
+           fwrite(&NAME##NonEmpty, sizeof(NAME##NonEmpty), 1, pFile) == 1 &&                                          \
+           fwrite(&NAME##FreeMem, sizeof(NAME##FreeMem), 1, pFile) == 1 ? 0 : -1;                                     \
+}                                                                                                                     \
+                                                                                                                      \
+int NAME##Load(FILE *pFile) { /*-1 if the read failed or the state is not one of this variant*/                       \
+    int pool;                                                                                                         \
+    return fread(&pool, sizeof(int), 1, pFile) == 1 && pool == (POOL) &&                                              \
+           fread(NAME##Next, sizeof(NAME##Next), 1, pFile) == 1 &&                                                    \
+           fread(NAME##Prev, sizeof(NAME##Prev), 1, pFile) == 1 &&                                                    \
+           fread(NAME##FreeTag, sizeof(NAME##FreeTag), 1, pFile) == 1 &&                                              \
+           fread(NAME##AllocTag, sizeof(NAME##AllocTag), 1, pFile) == 1 &&                                            \
+           fread(NAME##Heads, sizeof(NAME##Heads), 1, pFile) == 1 &&                                                  \
+           fread(&NAME##NonEmpty, sizeof(NAME##NonEmpty), 1, pFile) == 1 &&                                           \
+           fread(&NAME##FreeMem, sizeof(NAME##FreeMem), 1, pFile) == 1 ? 0 : -1;                                      \
+}
+
+#endif //SRTN_BUDDY_BUDDYVARIANT_H
@@ -0,0 +1,165 @@
+//
+// Binary snapshots of a running simulation
+// a checkpoint starts with a fixed header and one arrived flag per process id, which is all process_generator needs
+// to resume sending the processes that had not arrived yet and the clock to resume counting. The scheduler state
+// follows in the order the scheduler writes it, each allocator saves and loads its own part. A snapshot is written to
+// a temporary file that replaces the previous one only once it is complete and on disk, so a crash while writing
+// leaves the last good checkpoint in place.
+//
+
+#ifndef SRTN_BUDDY_CHECKPOINT_H
+#define SRTN_BUDDY_CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Histogram.h"
+
+#define CHECKPOINT_MAGIC "SRTNCKP"
+#define CHECKPOINT_VERSION 4
+#define CHECKPOINT_PATH_SIZE 4096
+
+typedef struct CheckpointHeader {
+    char mMagic[8];
+    int mVersion;
+    int mClock; //clock value when the checkpoint was taken, a restored run starts counting from here
+    unsigned int mStartTime; //clock value the simulation started at
+    unsigned int mTableSize; //arrived flags that follow, one per process id
+} CheckpointHeader;
+
+typedef struct Checkpoint {
+    FILE *mpFile;
+    int mFailed; //a read or write came up short, the snapshot is not usable
+    char mTempPath[CHECKPOINT_PATH_SIZE]; //written here, renamed over the real path once complete
+} Checkpoint;
+
+void CheckpointWrite(Checkpoint *pCheckpoint, const void *pData, size_t size) {
+    if (!pCheckpoint->mFailed && size && fwrite(pData, size, 1, pCheckpoint->mpFile) != 1)
+        pCheckpoint->mFailed = 1;
+}
+
+void CheckpointRead(Checkpoint *pCheckpoint, void *pData, size_t size) {
+    if (!pCheckpoint->mFailed && size && fread(pData, size, 1, pCheckpoint->mpFile) != 1)
+        pCheckpoint->mFailed = 1;
+}
+
+/*
+** int error = CheckpointBegin(Checkpoint *pCheckpoint, const char *pPath, const CheckpointHeader *pHeader,
+**                             const unsigned char *pArrived)
+** start writing a snapshot for pPath with its header and arrived flags, -1 if the temporary file cannot be created
+*/
+int CheckpointBegin(Checkpoint *pCheckpoint, const char *pPath, const CheckpointHeader *pHeader,
+                    const unsigned char *pArrived) {
+    snprintf(pCheckpoint->mTempPath, CHECKPOINT_PATH_SIZE, "%s.tmp", pPath);
+    pCheckpoint->mFailed = 0;
+    pCheckpoint->mpFile = fopen(pCheckpoint->mTempPath, "wb");
+    if (!pCheckpoint->mpFile)
+        return -1;
+    CheckpointWrite(pCheckpoint, pHeader, sizeof(CheckpointHeader));
+    CheckpointWrite(pCheckpoint, pArrived, pHeader->mTableSize);
+    return 0;
+}
+
+/*
+** int error = CheckpointCommit(Checkpoint *pCheckpoint, const char *pPath)
+** flush the snapshot to disk and put it in place of pPath, -1 and the old checkpoint kept if anything failed
+*/
+int CheckpointCommit(Checkpoint *pCheckpoint, const char *pPath) {
+    CheckpointWrite(pCheckpoint, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)); //trailer, a cut file has none
+    if (fflush(pCheckpoint->mpFile) || fsync(fileno(pCheckpoint->mpFile)))
+        pCheckpoint->mFailed = 1;
+    if (fclose(pCheckpoint->mpFile))
+        pCheckpoint->mFailed = 1;
+    if (!pCheckpoint->mFailed && !rename(pCheckpoint->mTempPath, pPath))
+        return 0;
+    unlink(pCheckpoint->mTempPath);
+    return -1;
+}
+
+/*
+** int error = CheckpointOpen(Checkpoint *pCheckpoint, const char *pPath, CheckpointHeader *pHeader)
+** open a snapshot and read its header, the arrived flags are next, -1 if it is not a checkpoint of this version
+*/
+int CheckpointOpen(Checkpoint *pCheckpoint, const char *pPath, CheckpointHeader *pHeader) {
+    pCheckpoint->mFailed = 0;
+    pCheckpoint->mpFile = fopen(pPath, "rb");
+    if (!pCheckpoint->mpFile)
+        return -1;
+    CheckpointRead(pCheckpoint, pHeader, sizeof(CheckpointHeader));
+    if (pCheckpoint->mFailed || strcmp(pHeader->mMagic, CHECKPOINT_MAGIC) || pHeader->mVersion != CHECKPOINT_VERSION) {
+        fclose(pCheckpoint->mpFile);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+** int error = CheckpointClose(Checkpoint *pCheckpoint)
+** check the trailer after the last field and close, -1 if a read failed or the file does not end where expected
+*/
+int CheckpointClose(Checkpoint *pCheckpoint) {
+    char trailer[sizeof(CHECKPOINT_MAGIC)];
+    CheckpointRead(pCheckpoint, trailer, sizeof(trailer));
+    if (!pCheckpoint->mFailed && strcmp(trailer, CHECKPOINT_MAGIC))
+        pCheckpoint->mFailed = 1;
+    fclose(pCheckpoint->mpFile);
+    return pCheckpoint->mFailed ? -1 : 0;
+}
+
+/*
+** unsigned char *pArrived = CheckpointReadArrived(const char *pPath, CheckpointHeader *pHeader)
+** header and arrived flags of a snapshot, for process_generator, NULL if it cannot be read
+*/
+unsigned char *CheckpointReadArrived(const char *pPath, CheckpointHeader *pHeader) {
+    Checkpoint checkpoint;
+    if (CheckpointOpen(&checkpoint, pPath, pHeader))
+        return NULL;
+    unsigned char *pArrived = malloc(pHeader->mTableSize ? pHeader->mTableSize : 1);
+    if (pArrived)
+        CheckpointRead(&checkpoint, pArrived, pHeader->mTableSize);
+    fclose(checkpoint.mpFile);
+    if (pArrived && checkpoint.mFailed) {
+        free(pArrived);
+        return NULL;
+    }
+    return pArrived;
+}
+
+void CheckpointWriteHistogram(Checkpoint *pCheckpoint, const Histogram *pHist) { //only the buckets in use
+    int used = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i)
+        used += pHist->mCounts[i] != 0;
+    CheckpointWrite(pCheckpoint, &pHist->mScale, sizeof(double));
+    CheckpointWrite(pCheckpoint, &pHist->mTotal, sizeof(long));
+    CheckpointWrite(pCheckpoint, &pHist->mMax, sizeof(long));
+    CheckpointWrite(pCheckpoint, &pHist->mMean, sizeof(double));
+    CheckpointWrite(pCheckpoint, &pHist->mM2, sizeof(double));
+    CheckpointWrite(pCheckpoint, &used, sizeof(int));
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        if (!pHist->mCounts[i])
+            continue;
+        CheckpointWrite(pCheckpoint, &i, sizeof(int));
+        CheckpointWrite(pCheckpoint, &pHist->mCounts[i], sizeof(long));
+    }
+}
+
+void CheckpointReadHistogram(Checkpoint *pCheckpoint, Histogram *pHist) {
+    int used = 0, index = 0;
+    HistogramInit(pHist, 1);
+    CheckpointRead(pCheckpoint, &pHist->mScale, sizeof(double));
+    CheckpointRead(pCheckpoint, &pHist->mTotal, sizeof(long));
+    CheckpointRead(pCheckpoint, &pHist->mMax, sizeof(long));
+    CheckpointRead(pCheckpoint, &pHist->mMean, sizeof(double));
+    CheckpointRead(pCheckpoint, &pHist->mM2, sizeof(double));
+    CheckpointRead(pCheckpoint, &used, sizeof(int));
+    for (int i = 0; i < used && !pCheckpoint->mFailed; ++i) {
+        CheckpointRead(pCheckpoint, &index, sizeof(int));
+        if (index < 0 || index >= HIST_BUCKETS)
+            pCheckpoint->mFailed = 1;
+        else
+            CheckpointRead(pCheckpoint, &pHist->mCounts[index], sizeof(long));
+    }
+}
+
+#endif //SRTN_BUDDY_CHECKPOINT_H
@@ -0,0 +1,186 @@
+//
+// Several schedulers fed by one process_generator over Unix domain sockets
+// with --nodes the generator becomes a coordinator: it starts one scheduler per node, each with its own memory, and
+// connects to every one through a socket pair of sequenced packets, so messages keep their boundaries as they do on
+// the SysV queue. It sends the same MSG_TABLE and MSG_ARRIVALS messages a single scheduler gets, picking the node of
+// every arriving process with a shard policy, and a MSG_END once every process was sent. Nodes answer with their load
+// whenever they wake up and with a summary of their run before they exit, which the coordinator merges into the
+// global Stats.txt.
+//
+
+#ifndef SRTN_BUDDY_CLUSTER_H
+#define SRTN_BUDDY_CLUSTER_H
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "MessageBuffer.h"
+#include "Histogram.h"
+
+#define MAX_NODES 16
+#define CLUSTER_SOCKET_FD 3 //a node finds its end of the socket pair here
+
+enum ShardPolicy {
+    SHARD_HASH, //hash of the process id, placement does not depend on load
+    SHARD_LEAST_LOADED, //node with the fewest ticks of work left
+    SHARD_LARGEST_FREE, //node with the largest free block
+    SHARD_POLICY_COUNT
+};
+
+const char *gpShardNames[SHARD_POLICY_COUNT] = {"hash", "least-loaded", "largest-free"};
+
+int FindShardPolicy(const char *pName) { //-1 if there is no policy with this name
+    for (int i = 0; i < SHARD_POLICY_COUNT; ++i)
+        if (!strcmp(gpShardNames[i], pName))
+            return i;
+    return -1;
+}
+
+enum NodeReportType {
+    NODE_STATUS = 1, //load of the node, sent whenever it wakes up
+    NODE_SUMMARY = 2, //statistics of the whole run, sent once before the node exits
+};
+
+typedef struct NodeStatus {
+    long mWork; //ticks left of every process that arrived and did not finish
+    long mArrivedWork; //runtime of every process received so far, the coordinator counts what is still in flight
+    long mArrivedMem;
+    int mFreeBytes;
+    int mLargestFree;
+} NodeStatus;
+
+typedef struct NodeSummary {
+    unsigned int mFinished;
+    unsigned int mRuntimeSum;
+    unsigned int mWaitingSum;
+    unsigned int mStartTime;
+    unsigned int mEndTime;
+    int mPeakResident;
+    unsigned int mFailedAllocs;
+    double mCpuUser; //seconds of the node's scheduler
+    double mCpuSystem;
+    long mMaxRss; //KB
+    unsigned int mSwapOuts;
+    unsigned int mSwapIns;
+    unsigned int mBytesSwapped;
+    unsigned int mSwapTicks;
+    unsigned int mContextSwitches;
+    unsigned int mPreemptions;
+    Histogram mWait;
+    Histogram mTa;
+    Histogram mWta;
+    Histogram mDispatch;
+} NodeSummary;
+
+typedef struct NodeReport {
+    long mType;
+    NodeStatus mStatus;
+    NodeSummary mSummary; //NODE_SUMMARY only, a status is sent without it
+} NodeReport;
+
+typedef struct ClusterNode {
+    int mSocket; //coordinator end of the socket pair
+    pid_t mPid;
+    NodeStatus mStatus; //last one reported
+    long mSentWork; //runtime of every process sent to the node
+    long mSentMem;
+    unsigned int mSent;
+    int mDone; //the summary arrived
+    NodeSummary mSummary;
+    Message mBatch; //arrivals of this tick not sent yet
+    int mSignal; //got arrivals this tick, it is woken up once the tick is sent
+} ClusterNode;
+
+/*
+** int error = ClusterSend(int socket, const Message *pMsg)
+** send one message with the bytes msgsnd would, -1 if the node is gone
+*/
+int ClusterSend(int socket, const Message *pMsg) {
+    size_t size = offsetof(Message, mCount) + MessageSize(pMsg);
+    while (send(socket, pMsg, size, MSG_NOSIGNAL) == -1)
+        if (errno != EINTR)
+            return -1;
+    return 0;
+}
+
+/*
+** int error = ClusterReceive(int socket, Message *pMsg, int flags)
+** next message from the coordinator, flags is 0 to wait for one or MSG_DONTWAIT, -1 with errno set if there is none
+*/
+int ClusterReceive(int socket, Message *pMsg, int flags) {
+    ssize_t size;
+    while ((size = recv(socket, pMsg, sizeof(Message), flags)) == -1 && errno == EINTR);
+    if (size == 0)
+        errno = ECONNRESET; //the coordinator is gone
+    return size > 0 ? 0 : -1;
+}
+
+/*
+** int error = ClusterReport(int socket, const NodeReport *pReport)
+** a status is dropped if the socket is full, a newer one follows, a summary waits until it fits
+*/
+int ClusterReport(int socket, const NodeReport *pReport) {
+    int summary = pReport->mType == NODE_SUMMARY;
+    size_t size = summary ? sizeof(NodeReport) : offsetof(NodeReport, mSummary);
+    while (send(socket, pReport, size, MSG_NOSIGNAL | (summary ? 0 : MSG_DONTWAIT)) == -1)
+        if (errno != EINTR)
+            return -1;
+    return 0;
+}
+
+/*
+** void ClusterDrain(ClusterNode *pNode, int wait)
+** take in every report the node sent, with wait set keep reading until its summary arrived or it is gone
+*/
+void ClusterDrain(ClusterNode *pNode, int wait) {
+    NodeReport report;
+    while (!pNode->mDone) {
+        ssize_t size = recv(pNode->mSocket, &report, sizeof(NodeReport), wait ? 0 : MSG_DONTWAIT);
+        if (size == -1 && errno == EINTR)
+            continue;
+        if (size == 0 || (size == -1 && (wait || (errno != EAGAIN && errno != EWOULDBLOCK)))) {
+            pNode->mDone = 1; //closed without a summary, it stays empty
+            return;
+        }
+        if (size == -1)
+            return;
+        if (report.mType == NODE_STATUS)
+            pNode->mStatus = report.mStatus;
+        else if (report.mType == NODE_SUMMARY && size == sizeof(NodeReport)) {
+            pNode->mStatus = report.mStatus;
+            pNode->mSummary = report.mSummary;
+            pNode->mDone = 1;
+        }
+    }
+}
+
+/*
+** int node = ShardPick(const ClusterNode *pNodes, int count, enum ShardPolicy policy, const Process *pProcess)
+** node the process is sent to. Reports lag behind, so what was sent since the last one is counted as well: in flight
+** work adds to the load and in flight bytes are taken off the largest free block
+*/
+int ShardPick(const ClusterNode *pNodes, int count, enum ShardPolicy policy, const Process *pProcess) {
+    if (policy == SHARD_HASH)
+        return (int) (((pProcess->mId * 2654435761u) >> 16) % (unsigned int) count); //Knuth's multiplicative hash
+    int best = 0;
+    long best_score = 0;
+    for (int i = 0; i < count; ++i) {
+        const ClusterNode *pNode = &pNodes[i];
+        long in_flight_work = pNode->mSentWork - pNode->mStatus.mArrivedWork;
+        long in_flight_mem = pNode->mSentMem - pNode->mStatus.mArrivedMem;
+        long work = pNode->mStatus.mWork + in_flight_work;
+        long score; //lower is better
+        if (policy == SHARD_LEAST_LOADED)
+            score = work;
+        else //most room first, equal room goes to the least loaded
+            score = -(pNode->mStatus.mLargestFree - in_flight_mem) * (1L << 32) + work;
+        if (!i || score < best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+#endif //SRTN_BUDDY_CLUSTER_H
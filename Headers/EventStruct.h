@@ -8,7 +8,7 @@
 #include "ProcessStruct.h"
 
 enum EventType {
-    START, STOP, CONT, FINISH
+    START, STOP, CONT, FINISH, RELOCATE, RESIZE, SWAP_OUT, SWAP_IN
 };
 
 typedef struct EventStruct {
@@ -17,6 +17,11 @@ typedef struct EventStruct {
     unsigned int mTimeStep;
     unsigned int mCurrentRemTime;
     unsigned int mCurrentWaitTime;
+    int mMemAddr; //memory address of the process when the event happened, compaction may move it later
+    int mOldMemAddr; //address the memory was moved from, only used by RELOCATE
+    int mMemPool; //pool of mMemAddr, -1 with a single pool
+    unsigned int mMemSize; //memory size and allocation of the process when the event happened, RESIZE changes them
+    unsigned int mMemAlloc;
     unsigned int mTaTime;
     double mWTaTime;
 } Event;
@@ -25,8 +30,8 @@ void PrintEvent(const Event *pEvent) { //print an event using the same output fi
     printf("At time %d ", pEvent->mTimeStep);
     switch (pEvent->mType) {
         case START:
-            printf("allocated %d bytes for process %d ", pEvent->mpProcess->mMemSize, pEvent->mpProcess->mId);
-            printf("from %d to %d", pEvent->mpProcess->mMemAddr, pEvent->mpProcess->mMemAlloc + pEvent->mpProcess->mMemAddr - 1);
+            printf("allocated %d bytes for process %d ", pEvent->mMemSize, pEvent->mpProcess->mId);
+            printf("from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
             break;
         case STOP:
             printf("process %d stopped ", pEvent->mpProcess->mId);
@@ -39,13 +44,31 @@ void PrintEvent(const Event *pEvent) { //print an event using the same output fi
             printf("remain %d wait %d", pEvent->mCurrentRemTime, pEvent->mCurrentWaitTime);
             break;
         case FINISH:
-            printf("freed %d bytes from process %d ", pEvent->mpProcess->mMemSize, pEvent->mpProcess->mId);
-            printf("from %d to %d", pEvent->mpProcess->mMemAddr, pEvent->mpProcess->mMemAlloc + pEvent->mpProcess->mMemAddr - 1);
+            printf("freed %d bytes from process %d ", pEvent->mMemSize, pEvent->mpProcess->mId);
+            printf("from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
+            break;
+        case RELOCATE:
+            printf("moved %d bytes of process %d ", pEvent->mMemAlloc, pEvent->mpProcess->mId);
+            printf("from %d to %d", pEvent->mOldMemAddr, pEvent->mMemAddr);
+            break;
+        case RESIZE:
+            printf("resized process %d to %d bytes ", pEvent->mpProcess->mId, pEvent->mMemSize);
+            printf("from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
+            break;
+        case SWAP_OUT:
+            printf("swapped out %d bytes of process %d ", pEvent->mMemAlloc, pEvent->mpProcess->mId);
+            printf("from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
+            break;
+        case SWAP_IN:
+            printf("swapped in %d bytes of process %d ", pEvent->mMemAlloc, pEvent->mpProcess->mId);
+            printf("from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
             break;
         default:
             printf("error ");
             break;
     }
+    if (pEvent->mMemPool != -1 && pEvent->mType != STOP && pEvent->mType != CONT)
+        printf(" in pool %d", pEvent->mMemPool);
 
     printf("\n");
 }
@@ -54,8 +77,8 @@ void OutputEvent(const Event *pEvent, FILE *pFile) { //print an event using the
     fprintf(pFile,"At time %d ", pEvent->mTimeStep);
     switch (pEvent->mType) {
         case START:
-            fprintf(pFile,"allocated %d bytes for process %d ", pEvent->mpProcess->mMemSize, pEvent->mpProcess->mId);
-            fprintf(pFile,"from %d to %d", pEvent->mpProcess->mMemAddr, pEvent->mpProcess->mMemAlloc + pEvent->mpProcess->mMemAddr - 1);
+            fprintf(pFile,"allocated %d bytes for process %d ", pEvent->mMemSize, pEvent->mpProcess->mId);
+            fprintf(pFile,"from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
             break;
         case STOP:
             fprintf(pFile,"process %d stopped ", pEvent->mpProcess->mId);
@@ -68,13 +91,31 @@ void OutputEvent(const Event *pEvent, FILE *pFile) { //print an event using the
             fprintf(pFile,"remain %d wait %d", pEvent->mCurrentRemTime, pEvent->mCurrentWaitTime);
             break;
         case FINISH:
-            fprintf(pFile,"freed %d bytes from process %d ", pEvent->mpProcess->mMemSize, pEvent->mpProcess->mId);
-            fprintf(pFile,"from %d to %d", pEvent->mpProcess->mMemAddr, pEvent->mpProcess->mMemAlloc + pEvent->mpProcess->mMemAddr - 1);
+            fprintf(pFile,"freed %d bytes from process %d ", pEvent->mMemSize, pEvent->mpProcess->mId);
+            fprintf(pFile,"from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
+            break;
+        case RELOCATE:
+            fprintf(pFile,"moved %d bytes of process %d ", pEvent->mMemAlloc, pEvent->mpProcess->mId);
+            fprintf(pFile,"from %d to %d", pEvent->mOldMemAddr, pEvent->mMemAddr);
+            break;
+        case RESIZE:
+            fprintf(pFile,"resized process %d to %d bytes ", pEvent->mpProcess->mId, pEvent->mMemSize);
+            fprintf(pFile,"from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
+            break;
+        case SWAP_OUT:
+            fprintf(pFile,"swapped out %d bytes of process %d ", pEvent->mMemAlloc, pEvent->mpProcess->mId);
+            fprintf(pFile,"from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
+            break;
+        case SWAP_IN:
+            fprintf(pFile,"swapped in %d bytes of process %d ", pEvent->mMemAlloc, pEvent->mpProcess->mId);
+            fprintf(pFile,"from %d to %d", pEvent->mMemAddr, pEvent->mMemAlloc + pEvent->mMemAddr - 1);
             break;
         default:
             fprintf(pFile,"error ");
             break;
     }
+    if (pEvent->mMemPool != -1 && pEvent->mType != STOP && pEvent->mType != CONT)
+        fprintf(pFile, " in pool %d", pEvent->mMemPool);
     fprintf(pFile, "\n");
 }
 
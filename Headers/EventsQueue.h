@@ -21,7 +21,7 @@ typedef Event *EVENT_DATA;
 #define TAIL_E(q) q->next
 
 event_queue NewEventQueue() {
-    e_node q = (e_node) malloc(sizeof(node_t));
+    e_node q = (e_node) malloc(sizeof(e_node_t));
     q->next = q->prev = 0;
     return q;
 }
@@ -31,7 +31,7 @@ int EventQueueEmpty(event_queue q) {
 }
 
 void EventQueueEnqueue(event_queue q, EVENT_DATA val) {
-    e_node nd = (e_node) malloc(sizeof(node_t));
+    e_node nd = (e_node) malloc(sizeof(e_node_t));
     nd->val = val;
     if (!HEAD_E(q))
         HEAD_E(q) = nd;
@@ -0,0 +1,111 @@
+//
+// Fixed memory histograms for tail percentiles, in the style of HdrHistogram
+// values below HIST_SUB_COUNT get a bucket each, above that every power of 2 is cut into HIST_SUB_COUNT / 2 linear
+// buckets, so any recorded value is reported within 1 / 64 of itself. Recording is O(1) and the memory never grows;
+// values are scaled to integers first, larger than HIST_MAX_VALUE ones land in the last bucket. Mean and variance
+// are kept with Welford's update, which stays precise where summing squares does not.
+//
+
+#ifndef SRTN_BUDDY_HISTOGRAM_H
+#define SRTN_BUDDY_HISTOGRAM_H
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HIST_SUB_BITS 7
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_SHIFT 34 //values up to 2^40
+#define HIST_BUCKETS (HIST_SUB_COUNT + HIST_MAX_SHIFT * HIST_SUB_COUNT / 2)
+#define HIST_MAX_VALUE ((1L << (HIST_MAX_SHIFT + HIST_SUB_BITS)) - 1)
+
+typedef struct Histogram {
+    double mScale; //integer units per unit of the recorded values, 1000 keeps 3 decimals
+    long mCounts[HIST_BUCKETS];
+    long mTotal;
+    long mMax; //scaled
+    double mMean;
+    double mM2; //sum of squared distances from the mean
+} Histogram;
+
+void HistogramInit(Histogram *pHist, double scale) {
+    memset(pHist, 0, sizeof(Histogram));
+    pHist->mScale = scale;
+}
+
+int HistogramIndex(long value) {
+    if (value < HIST_SUB_COUNT)
+        return (int) value;
+    int shift = 63 - __builtin_clzl((unsigned long) value) - (HIST_SUB_BITS - 1); //keeps HIST_SUB_BITS significant bits
+    return HIST_SUB_COUNT + (shift - 1) * HIST_SUB_COUNT / 2 + (int) (value >> shift) - HIST_SUB_COUNT / 2;
+}
+
+long HistogramHighest(int index) { //largest value that lands in a bucket
+    if (index < HIST_SUB_COUNT)
+        return index;
+    int shift = (index - HIST_SUB_COUNT) / (HIST_SUB_COUNT / 2) + 1;
+    long sub = (index - HIST_SUB_COUNT) % (HIST_SUB_COUNT / 2) + HIST_SUB_COUNT / 2;
+    return ((sub + 1) << shift) - 1;
+}
+
+void HistogramRecord(Histogram *pHist, double value) {
+    long scaled = lround(value * pHist->mScale);
+    if (scaled < 0)
+        scaled = 0;
+    if (scaled > HIST_MAX_VALUE)
+        scaled = HIST_MAX_VALUE;
+    pHist->mCounts[HistogramIndex(scaled)]++;
+    if (scaled > pHist->mMax)
+        pHist->mMax = scaled;
+    pHist->mTotal++;
+    double delta = value - pHist->mMean;
+    pHist->mMean += delta / pHist->mTotal;
+    pHist->mM2 += delta * (value - pHist->mMean);
+}
+
+/*
+** double value = HistogramPercentile(const Histogram *pHist, double percentile)
+** smallest recorded value that percentile percent of the samples do not exceed, 0 if nothing was recorded
+*/
+double HistogramPercentile(const Histogram *pHist, double percentile) {
+    long rank = (long) ceil(percentile / 100 * pHist->mTotal), seen = 0;
+    if (rank < 1)
+        rank = 1;
+    for (int i = 0; i < HIST_BUCKETS && pHist->mTotal; ++i)
+        if ((seen += pHist->mCounts[i]) >= rank) {
+            long highest = HistogramHighest(i);
+            return (highest < pHist->mMax ? highest : pHist->mMax) / pHist->mScale;
+        }
+    return 0;
+}
+
+/*
+** void HistogramMerge(Histogram *pInto, const Histogram *pFrom)
+** add the samples of pFrom to pInto as if they had been recorded there, both must have the same scale
+*/
+void HistogramMerge(Histogram *pInto, const Histogram *pFrom) {
+    if (!pFrom->mTotal)
+        return;
+    for (int i = 0; i < HIST_BUCKETS; ++i)
+        pInto->mCounts[i] += pFrom->mCounts[i];
+    if (pFrom->mMax > pInto->mMax)
+        pInto->mMax = pFrom->mMax;
+    long total = pInto->mTotal + pFrom->mTotal; //Chan's update combines the two means and variances
+    double delta = pFrom->mMean - pInto->mMean;
+    pInto->mM2 += pFrom->mM2 + delta * delta * pInto->mTotal * pFrom->mTotal / total;
+    pInto->mMean += delta * pFrom->mTotal / total;
+    pInto->mTotal = total;
+}
+
+double HistogramStd(const Histogram *pHist) { //population standard deviation
+    return pHist->mTotal ? sqrt(pHist->mM2 / pHist->mTotal) : 0;
+}
+
+void PrintPercentiles(FILE *pFile, const char *pName, const Histogram *pHist, int decimals) { //one Stats.txt line
+    fprintf(pFile, "%s p50 = %.*f, p90 = %.*f, p99 = %.*f, p99.9 = %.*f, max = %.*f\n", pName,
+            decimals, HistogramPercentile(pHist, 50), decimals, HistogramPercentile(pHist, 90),
+            decimals, HistogramPercentile(pHist, 99), decimals, HistogramPercentile(pHist, 99.9),
+            decimals, HistogramPercentile(pHist, 100));
+}
+
+#endif //SRTN_BUDDY_HISTOGRAM_H
@@ -0,0 +1,161 @@
+//
+// Leveled console logging that never blocks the caller on stdout
+// lines at or below gLogLevel are formatted into a bounded lock-free ring and written out by a background thread.
+// Claiming a slot is one compare and swap on the head and every slot carries a sequence number, so a signal handler
+// may log while the code it interrupted is halfway through a line. When the ring is full the line is dropped and
+// counted instead of waiting. Before LogStart, after LogShutdown or in a forked child lines are printed directly.
+// LOG_INFO, the default, only reports the run itself, LOG_DEBUG adds a line for every job, message and event.
+//
+
+#ifndef SRTN_BUDDY_LOG_H
+#define SRTN_BUDDY_LOG_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+
+#define LOG_RING_SIZE 1024 //a power of 2
+#define LOG_LINE_SIZE 192 //longer lines are cut
+
+enum LogLevel {
+    LOG_ERROR,
+    LOG_INFO,
+    LOG_DEBUG,
+    LOG_LEVEL_COUNT
+};
+
+const char *gpLogLevelNames[LOG_LEVEL_COUNT] = {"error", "info", "debug"};
+
+typedef struct LogSlot {
+    unsigned long mSequence; //position + 1 once the line at position is written, position + LOG_RING_SIZE once printed
+    char mText[LOG_LINE_SIZE];
+} LogSlot;
+
+typedef struct Logger {
+    LogSlot mSlots[LOG_RING_SIZE];
+    unsigned long mHead; //next position producers claim
+    unsigned long mTail; //next position the thread prints, only it touches this
+    unsigned long mDropped;
+    int mRunning;
+    int mStop;
+    pthread_t mThread;
+} Logger;
+
+Logger gLogger;
+enum LogLevel gLogLevel = LOG_INFO;
+
+#define LOG(level, ...) do { if ((level) <= gLogLevel) LogWrite(__VA_ARGS__); } while (0)
+
+int FindLogLevel(const char *pName) { //-1 if there is no level with this name
+    for (int i = 0; i < LOG_LEVEL_COUNT; ++i)
+        if (!strcmp(gpLogLevelNames[i], pName))
+            return i;
+    return -1;
+}
+
+void LogWrite(const char *pFormat, ...) __attribute__((format(printf, 1, 2)));
+
+void LogWrite(const char *pFormat, ...) {
+    va_list args;
+    va_start(args, pFormat);
+    if (!__atomic_load_n(&gLogger.mRunning, __ATOMIC_ACQUIRE)) {
+        vprintf(pFormat, args);
+        va_end(args);
+        return;
+    }
+    unsigned long position = __atomic_load_n(&gLogger.mHead, __ATOMIC_RELAXED);
+    LogSlot *pSlot;
+    for (;;) {
+        pSlot = &gLogger.mSlots[position & (LOG_RING_SIZE - 1)];
+        long lag = (long) (__atomic_load_n(&pSlot->mSequence, __ATOMIC_ACQUIRE) - position);
+        if (lag == 0) { //free, try to claim it
+            if (__atomic_compare_exchange_n(&gLogger.mHead, &position, position + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        } else if (lag < 0) { //still holds a line from the previous lap, the ring is full
+            __atomic_fetch_add(&gLogger.mDropped, 1, __ATOMIC_RELAXED);
+            va_end(args);
+            return;
+        } else {
+            position = __atomic_load_n(&gLogger.mHead, __ATOMIC_RELAXED);
+        }
+    }
+    vsnprintf(pSlot->mText, LOG_LINE_SIZE, pFormat, args);
+    va_end(args);
+    __atomic_store_n(&pSlot->mSequence, position + 1, __ATOMIC_RELEASE);
+}
+
+void *LogThread(void *pArg) {
+    struct timespec idle = {0, 1000000};
+    for (;;) {
+        LogSlot *pSlot = &gLogger.mSlots[gLogger.mTail & (LOG_RING_SIZE - 1)];
+        if (__atomic_load_n(&pSlot->mSequence, __ATOMIC_ACQUIRE) == gLogger.mTail + 1) {
+            fputs(pSlot->mText, stdout);
+            __atomic_store_n(&pSlot->mSequence, gLogger.mTail + LOG_RING_SIZE, __ATOMIC_RELEASE);
+            gLogger.mTail++;
+            continue;
+        }
+        fflush(stdout);
+        //stop once asked to and every claimed line is out
+        if (__atomic_load_n(&gLogger.mStop, __ATOMIC_ACQUIRE) &&
+            __atomic_load_n(&gLogger.mHead, __ATOMIC_ACQUIRE) == gLogger.mTail)
+            return NULL;
+        nanosleep(&idle, NULL);
+    }
+}
+
+void LogShutdown() { //print what is left in the ring and go back to direct printing
+    if (!__atomic_load_n(&gLogger.mRunning, __ATOMIC_ACQUIRE))
+        return;
+    __atomic_store_n(&gLogger.mStop, 1, __ATOMIC_RELEASE);
+    pthread_join(gLogger.mThread, NULL);
+    __atomic_store_n(&gLogger.mRunning, 0, __ATOMIC_RELEASE);
+    if (gLogger.mDropped)
+        printf("LOG: *** %lu lines dropped, the ring was full\n", gLogger.mDropped);
+    fflush(stdout);
+}
+
+void LogBeforeFork() { //the logger thread must not hold stdout while we fork, the child would never get it
+    flockfile(stdout);
+    fflush(stdout);
+}
+
+void LogParentForked() {
+    funlockfile(stdout);
+}
+
+void LogChildForked() { //the child has no logger thread, it prints directly until it execs
+    __atomic_store_n(&gLogger.mRunning, 0, __ATOMIC_RELEASE);
+    funlockfile(stdout);
+}
+
+/*
+** void LogStart()
+** start the background thread, lines logged from now on go through the ring, it is drained at exit
+*/
+void LogStart() {
+    for (unsigned long i = 0; i < LOG_RING_SIZE; ++i)
+        gLogger.mSlots[i].mSequence = i;
+    gLogger.mHead = gLogger.mTail = gLogger.mDropped = 0;
+    gLogger.mStop = 0;
+    //the thread starts with every signal blocked, so handlers only ever run on the threads that wait for them
+    sigset_t all_set, old_set;
+    sigfillset(&all_set);
+    pthread_sigmask(SIG_SETMASK, &all_set, &old_set);
+    int error = pthread_create(&gLogger.mThread, NULL, LogThread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    if (error) {
+        fprintf(stderr, "LOG: *** Error starting the logger thread, printing directly: %s\n", strerror(error));
+        return;
+    }
+    __atomic_store_n(&gLogger.mRunning, 1, __ATOMIC_RELEASE);
+    pthread_atfork(LogBeforeFork, LogParentForked, LogChildForked);
+    atexit(LogShutdown);
+}
+
+
+#endif //SRTN_BUDDY_LOG_H
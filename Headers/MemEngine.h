@@ -0,0 +1,205 @@
+//
+// Memory engines the scheduler can run on, picked at startup with --mem-variant
+// every engine manages the simulated memory behind the same calls as AllocateMem and FreeMem. "buddy" is the thread-safe
+// library allocator, the "tree-" engines keep the buddy state in an implicit binary tree and differ only in placement,
+// "weighted" and "fibonacci" split blocks unevenly for finer size classes, the others are compile-time specialized
+// variants with preset sizes.
+//
+
+#ifndef SRTN_BUDDY_MEMENGINE_H
+#define SRTN_BUDDY_MEMENGINE_H
+
+#include <stdio.h>
+#include <string.h>
+#include "BuddyAllocator.h"
+#include "BuddyVariant.h"
+#include "BuddyTree.h"
+#include "SplitBuddy.h"
+
+typedef struct MemEngine {
+    const char *mpName;
+    const char *mpDescription;
+    int mPoolSize;
+    int (*mpInit)(); //0 on success
+    int (*mpAlloc)(int size); //address of a block of at least size bytes, -1 if none is free
+    void (*mpFree)(int addr);
+    int (*mpFreeBytes)();
+    int (*mpLargestFree)(); //size of the largest block an allocation could get now, 0 if none
+    int (*mpRound)(int size); //bytes a request of this size really takes
+    int (*mpSave)(FILE *pFile); //write the whole allocator state, -1 on failure
+    int (*mpLoad)(FILE *pFile); //replace the state of an initialized engine with a saved one, -1 on failure
+} MemEngine;
+
+BuddyAllocator *gpEngineBuddy = NULL; //handle of the "buddy" engine, NULL while another engine runs
+
+int LibraryEngineInit() {
+    if (gpEngineBuddy)
+        BuddyDestroy(gpEngineBuddy);
+    gpEngineBuddy = BuddyCreate(1024, 2, 256, 0); //single threaded, so no per-thread caches
+    return gpEngineBuddy ? 0 : -1;
+}
+
+int LibraryEngineAlloc(int size) {
+    return BuddyAlloc(gpEngineBuddy, size);
+}
+
+void LibraryEngineFree(int addr) {
+    BuddyFree(gpEngineBuddy, addr);
+}
+
+int LibraryEngineFreeBytes() {
+    return BuddyFreeBytes(gpEngineBuddy);
+}
+
+int LibraryEngineLargestFree() {
+    return BuddyLargestFree(gpEngineBuddy);
+}
+
+int LibraryEngineRound(int size) {
+    return BuddyOrderSize(gpEngineBuddy, BuddyOrderOf(gpEngineBuddy, size));
+}
+
+int LibraryEngineSave(FILE *pFile) {
+    return BuddySave(gpEngineBuddy, pFile);
+}
+
+int LibraryEngineLoad(FILE *pFile) {
+    return BuddyLoad(gpEngineBuddy, pFile);
+}
+
+BuddyTree *gpEngineTree = NULL;
+
+int TreeEngineInit(enum TreePolicy policy) {
+    if (gpEngineTree)
+        BuddyTreeDestroy(gpEngineTree);
+    gpEngineTree = BuddyTreeCreate(1024, 2, 256, policy);
+    return gpEngineTree ? 0 : -1;
+}
+
+int TreeLowestEngineInit() {
+    return TreeEngineInit(TREE_LOWEST_ADDRESS);
+}
+
+int TreeBestFitEngineInit() {
+    return TreeEngineInit(TREE_BEST_FIT);
+}
+
+int TreeEngineAlloc(int size) {
+    return BuddyTreeAlloc(gpEngineTree, size);
+}
+
+void TreeEngineFree(int addr) {
+    BuddyTreeFree(gpEngineTree, addr);
+}
+
+int TreeEngineFreeBytes() {
+    return BuddyTreeFreeBytes(gpEngineTree);
+}
+
+int TreeEngineLargestFree() {
+    return BuddyTreeLargestFree(gpEngineTree);
+}
+
+int TreeEngineRound(int size) {
+    return size <= 2 ? 2 : 1 << (32 - __builtin_clz((unsigned int) (size - 1)));
+}
+
+int TreeEngineSave(FILE *pFile) {
+    return BuddyTreeSave(gpEngineTree, pFile);
+}
+
+int TreeEngineLoad(FILE *pFile) {
+    return BuddyTreeLoad(gpEngineTree, pFile);
+}
+
+SplitBuddy *gpEngineSplit = NULL;
+
+int SplitEngineInit(int max_block, enum SplitRule rule) {
+    if (gpEngineSplit)
+        SplitBuddyDestroy(gpEngineSplit);
+    gpEngineSplit = SplitBuddyCreate(1024, 2, max_block, rule);
+    return gpEngineSplit ? 0 : -1;
+}
+
+int WeightedEngineInit() {
+    return SplitEngineInit(256, SPLIT_WEIGHTED);
+}
+
+int FibonacciEngineInit() {
+    return SplitEngineInit(288, SPLIT_FIBONACCI); //144 units, 128 would leave requests above 178 bytes without a block
+}
+
+int SplitEngineAlloc(int size) {
+    return SplitBuddyAlloc(gpEngineSplit, size);
+}
+
+void SplitEngineFree(int addr) {
+    SplitBuddyFree(gpEngineSplit, addr);
+}
+
+int SplitEngineFreeBytes() {
+    return SplitBuddyFreeBytes(gpEngineSplit);
+}
+
+int SplitEngineLargestFree() {
+    return SplitBuddyLargestFree(gpEngineSplit);
+}
+
+int SplitEngineRound(int size) {
+    return SplitBuddyRound(gpEngineSplit, size);
+}
+
+int SplitEngineSave(FILE *pFile) {
+    return SplitBuddySave(gpEngineSplit, pFile);
+}
+
+int SplitEngineLoad(FILE *pFile) {
+    return SplitBuddyLoad(gpEngineSplit, pFile);
+}
+
+DEFINE_BUDDY_VARIANT(Buddy1k, 1024, 2, 8)
+DEFINE_BUDDY_VARIANT(Buddy1kMin16, 1024, 16, 5)
+DEFINE_BUDDY_VARIANT(Buddy4k, 4096, 2, 8)
+
+const MemEngine gMemEngines[] = {
+        {"buddy",         "thread-safe library allocator, 1024 bytes in blocks of 2 to 256", 1024,
+                LibraryEngineInit, LibraryEngineAlloc, LibraryEngineFree, LibraryEngineFreeBytes,
+                LibraryEngineLargestFree, LibraryEngineRound, LibraryEngineSave, LibraryEngineLoad},
+        {"tree-lowest",   "implicit tree, lowest address first, 1024 bytes in blocks of 2 to 256", 1024,
+                TreeLowestEngineInit, TreeEngineAlloc, TreeEngineFree, TreeEngineFreeBytes,
+                TreeEngineLargestFree, TreeEngineRound, TreeEngineSave, TreeEngineLoad},
+        {"tree-bestfit",  "implicit tree, smallest fitting block first, 1024 bytes in blocks of 2 to 256", 1024,
+                TreeBestFitEngineInit, TreeEngineAlloc, TreeEngineFree, TreeEngineFreeBytes,
+                TreeEngineLargestFree, TreeEngineRound, TreeEngineSave, TreeEngineLoad},
+        {"weighted",      "weighted buddy, blocks of 2^k and 3 * 2^k, 1024 bytes in blocks of 2 to 256", 1024,
+                WeightedEngineInit, SplitEngineAlloc, SplitEngineFree, SplitEngineFreeBytes,
+                SplitEngineLargestFree, SplitEngineRound, SplitEngineSave, SplitEngineLoad},
+        {"fibonacci",     "Fibonacci buddy, 1024 bytes in blocks of 2 to 288", 1024,
+                FibonacciEngineInit, SplitEngineAlloc, SplitEngineFree, SplitEngineFreeBytes,
+                SplitEngineLargestFree, SplitEngineRound, SplitEngineSave, SplitEngineLoad},
+        {"buddy1k",       "compile-time variant, 1024 bytes in blocks of 2 to 256",         1024,
+                Buddy1kInit, Buddy1kAlloc, Buddy1kFree, Buddy1kFreeBytes,
+                Buddy1kLargestFree, Buddy1kRound, Buddy1kSave, Buddy1kLoad},
+        {"buddy1k-min16", "compile-time variant, 1024 bytes in blocks of 16 to 256",        1024,
+                Buddy1kMin16Init, Buddy1kMin16Alloc, Buddy1kMin16Free, Buddy1kMin16FreeBytes,
+                Buddy1kMin16LargestFree, Buddy1kMin16Round, Buddy1kMin16Save, Buddy1kMin16Load},
+        {"buddy4k",       "compile-time variant, 4096 bytes in blocks of 2 to 256",         4096,
+                Buddy4kInit, Buddy4kAlloc, Buddy4kFree, Buddy4kFreeBytes,
+                Buddy4kLargestFree, Buddy4kRound, Buddy4kSave, Buddy4kLoad},
+};
+
+#define MEM_ENGINE_COUNT ((int) (sizeof(gMemEngines) / sizeof(MemEngine)))
+
+const MemEngine *FindMemEngine(const char *pName) { //NULL if there is no engine with this name
+    for (int i = 0; i < MEM_ENGINE_COUNT; ++i)
+        if (!strcmp(gMemEngines[i].mpName, pName))
+            return &gMemEngines[i];
+    return NULL;
+}
+
+void PrintMemEngines() {
+    for (int i = 0; i < MEM_ENGINE_COUNT; ++i)
+        printf("  %-16s %s\n", gMemEngines[i].mpName, gMemEngines[i].mpDescription);
+}
+
+#endif //SRTN_BUDDY_MEMENGINE_H
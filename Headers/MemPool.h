@@ -0,0 +1,166 @@
+//
+// Independent memory pools, like the memory nodes of a NUMA host
+// every pool is its own buddy allocator with its own capacity and lock, so work on different pools never contends.
+// A placement policy picks the pool of every job and addresses are offsets inside the pool that holds them.
+// Pool i is local to cpu i modulo the online cpus, every job has a home pool given by its id.
+//
+
+#ifndef SRTN_BUDDY_MEMPOOL_H
+#define SRTN_BUDDY_MEMPOOL_H
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "BuddyAllocator.h"
+
+#define MAX_POOLS 16
+
+enum PoolPlacement {
+    PLACE_FIRST_FIT, //lowest numbered pool with a free block
+    PLACE_LEAST_LOADED, //pool with the smallest share of its memory in use
+    PLACE_CPU_AFFINE, //only the job's home pool, and the job runs on that pool's cpu
+    PLACE_COUNT
+};
+
+const char *gpPlacementNames[PLACE_COUNT] = {"first-fit", "least-loaded", "cpu-affine"};
+
+typedef struct MemPool {
+    BuddyAllocator *mpBuddy;
+    int mSize;
+    int mCpu;
+    int mUsed; //bytes allocated right now
+    int mPeakUsed;
+    unsigned int mAllocs;
+    unsigned int mFailedAllocs; //requests this pool was asked for and could not serve
+} MemPool;
+
+int FindPlacement(const char *pName) { //-1 if there is no policy with this name
+    for (int i = 0; i < PLACE_COUNT; ++i)
+        if (!strcmp(gpPlacementNames[i], pName))
+            return i;
+    return -1;
+}
+
+/*
+** int error = MemPoolsCreate(MemPool *pPools, const int *pSizes, int count)
+** one buddy allocator of 2 to 256 byte blocks per pool, every size must be a multiple of 256, -1 if one failed
+*/
+int MemPoolsCreate(MemPool *pPools, const int *pSizes, int count) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        cpus = 1;
+    for (int i = 0; i < count; ++i) {
+        memset(&pPools[i], 0, sizeof(MemPool));
+        pPools[i].mSize = pSizes[i];
+        pPools[i].mCpu = (int) (i % cpus);
+        if (!(pPools[i].mpBuddy = BuddyCreate(pSizes[i], 2, 256, 0)))
+            return -1;
+    }
+    return 0;
+}
+
+int MemPoolHome(int count, int id) { //pool local to a job
+    return id % count;
+}
+
+int MemPoolLoadBelow(const MemPool *pLeft, const MemPool *pRight) { //1 if pLeft has the smaller share in use
+    return (long) pLeft->mUsed * pRight->mSize < (long) pRight->mUsed * pLeft->mSize;
+}
+
+/*
+** int count = MemPoolOrder(MemPool *pPools, int count, enum PoolPlacement placement, int home, int *pOrder)
+** pools a job may be placed in, in the order the policy tries them
+*/
+int MemPoolOrder(MemPool *pPools, int count, enum PoolPlacement placement, int home, int *pOrder) {
+    if (placement == PLACE_CPU_AFFINE) {
+        pOrder[0] = home;
+        return 1;
+    }
+    for (int i = 0; i < count; ++i) {
+        int j = i;
+        if (placement == PLACE_LEAST_LOADED) //insertion sort, ties keep the lower pool first
+            for (; j > 0 && MemPoolLoadBelow(&pPools[i], &pPools[pOrder[j - 1]]); --j)
+                pOrder[j] = pOrder[j - 1];
+        pOrder[j] = i;
+    }
+    return count;
+}
+
+/*
+** int addr = MemPoolAlloc(MemPool *pPools, int count, enum PoolPlacement placement, int size, int home, int *pPool)
+** allocate size bytes in the first pool the policy allows that has room, its index goes to *pPool, -1 if none had
+*/
+int MemPoolAlloc(MemPool *pPools, int count, enum PoolPlacement placement, int size, int home, int *pPool) {
+    int order[MAX_POOLS];
+    int candidates = MemPoolOrder(pPools, count, placement, home, order);
+    for (int i = 0; i < candidates; ++i) {
+        MemPool *pCandidate = &pPools[order[i]];
+        int addr = BuddyAlloc(pCandidate->mpBuddy, size);
+        if (addr == -1) {
+            pCandidate->mFailedAllocs++;
+            continue;
+        }
+        pCandidate->mAllocs++;
+        if ((pCandidate->mUsed += size) > pCandidate->mPeakUsed)
+            pCandidate->mPeakUsed = pCandidate->mUsed;
+        *pPool = order[i];
+        return addr;
+    }
+    return -1;
+}
+
+void MemPoolFree(MemPool *pPool, int addr, int size) {
+    BuddyFree(pPool->mpBuddy, addr);
+    pPool->mUsed -= size;
+}
+
+/*
+** int fits = MemPoolFits(MemPool *pPools, int count, enum PoolPlacement placement, int size, int home)
+** 1 if a pool the policy allows has at least size bytes free, the blocks may still be scattered
+*/
+int MemPoolFits(MemPool *pPools, int count, enum PoolPlacement placement, int size, int home) {
+    int order[MAX_POOLS];
+    int candidates = MemPoolOrder(pPools, count, placement, home, order);
+    for (int i = 0; i < candidates; ++i)
+        if (BuddyFreeBytes(pPools[order[i]].mpBuddy) >= size)
+            return 1;
+    return 0;
+}
+
+void MemPoolPin(const MemPool *pPool, pid_t pid) { //run pid on the pool's cpu only
+    unsigned long mask = 1UL << (pPool->mCpu % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_sched_setaffinity, pid, sizeof(mask), &mask) == -1)
+        perror("POOL: *** Error pinning process");
+}
+
+/*
+** int error = MemPoolsSave(MemPool *pPools, int count, FILE *pFile)
+** write the usage counters and the allocator of every pool, the cpu a pool is local to is not saved
+*/
+int MemPoolsSave(MemPool *pPools, int count, FILE *pFile) {
+    for (int i = 0; i < count; ++i) {
+        int counters[] = {pPools[i].mSize, pPools[i].mUsed, pPools[i].mPeakUsed, (int) pPools[i].mAllocs,
+                          (int) pPools[i].mFailedAllocs};
+        if (fwrite(counters, sizeof(counters), 1, pFile) != 1 || BuddySave(pPools[i].mpBuddy, pFile))
+            return -1;
+    }
+    return 0;
+}
+
+int MemPoolsLoad(MemPool *pPools, int count, FILE *pFile) { //into pools created with the same sizes
+    for (int i = 0; i < count; ++i) {
+        int counters[5];
+        if (fread(counters, sizeof(counters), 1, pFile) != 1 || counters[0] != pPools[i].mSize)
+            return -1;
+        pPools[i].mUsed = counters[1];
+        pPools[i].mPeakUsed = counters[2];
+        pPools[i].mAllocs = (unsigned int) counters[3];
+        pPools[i].mFailedAllocs = (unsigned int) counters[4];
+        if (BuddyLoad(pPools[i].mpBuddy, pFile))
+            return -1;
+    }
+    return 0;
+}
+
+#endif //SRTN_BUDDY_MEMPOOL_H
@@ -1,14 +1,57 @@
 //
 // Created by shaffei on 3/24/20.
 //
+// Wire format between process_generator and the scheduler
+// the generator first sends one MSG_TABLE message with the number of processes and their largest id so the scheduler
+// can size its process table, then every tick one MSG_ARRIVALS message per ARRIVAL_BATCH processes arriving in it.
+// Only the fields read from processes.txt travel, packed in an array, and only mCount records of it are sent.
+// A cluster node also gets a MSG_END after its last arrival, it cannot tell from the table how many it will get.
+//
 
 #ifndef OS_STARTER_CODE_MESSAGEBUFFER_H
 #define OS_STARTER_CODE_MESSAGEBUFFER_H
 
+#include <stddef.h>
 #include "ProcessStruct.h"
 
+#define ARRIVAL_BATCH 64 //records per message
+
+enum MessageType {
+    MSG_TABLE = 1, //mCount processes with ids up to mMaxId will arrive
+    MSG_ARRIVALS = 2, //mCount arrival records
+    MSG_END = 3, //no process arrives after this one
+};
+
+typedef struct ArrivalRecord {
+    unsigned int mId;
+    unsigned int mArrivalTime;
+    unsigned int mRuntime;
+    unsigned int mPriority;
+    unsigned int mMemSize;
+    unsigned int mResizeAt; //0 if the process never resizes
+    unsigned int mResizeSize;
+} ArrivalRecord;
+
 typedef struct MessageBuffer {
     long mType;
-    Process mProcess;
+    int mCount;
+    unsigned int mMaxId; //MSG_TABLE only
+    ArrivalRecord mRecords[ARRIVAL_BATCH];
 } Message;
+
+size_t MessageSize(const Message *pMsg) { //bytes msgsnd sends, everything after mType up to the last record
+    size_t records = pMsg->mType == MSG_ARRIVALS ? pMsg->mCount * sizeof(ArrivalRecord) : 0;
+    return offsetof(Message, mRecords) - offsetof(Message, mCount) + records;
+}
+
+void ProcessToRecord(const Process *pProcess, ArrivalRecord *pRecord) {
+    pRecord->mId = pProcess->mId;
+    pRecord->mArrivalTime = pProcess->mArrivalTime;
+    pRecord->mRuntime = pProcess->mRuntime;
+    pRecord->mPriority = pProcess->mPriority;
+    pRecord->mMemSize = pProcess->mMemSize;
+    pRecord->mResizeAt = pProcess->mResizeAt;
+    pRecord->mResizeSize = pProcess->mResizeSize;
+}
+
 #endif //OS_STARTER_CODE_MESSAGEBUFFER_H
@@ -0,0 +1,111 @@
+//
+// Live counters of the scheduler in a shared memory page next to the clock segment
+// the scheduler is the only writer and updates them with relaxed atomic stores as it goes, readers such as srtnstat
+// attach read-only and poll at their own pace. Nothing is locked, so a reader may see one counter a step ahead of
+// another but never a torn value. Averages are fixed point with 3 decimals to stay integers.
+//
+
+#ifndef SRTN_BUDDY_METRICS_H
+#define SRTN_BUDDY_METRICS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include "headers.h"
+
+#define METRICS_KEY (SHKEY + 1)
+#define METRICS_NODE_KEY(node) (METRICS_KEY + 1 + (node)) //page of every scheduler of a cluster
+#define METRICS_MAGIC 0x53525453u //written last, a page without it is not ready
+#define METRICS_ORDERS 16
+#define METRICS_ROLLING_SHIFT 3 //rolling averages move 1/8 of the way to every new sample
+
+typedef struct MetricsPage {
+    unsigned int mMagic;
+    int mSchedulerPid;
+    int mDone; //1 once the scheduler logged its statistics
+    int mReadyLength; //processes waiting in the heap
+    int mRunningId; //0 while the cpu is idle
+    int mRunningRemain;
+    int mResident; //processes holding memory
+    int mFreeBytes;
+    int mMinBlock; //size of order 0
+    int mOrders; //0 if the memory engine does not report free blocks per order
+    int mFreeBlocks[METRICS_ORDERS];
+    unsigned long mArrivals;
+    unsigned long mAllocs;
+    unsigned long mFailedAllocs;
+    unsigned long mContextSwitches; //dispatches, every start and resume
+    unsigned long mFinished;
+    long mWaitRolling; //thousandths
+    long mWtaRolling;
+    long mWaitSum; //thousandths, divided by mFinished for the mean of the run
+    long mWtaSum;
+} MetricsPage;
+
+MetricsPage *gpMetrics = NULL; //NULL if the page could not be created, every update is skipped then
+key_t gMetricsKey = METRICS_KEY;
+
+#define METRIC_READ(pPage, field) __atomic_load_n(&(pPage)->field, __ATOMIC_RELAXED)
+#define METRIC_GET(field) METRIC_READ(gpMetrics, field)
+#define METRIC_SET(field, value) do { if (gpMetrics) __atomic_store_n(&gpMetrics->field, (value), __ATOMIC_RELAXED); } while (0)
+#define METRIC_ADD(field, value) METRIC_SET(field, METRIC_GET(field) + (value)) //single writer, no read-modify-write needed
+
+/*
+** int error = MetricsCreate()
+** create and attach the page for writing, -1 if that failed
+*/
+int MetricsCreate() {
+    int id = shmget(gMetricsKey, sizeof(MetricsPage), IPC_CREAT | 0644);
+    if (id == -1)
+        return -1;
+    void *pPage = shmat(id, NULL, 0);
+    if (pPage == (void *) -1)
+        return -1;
+    gpMetrics = pPage;
+    memset(gpMetrics, 0, sizeof(MetricsPage));
+    METRIC_SET(mSchedulerPid, getpid());
+    METRIC_SET(mMagic, METRICS_MAGIC);
+    return 0;
+}
+
+void MetricsFinished(double wait, double wta) { //fold a finished process into the rolling averages and sums
+    if (!gpMetrics)
+        return;
+    long wait_value = (long) (wait * 1000), wta_value = (long) (wta * 1000);
+    if (METRIC_GET(mFinished)) {
+        METRIC_ADD(mWaitRolling, (wait_value - METRIC_GET(mWaitRolling)) / (1 << METRICS_ROLLING_SHIFT));
+        METRIC_ADD(mWtaRolling, (wta_value - METRIC_GET(mWtaRolling)) / (1 << METRICS_ROLLING_SHIFT));
+    } else { //the first sample starts the averages
+        METRIC_SET(mWaitRolling, wait_value);
+        METRIC_SET(mWtaRolling, wta_value);
+    }
+    METRIC_ADD(mWaitSum, wait_value);
+    METRIC_ADD(mWtaSum, wta_value);
+    METRIC_ADD(mFinished, 1);
+}
+
+void MetricsDestroy() { //readers still attached keep the page until they detach
+    if (!gpMetrics)
+        return;
+    METRIC_SET(mDone, 1);
+    int id = shmget(gMetricsKey, sizeof(MetricsPage), 0);
+    shmdt(gpMetrics);
+    gpMetrics = NULL;
+    if (id != -1)
+        shmctl(id, IPC_RMID, NULL);
+}
+
+/*
+** const MetricsPage *pPage = MetricsAttach()
+** attach the page of a running scheduler read-only, NULL if there is none
+*/
+const MetricsPage *MetricsAttach() {
+    int id = shmget(gMetricsKey, sizeof(MetricsPage), 0444);
+    if (id == -1)
+        return NULL;
+    void *pPage = shmat(id, NULL, SHM_RDONLY);
+    return pPage == (void *) -1 ? NULL : pPage;
+}
+
+#endif //SRTN_BUDDY_METRICS_H
@@ -0,0 +1,299 @@
+//
+// Command line options of the simulation
+// process_generator parses them and forwards the same argument list to the scheduler, which parses them again
+//
+
+#ifndef SRTN_BUDDY_OPTIONS_H
+#define SRTN_BUDDY_OPTIONS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include "headers.h"
+#include "MemEngine.h"
+#include "MemPool.h"
+#include "Cluster.h"
+#include "Policy.h"
+#include "Log.h"
+
+typedef struct Options {
+    bool mClockWorkers; //workers follow the emulated clock instead of spinning on cpu time
+    bool mSlab; //small requests are served from slabs instead of power of 2 buddy blocks
+    int mLazyBuddy; //lazy blocks every buddy order may hold before they are merged, 0 merges on every free
+    double mCompactCost; //clock ticks charged per byte moved by compaction, 0 disables compaction
+    double mSwapCost; //clock ticks charged per byte swapped out or in, 0 disables the swap tier
+    const char *mpMemVariant; //name of the memory engine in gMemEngines
+    int mPoolCount; //independent memory pools, 0 lets the memory engine manage a single pool
+    int mPoolSizes[MAX_POOLS];
+    enum PoolPlacement mPlacement;
+    enum PolicyKind mPolicy; //how the ready processes are dispatched
+    int mQuantum; //ticks a process runs before round robin moves on
+    int mAging; //ticks waited that take one tick off the time compared by aging SRTN
+    long mTickUs; //length of one emulated clock tick
+    const char *mpRecordPath; //trace of the scheduler inputs to write, NULL if not recording
+    const char *mpReplayPath; //trace to replay instead of running the clock and the processes
+    const char *mpCheckpointPath; //snapshot written on SIGUSR2 and every mCheckpointEvery ticks
+    int mCheckpointEvery; //ticks between checkpoints, 0 only takes them on SIGUSR2
+    const char *mpRestorePath; //snapshot to resume from, NULL to start from the beginning
+    int mNodes; //schedulers process_generator shards the processes over, 0 runs a single one
+    enum ShardPolicy mShard;
+    int mNode; //index of this scheduler in a cluster, -1 if it is not part of one
+} Options;
+
+Options gOptions = {
+        .mClockWorkers = false,
+        .mSlab = false,
+        .mLazyBuddy = 0,
+        .mCompactCost = 0,
+        .mSwapCost = 0,
+        .mpMemVariant = "buddy",
+        .mPoolCount = 0,
+        .mPlacement = PLACE_FIRST_FIT,
+        .mPolicy = POLICY_SRTN,
+        .mQuantum = 2,
+        .mAging = 4,
+        .mTickUs = 1000000,
+        .mpRecordPath = NULL,
+        .mpReplayPath = NULL,
+        .mpCheckpointPath = "checkpoint.bin",
+        .mCheckpointEvery = 0,
+        .mpRestorePath = NULL,
+        .mNodes = 0,
+        .mShard = SHARD_HASH,
+        .mNode = -1,
+};
+
+enum OptionCodes {
+    OPT_CLOCK_WORKERS = 'c',
+    OPT_SLAB = 's',
+    OPT_LAZY_BUDDY = 'l',
+    OPT_COMPACT = 'm',
+    OPT_SWAP = 'w',
+    OPT_MEM_VARIANT = 'v',
+    OPT_POOLS = 'p',
+    OPT_PLACEMENT = 'P',
+    OPT_POLICY = 'a',
+    OPT_QUANTUM = 'q',
+    OPT_AGING = 'g',
+    OPT_LOG_LEVEL = 'L',
+    OPT_TICK = 't',
+    OPT_RECORD = 'r',
+    OPT_REPLAY = 'R',
+    OPT_CHECKPOINT = 'C',
+    OPT_CHECKPOINT_EVERY = 'k',
+    OPT_RESTORE = 'x',
+    OPT_NODES = 'n',
+    OPT_SHARD = 'S',
+    OPT_NODE = 256, //no short form, process_generator passes it to the schedulers it starts
+    OPT_HELP = 'h',
+};
+
+const struct option gLongOptions[] = {
+        {"clock-workers", no_argument, NULL, OPT_CLOCK_WORKERS},
+        {"slab",          no_argument, NULL, OPT_SLAB},
+        {"lazy-buddy",    required_argument, NULL, OPT_LAZY_BUDDY},
+        {"compact",       required_argument, NULL, OPT_COMPACT},
+        {"swap",          required_argument, NULL, OPT_SWAP},
+        {"mem-variant",   required_argument, NULL, OPT_MEM_VARIANT},
+        {"pools",         required_argument, NULL, OPT_POOLS},
+        {"placement",     required_argument, NULL, OPT_PLACEMENT},
+        {"policy",        required_argument, NULL, OPT_POLICY},
+        {"quantum",       required_argument, NULL, OPT_QUANTUM},
+        {"aging",         required_argument, NULL, OPT_AGING},
+        {"log-level",     required_argument, NULL, OPT_LOG_LEVEL},
+        {"tick",          required_argument, NULL, OPT_TICK},
+        {"record",        required_argument, NULL, OPT_RECORD},
+        {"replay",        required_argument, NULL, OPT_REPLAY},
+        {"checkpoint",    required_argument, NULL, OPT_CHECKPOINT},
+        {"checkpoint-every", required_argument, NULL, OPT_CHECKPOINT_EVERY},
+        {"restore",       required_argument, NULL, OPT_RESTORE},
+        {"nodes",         required_argument, NULL, OPT_NODES},
+        {"shard",         required_argument, NULL, OPT_SHARD},
+        {"node",          required_argument, NULL, OPT_NODE},
+        {"help",          no_argument, NULL, OPT_HELP},
+        {NULL, 0,                      NULL, 0}
+};
+
+void PrintUsage(const char *pName) {
+    printf("usage: %s [options]\n", pName);
+    printf("  -c, --clock-workers     jobs count emulated clock ticks and sleep between them instead of spinning\n");
+    printf("  -s, --slab              serve small requests from slab size classes instead of powers of 2\n");
+    printf("  -l, --lazy-buddy=N      keep up to N freed blocks per buddy order unmerged for reuse\n");
+    printf("  -m, --compact=COST      move stopped processes to fit a blocked job, charging COST ticks per byte\n");
+    printf("  -w, --swap=COST         swap stopped processes out to fit shorter jobs, charging COST ticks per byte\n");
+    printf("  -v, --mem-variant=NAME  memory engine to run on, 'list' prints them\n");
+    printf("  -p, --pools=SIZES       independent buddy pools, comma separated sizes in multiples of 256 bytes\n");
+    printf("  -P, --placement=POLICY  pool of every job: first-fit, least-loaded or cpu-affine\n");
+    printf("  -a, --policy=NAME       scheduling policy, srtn by default, 'list' prints them\n");
+    printf("  -q, --quantum=N         ticks every process runs in turn with --policy=rr, 2 by default\n");
+    printf("  -g, --aging=N           ticks waited that count as one tick less with --policy=aging, 4 by default\n");
+    printf("  -L, --log-level=LEVEL   console output: error, info (default) or debug for a line per job\n");
+    printf("  -t, --tick=USEC         length of a clock tick in microseconds, 1000000 by default, shorter implies -c\n");
+    printf("  -r, --record=FILE       write the inputs the scheduler sees to FILE so the run can be replayed\n");
+    printf("  -R, --replay=FILE       srtn.out only: replay a recorded run at full speed, with its options\n");
+    printf("  -C, --checkpoint=FILE   where SIGUSR2 to the scheduler writes a snapshot, checkpoint.bin by default\n");
+    printf("  -k, --checkpoint-every=N  also write the snapshot every N ticks\n");
+    printf("  -x, --restore=FILE      resume the run a snapshot was taken of, with its memory options\n");
+    printf("  -n, --nodes=N           shard the processes over N schedulers, each with its own memory\n");
+    printf("  -S, --shard=POLICY      node of every process with --nodes: hash, least-loaded or largest-free\n");
+    printf("  -h, --help              print this message\n");
+}
+
+void ParseOptions(int argc, char *argv[]) {
+    int opt;
+    optind = 1; //allow parsing more than once
+    while ((opt = getopt_long(argc, argv, "csl:m:w:v:p:P:a:q:g:L:t:r:R:C:k:x:n:S:h", gLongOptions, NULL)) != -1) {
+        switch (opt) {
+            case OPT_CLOCK_WORKERS:
+                gOptions.mClockWorkers = true;
+                break;
+            case OPT_SLAB:
+                gOptions.mSlab = true;
+                break;
+            case OPT_LAZY_BUDDY:
+                gOptions.mLazyBuddy = atoi(optarg);
+                if (gOptions.mLazyBuddy <= 0) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_COMPACT:
+                gOptions.mCompactCost = atof(optarg);
+                if (gOptions.mCompactCost <= 0) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_SWAP:
+                gOptions.mSwapCost = atof(optarg);
+                if (gOptions.mSwapCost <= 0) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_MEM_VARIANT:
+                if (!strcmp(optarg, "list")) {
+                    PrintMemEngines();
+                    exit(EXIT_SUCCESS);
+                }
+                if (!FindMemEngine(optarg)) {
+                    printf("unknown memory engine %s, one of:\n", optarg);
+                    PrintMemEngines();
+                    exit(EXIT_FAILURE);
+                }
+                gOptions.mpMemVariant = optarg;
+                break;
+            case OPT_POOLS: {
+                char *pEnd = optarg;
+                gOptions.mPoolCount = 0;
+                do { //sizes are separated by commas
+                    long size = strtol(pEnd + (pEnd != optarg), &pEnd, 10);
+                    if (size <= 0 || size % 256 || size > INT_MAX || gOptions.mPoolCount == MAX_POOLS ||
+                        (*pEnd && *pEnd != ',')) {
+                        PrintUsage(argv[0]);
+                        exit(EXIT_FAILURE);
+                    }
+                    gOptions.mPoolSizes[gOptions.mPoolCount++] = (int) size;
+                } while (*pEnd);
+                break;
+            }
+            case OPT_PLACEMENT:
+                if (FindPlacement(optarg) == -1) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                gOptions.mPlacement = FindPlacement(optarg);
+                break;
+            case OPT_POLICY:
+                if (!strcmp(optarg, "list")) {
+                    PrintPolicies();
+                    exit(EXIT_SUCCESS);
+                }
+                if (FindPolicy(optarg) == -1) {
+                    printf("unknown scheduling policy %s, one of:\n", optarg);
+                    PrintPolicies();
+                    exit(EXIT_FAILURE);
+                }
+                gOptions.mPolicy = FindPolicy(optarg);
+                break;
+            case OPT_QUANTUM:
+                gOptions.mQuantum = atoi(optarg);
+                if (gOptions.mQuantum <= 0) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_AGING:
+                gOptions.mAging = atoi(optarg);
+                if (gOptions.mAging <= 0) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_LOG_LEVEL:
+                if (FindLogLevel(optarg) == -1) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                gLogLevel = FindLogLevel(optarg);
+                break;
+            case OPT_TICK:
+                gOptions.mTickUs = atol(optarg);
+                if (gOptions.mTickUs <= 0) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                if (gOptions.mTickUs != 1000000) //spinning workers count cpu seconds, not ticks
+                    gOptions.mClockWorkers = true;
+                break;
+            case OPT_RECORD:
+                gOptions.mpRecordPath = optarg;
+                break;
+            case OPT_REPLAY:
+                gOptions.mpReplayPath = optarg;
+                break;
+            case OPT_CHECKPOINT:
+                gOptions.mpCheckpointPath = optarg;
+                break;
+            case OPT_CHECKPOINT_EVERY:
+                gOptions.mCheckpointEvery = atoi(optarg);
+                if (gOptions.mCheckpointEvery <= 0) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_RESTORE:
+                gOptions.mpRestorePath = optarg;
+                break;
+            case OPT_NODES:
+                gOptions.mNodes = atoi(optarg);
+                if (gOptions.mNodes <= 0 || gOptions.mNodes > MAX_NODES) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_SHARD:
+                if (FindShardPolicy(optarg) == -1) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                gOptions.mShard = FindShardPolicy(optarg);
+                break;
+            case OPT_NODE:
+                gOptions.mNode = atoi(optarg);
+                if (gOptions.mNode < 0 || gOptions.mNode >= MAX_NODES) {
+                    PrintUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_HELP:
+                PrintUsage(argv[0]);
+                exit(EXIT_SUCCESS);
+            default:
+                PrintUsage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+}
+
+#endif //SRTN_BUDDY_OPTIONS_H
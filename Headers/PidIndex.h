@@ -0,0 +1,113 @@
+//
+// Maps the pid of a forked child back to the process it is running
+// implemented as an open addressing hash table with linear probing so lookups from the SIGCHLD handler are O(1)
+//
+
+#ifndef SRTN_BUDDY_PIDINDEX_H
+#define SRTN_BUDDY_PIDINDEX_H
+
+#include <stdlib.h>
+#include "ProcessStruct.h"
+
+#define PID_SLOT_EMPTY 0
+#define PID_SLOT_DELETED (-1)
+
+typedef struct PidSlot {
+    pid_t mPid; //PID_SLOT_EMPTY if never used, PID_SLOT_DELETED if the entry was removed
+    Process *mpProcess;
+} PidSlot;
+
+typedef struct PidIndex {
+    PidSlot *mpSlots;
+    int mSize; //number of slots, always a power of 2
+    int mLen; //number of live entries
+    int mUsed; //number of live entries + deleted entries
+} PidIndex;
+
+unsigned int PidHash(pid_t pid) {
+    return (unsigned int) pid * 2654435761u; //knuth multiplicative hash spreads consecutive pids
+}
+
+/*
+** void PidIndexGrow(PidIndex *pIndex, int size)
+** rehash all live entries into a table of the given size, this also drops the deleted entries
+*/
+void PidIndexGrow(PidIndex *pIndex, int size) {
+    PidSlot *pOld = pIndex->mpSlots;
+    int old_size = pIndex->mSize;
+    pIndex->mpSlots = calloc(size, sizeof(PidSlot));
+    while (!pIndex->mpSlots) {
+        perror("PID: *** Calloc failed");
+        pIndex->mpSlots = calloc(size, sizeof(PidSlot));
+    }
+    pIndex->mSize = size;
+    pIndex->mLen = pIndex->mUsed = 0;
+    for (int i = 0; i < old_size; ++i) {
+        if (pOld[i].mPid == PID_SLOT_EMPTY || pOld[i].mPid == PID_SLOT_DELETED)
+            continue;
+        unsigned int j = PidHash(pOld[i].mPid) & (size - 1);
+        while (pIndex->mpSlots[j].mPid != PID_SLOT_EMPTY)
+            j = (j + 1) & (size - 1);
+        pIndex->mpSlots[j] = pOld[i];
+        pIndex->mLen++;
+        pIndex->mUsed++;
+    }
+    free(pOld);
+}
+
+/*
+** void PidIndexInsert(PidIndex *pIndex, pid_t pid, Process *pProcess)
+** map pid to pProcess, the caller must block SIGCHLD since the table may be rehashed
+*/
+void PidIndexInsert(PidIndex *pIndex, pid_t pid, Process *pProcess) {
+    if ((pIndex->mUsed + 1) * 4 >= pIndex->mSize * 3) //keep load factor (including deleted slots) under 3/4
+        PidIndexGrow(pIndex, pIndex->mSize ? (pIndex->mLen * 4 >= pIndex->mSize ? pIndex->mSize * 2 : pIndex->mSize)
+                                           : 16);
+    unsigned int i = PidHash(pid) & (pIndex->mSize - 1);
+    while (pIndex->mpSlots[i].mPid != PID_SLOT_EMPTY && pIndex->mpSlots[i].mPid != PID_SLOT_DELETED)
+        i = (i + 1) & (pIndex->mSize - 1);
+    if (pIndex->mpSlots[i].mPid == PID_SLOT_EMPTY)
+        pIndex->mUsed++;
+    pIndex->mpSlots[i].mPid = pid;
+    pIndex->mpSlots[i].mpProcess = pProcess;
+    pIndex->mLen++;
+}
+
+/*
+** int PidIndexSlot(PidIndex *pIndex, pid_t pid)
+** return the slot holding pid or -1 if pid is not in the table
+*/
+int PidIndexSlot(PidIndex *pIndex, pid_t pid) {
+    if (!pIndex->mSize)
+        return -1;
+    unsigned int i = PidHash(pid) & (pIndex->mSize - 1);
+    while (pIndex->mpSlots[i].mPid != PID_SLOT_EMPTY) {
+        if (pIndex->mpSlots[i].mPid == pid)
+            return (int) i;
+        i = (i + 1) & (pIndex->mSize - 1);
+    }
+    return -1;
+}
+
+Process *PidIndexFind(PidIndex *pIndex, pid_t pid) {
+    int i = PidIndexSlot(pIndex, pid);
+    return i == -1 ? NULL : pIndex->mpSlots[i].mpProcess;
+}
+
+/*
+** Process *p = PidIndexRemove(PidIndex *pIndex, pid_t pid)
+** remove pid from the table and return the process it was mapped to, or NULL if it was not found
+** never allocates, so it is safe to call from a signal handler
+*/
+Process *PidIndexRemove(PidIndex *pIndex, pid_t pid) {
+    int i = PidIndexSlot(pIndex, pid);
+    if (i == -1)
+        return NULL;
+    Process *pProcess = pIndex->mpSlots[i].mpProcess;
+    pIndex->mpSlots[i].mPid = PID_SLOT_DELETED;
+    pIndex->mpSlots[i].mpProcess = NULL;
+    pIndex->mLen--;
+    return pProcess;
+}
+
+#endif //SRTN_BUDDY_PIDINDEX_H
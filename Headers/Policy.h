@@ -0,0 +1,171 @@
+//
+// Scheduling policies the scheduler dispatches by, picked with --policy
+// a policy decides which ready process runs next and whether one that is ready takes the cpu from the running one.
+// Policies that order by a key keep their ready processes in a binary heap, SRTN by the time left and HPF by the
+// priority. Round robin and FCFS run them in the order they became ready, so they keep a FIFO ring instead, where a
+// push and a pop cost the same whatever the length. Aging SRTN gives a process one tick of its remaining time for every
+// --aging ticks it waits: the key is fixed when it is pushed, remain * aging + the time it became ready, so waiting
+// ones move up without the heap ever being reordered.
+//
+
+#ifndef SRTN_BUDDY_POLICY_H
+#define SRTN_BUDDY_POLICY_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "ProcessStruct.h"
+#include "ProcessHeap.h"
+#include "ProcessTable.h"
+
+enum PolicyKind {
+    POLICY_SRTN, //shortest remaining time first, a shorter arrival preempts
+    POLICY_HPF, //highest priority first, 0 is the highest, runs to completion
+    POLICY_RR, //round robin, --quantum ticks each
+    POLICY_FCFS, //first come first served, runs to completion
+    POLICY_AGING, //SRTN where waiting shortens the time left that is compared
+    POLICY_COUNT
+};
+
+typedef struct Policy {
+    const char *mpName;
+    const char *mpDescription;
+    bool mSliced; //the running process gives the cpu up once its quantum is over and another one is ready
+    //order of the ready process with handle id in the heap, lowest first, NULL for a FIFO policy
+    int (*mpKey)(const ProcessTable *pTable, unsigned int id, int aging);
+    //a ready process takes the cpu from the running one now, NULL if only the quantum or the end of a job switches
+    bool (*mpPreempts)(const ProcessTable *pTable, unsigned int ready, unsigned int running, int now, int aging);
+} Policy;
+
+int ReadySince(const ProcessTable *pTable, unsigned int id) { //when the process last became ready
+    const Process *pProcess = &pTable->mpProcesses[id];
+    return (int) (TABLE_STATE(pTable, id) == STOPPED ? pProcess->mLastStop : pProcess->mArrivalTime);
+}
+
+int SrtnKey(const ProcessTable *pTable, unsigned int id, int aging) {
+    return (int) TABLE_REMAIN(pTable, id);
+}
+
+bool SrtnPreempts(const ProcessTable *pTable, unsigned int ready, unsigned int running, int now, int aging) {
+    return TABLE_REMAIN(pTable, ready) < TABLE_REMAIN(pTable, running);
+}
+
+int HpfKey(const ProcessTable *pTable, unsigned int id, int aging) {
+    return (int) pTable->mpProcesses[id].mPriority;
+}
+
+int AgingKey(const ProcessTable *pTable, unsigned int id, int aging) {
+    return (int) TABLE_REMAIN(pTable, id) * aging + ReadySince(pTable, id);
+}
+
+//the running one does not age
+bool AgingPreempts(const ProcessTable *pTable, unsigned int ready, unsigned int running, int now, int aging) {
+    return AgingKey(pTable, ready, aging) - now < (int) TABLE_REMAIN(pTable, running) * aging;
+}
+
+const Policy gPolicies[POLICY_COUNT] = {
+        {"srtn",  "shortest remaining time first, a shorter arrival preempts", false, SrtnKey, SrtnPreempts},
+        {"hpf",   "highest priority first, 0 is the highest, no preemption",  false, HpfKey,  NULL},
+        {"rr",    "round robin, every process runs --quantum ticks in turn",   true,  NULL,    NULL},
+        {"fcfs",  "first come first served, no preemption",                    false, NULL,    NULL},
+        {"aging", "shortest remaining time first, every --aging ticks waited count as one tick less", false,
+                AgingKey, AgingPreempts},
+};
+
+int FindPolicy(const char *pName) { //-1 if there is no policy with this name
+    for (int i = 0; i < POLICY_COUNT; ++i)
+        if (!strcmp(gPolicies[i].mpName, pName))
+            return i;
+    return -1;
+}
+
+void PrintPolicies() {
+    for (int i = 0; i < POLICY_COUNT; ++i)
+        printf("  %-8s %s\n", gPolicies[i].mpName, gPolicies[i].mpDescription);
+}
+
+typedef struct ReadyQueue {
+    const Policy *mpPolicy;
+    const ProcessTable *mpTable; //where the keys of the policy read the processes
+    int mAging;
+    heap_t mHeap; //keyed policies
+    Process **mpRing; //FIFO policies, mCount processes from mHead on, wrapping at mSize
+    int mHead;
+    int mCount;
+    int mSize;
+} ReadyQueue;
+
+void ReadyInit(ReadyQueue *pQueue, const Policy *pPolicy, int aging, const ProcessTable *pTable) {
+    *pQueue = (ReadyQueue) {.mpPolicy = pPolicy, .mpTable = pTable, .mAging = aging};
+}
+
+int ReadyLength(const ReadyQueue *pQueue) {
+    return pQueue->mpPolicy->mpKey ? pQueue->mHeap.len : pQueue->mCount;
+}
+
+void ReadyPush(ReadyQueue *pQueue, Process *pProcess) {
+    if (pQueue->mpPolicy->mpKey) {
+        HeapPush(&pQueue->mHeap, pQueue->mpPolicy->mpKey(pQueue->mpTable, pProcess->mId, pQueue->mAging), pProcess);
+        return;
+    }
+    if (pQueue->mCount == pQueue->mSize) { //unwrap into a ring twice the size
+        int size = pQueue->mSize ? pQueue->mSize * 2 : 16;
+        Process **pRing = malloc(size * sizeof(Process *));
+        while (!pRing) {
+            perror("READY: *** Malloc failed");
+            pRing = malloc(size * sizeof(Process *));
+        }
+        for (int i = 0; i < pQueue->mCount; ++i)
+            pRing[i] = pQueue->mpRing[(pQueue->mHead + i) % pQueue->mSize];
+        free(pQueue->mpRing);
+        pQueue->mpRing = pRing;
+        pQueue->mHead = 0;
+        pQueue->mSize = size;
+    }
+    pQueue->mpRing[(pQueue->mHead + pQueue->mCount++) % pQueue->mSize] = pProcess;
+}
+
+Process *ReadyPeek(ReadyQueue *pQueue) { //NULL if nothing is ready
+    if (pQueue->mpPolicy->mpKey)
+        return HeapPeek(&pQueue->mHeap);
+    return pQueue->mCount ? pQueue->mpRing[pQueue->mHead] : NULL;
+}
+
+Process *ReadyPop(ReadyQueue *pQueue) { //NULL if nothing is ready
+    if (pQueue->mpPolicy->mpKey)
+        return HeapPop(&pQueue->mHeap);
+    if (!pQueue->mCount)
+        return NULL;
+    Process *pProcess = pQueue->mpRing[pQueue->mHead];
+    pQueue->mHead = (pQueue->mHead + 1) % pQueue->mSize;
+    pQueue->mCount--;
+    return pProcess;
+}
+
+/*
+** Process *pProcess = ReadyAt(const ReadyQueue *pQueue, int i)
+** i-th ready process, 0 to ReadyLength - 1, in heap array order or from the front of the FIFO. pushing them again in
+** this order rebuilds the same queue
+*/
+Process *ReadyAt(const ReadyQueue *pQueue, int i) {
+    if (pQueue->mpPolicy->mpKey)
+        return pQueue->mHeap.nodes[i + 1].data;
+    return pQueue->mpRing[(pQueue->mHead + i) % pQueue->mSize];
+}
+
+/*
+** long order = ReadyOrder(const ReadyQueue *pQueue, const Process *pProcess, int position)
+** where pProcess comes in the dispatch order, a larger order runs later: its key in a heap, the position it has or
+** will get in a FIFO, -1 for the one being dispatched
+*/
+long ReadyOrder(const ReadyQueue *pQueue, const Process *pProcess, int position) {
+    if (pQueue->mpPolicy->mpKey)
+        return pQueue->mpPolicy->mpKey(pQueue->mpTable, pProcess->mId, pQueue->mAging);
+    return position;
+}
+
+void ReadyDestroy(ReadyQueue *pQueue) {
+    free(pQueue->mHeap.nodes);
+    free(pQueue->mpRing);
+}
+
+#endif //SRTN_BUDDY_POLICY_H
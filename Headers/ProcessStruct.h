@@ -7,18 +7,27 @@
 
 #include "headers.h"
 
+enum ProcessState {
+    READY, RUNNING, STOPPED, FINISHED
+};
+
+//the time left, the state and the memory address of a process the scheduler runs live in its ProcessTable
 typedef struct Processes {
     unsigned int mId;
     unsigned int mArrivalTime;
     unsigned int mPriority; //here we assume that a negative priority is not allowed
     unsigned int mRuntime;
-    unsigned int mRemainTime;
     unsigned int mWaitTime;
     unsigned int mLastStop; //stores the last time at which this process stopped
     unsigned int mMemSize; //memory size that the process requests
     unsigned int mMemAlloc; //actual memory size that is allocated
-    int mMemAddr; //address of the allocated memory
+    int mMemPool; //pool holding that memory when the scheduler runs several
     pid_t mPid; //stores the pid of the process after the scheduler executes it
+    unsigned int mResizeAt; //ticks of running after which the memory size changes, 0 if it never does
+    unsigned int mResizeSize; //memory size the process needs from then on
+    unsigned int mDispatchUs; //microseconds the scheduler took to allocate and start it
+    bool mSwapped; //its memory is in the backing store, it gets a block again before it resumes
+    unsigned int mSwapOuts; //times its memory was swapped out
 
 } Process;
 
@@ -27,7 +36,6 @@ void PrintProcess(Process *pProcess) {  //for debugging purposes
     printf("Arrival = %d, ", pProcess->mArrivalTime);
     printf("Runtime = %d, ", pProcess->mRuntime);
     printf("Priority = %d, ", pProcess->mPriority);
-    printf("Remaining time = %d, ", pProcess->mRemainTime);
     printf("Waiting time = %d, ", pProcess->mWaitTime);
     printf("Memory size = %d\n", pProcess->mMemSize);
 }
@@ -0,0 +1,106 @@
+//
+// Table of every process of the run, allocated once
+// process_generator announces the largest id before the first arrival, so the scheduler keeps all processes in one
+// table indexed by id instead of one malloc per arrival. The table is a struct of arrays: the fields every scheduling
+// step reads, the time left, the state and the memory address, sit in parallel arrays reached through the id of the
+// process, so scans and statistics over them touch a few contiguous cache lines. The Process records keep the rest.
+// Records stay in place until the run ends, so pointers into the table held by the heap, the pid index and the events
+// stay valid, and their id is the handle of the hot fields.
+//
+
+#ifndef SRTN_BUDDY_PROCESSTABLE_H
+#define SRTN_BUDDY_PROCESSTABLE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "ProcessStruct.h"
+#include "MessageBuffer.h"
+
+typedef struct ProcessTable {
+    Process *mpProcesses; //slot i holds the record of the process with id i
+    unsigned int *mpRemain; //time left of process i when it last stopped, 0 once it finished
+    unsigned char *mpState; //enum ProcessState of process i
+    int *mpMemAddr; //address of the memory of process i, -1 while it is swapped out
+    unsigned char *mpArrived; //1 once the process with that id arrived
+    unsigned int mSize; //largest id + 1
+    unsigned int mCount; //processes arrived so far
+} ProcessTable;
+
+//hot fields of the process with handle id, usable as lvalues
+#define TABLE_REMAIN(pTable, id) ((pTable)->mpRemain[id])
+#define TABLE_STATE(pTable, id) ((pTable)->mpState[id])
+#define TABLE_MEM_ADDR(pTable, id) ((pTable)->mpMemAddr[id])
+
+void ProcessTableDestroy(ProcessTable *pTable) {
+    free(pTable->mpProcesses);
+    free(pTable->mpRemain);
+    free(pTable->mpState);
+    free(pTable->mpMemAddr);
+    free(pTable->mpArrived);
+    *pTable = (ProcessTable) {NULL};
+}
+
+/*
+** int error = ProcessTableInit(ProcessTable *pTable, unsigned int max_id)
+** room for ids 0 to max_id, -1 if memory is exhausted
+*/
+int ProcessTableInit(ProcessTable *pTable, unsigned int max_id) {
+    pTable->mSize = max_id + 1;
+    pTable->mCount = 0;
+    pTable->mpProcesses = calloc(pTable->mSize, sizeof(Process));
+    pTable->mpRemain = calloc(pTable->mSize, sizeof(unsigned int));
+    pTable->mpState = calloc(pTable->mSize, sizeof(unsigned char));
+    pTable->mpMemAddr = calloc(pTable->mSize, sizeof(int));
+    pTable->mpArrived = calloc(pTable->mSize, 1);
+    if (!pTable->mpProcesses || !pTable->mpRemain || !pTable->mpState || !pTable->mpMemAddr || !pTable->mpArrived) {
+        ProcessTableDestroy(pTable);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+** Process *pProcess = ProcessTableAdd(ProcessTable *pTable, const ArrivalRecord *pRecord)
+** fill the slot of an arriving process from its record, NULL if the id is out of range or already arrived
+*/
+Process *ProcessTableAdd(ProcessTable *pTable, const ArrivalRecord *pRecord) {
+    if (pRecord->mId >= pTable->mSize || pTable->mpArrived[pRecord->mId])
+        return NULL;
+    Process *pProcess = &pTable->mpProcesses[pRecord->mId];
+    memset(pProcess, 0, sizeof(Process));
+    pProcess->mId = pRecord->mId;
+    pProcess->mArrivalTime = pRecord->mArrivalTime;
+    pProcess->mRuntime = pRecord->mRuntime;
+    pProcess->mPriority = pRecord->mPriority;
+    pProcess->mMemSize = pRecord->mMemSize;
+    pProcess->mResizeAt = pRecord->mResizeAt;
+    pProcess->mResizeSize = pRecord->mResizeSize;
+    TABLE_REMAIN(pTable, pRecord->mId) = pRecord->mRuntime;
+    TABLE_STATE(pTable, pRecord->mId) = READY;
+    TABLE_MEM_ADDR(pTable, pRecord->mId) = 0;
+    pTable->mpArrived[pRecord->mId] = 1;
+    pTable->mCount++;
+    return pProcess;
+}
+
+/*
+** unsigned long work = ProcessTableWaitingWork(const ProcessTable *pTable)
+** time left of every process waiting for the cpu, ready or stopped, in one pass over the state and time left arrays.
+** a process that did not arrive yet has no time left
+*/
+unsigned long ProcessTableWaitingWork(const ProcessTable *pTable) {
+    unsigned long work = 0;
+    for (unsigned int i = 0; i < pTable->mSize; ++i)
+        if (pTable->mpState[i] == READY || pTable->mpState[i] == STOPPED)
+            work += pTable->mpRemain[i];
+    return work;
+}
+
+unsigned int ProcessTableUnfinished(const ProcessTable *pTable) { //arrived processes that did not finish
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < pTable->mSize; ++i)
+        count += pTable->mpArrived[i] && pTable->mpState[i] != FINISHED;
+    return count;
+}
+
+#endif //SRTN_BUDDY_PROCESSTABLE_H
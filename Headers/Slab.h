@@ -0,0 +1,160 @@
+//
+// Slab layer on top of the buddy allocator
+// a slab is one SLAB_SIZE buddy block carved into equal chunks of a size class, small requests get the tightest
+// class instead of being rounded up to the next power of 2, larger ones a run of neighbouring chunks of one slab
+//
+
+#ifndef SRTN_BUDDY_SLAB_H
+#define SRTN_BUDDY_SLAB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SLAB_SIZE 256 //size of the buddy block a slab is carved from
+#define SLAB_CLASS_COUNT 5
+
+//each class is SLAB_SIZE / n for some n, so a slab wastes less than one chunk
+//powers of 2 are left out since the buddy allocator already fits them exactly
+const int gSlabClasses[SLAB_CLASS_COUNT] = {18, 25, 36, 51, 85};
+
+typedef struct Slab {
+    int mBase; //address of the buddy block this slab was carved from, -1 if no slab lives here
+    int mClass; //index of the size class in gSlabClasses
+    unsigned int mFreeMask; //bit i is set if chunk i is free
+} Slab;
+
+typedef struct SlabCache {
+    Slab *mpSlabs; //one entry per SLAB_SIZE block of the pool, indexed by address / SLAB_SIZE
+    int mCount;
+    int (*mpBlockAlloc)(int); //backing buddy allocator
+    void (*mpBlockFree)(int, int);
+    int (*mpBlockRound)(int); //size of the buddy block a request of this size gets
+} SlabCache;
+
+void SlabInit(SlabCache *pCache, int pool_size, int (*pBlockAlloc)(int), void (*pBlockFree)(int, int),
+              int (*pBlockRound)(int)) {
+    pCache->mCount = pool_size / SLAB_SIZE;
+    pCache->mpSlabs = malloc(pCache->mCount * sizeof(Slab));
+    while (!pCache->mpSlabs) {
+        perror("SLAB: *** Malloc failed");
+        pCache->mpSlabs = malloc(pCache->mCount * sizeof(Slab));
+    }
+    for (int i = 0; i < pCache->mCount; ++i)
+        pCache->mpSlabs[i].mBase = -1;
+    pCache->mpBlockAlloc = pBlockAlloc;
+    pCache->mpBlockFree = pBlockFree;
+    pCache->mpBlockRound = pBlockRound;
+}
+
+int SlabChunkCount(int class) {
+    return SLAB_SIZE / gSlabClasses[class];
+}
+
+/*
+** int class = SlabClass(const SlabCache *pCache, int size, int *pChunks)
+** index of the size class that fits size most tightly in *pChunks neighbouring chunks, or -1 if the buddy allocator
+** fits it at least as tightly. a request up to the largest class takes one chunk, a larger one a run, so a 129 byte
+** request takes 4 chunks of 36 bytes instead of a 256 byte block. pChunks may be NULL
+*/
+int SlabClass(const SlabCache *pCache, int size, int *pChunks) {
+    int best = -1, best_alloc = pCache->mpBlockRound(size), best_chunks = 1;
+    for (int i = SLAB_CLASS_COUNT - 1; i >= 0; --i) { //from the largest class, so a tie takes the shortest run
+        int chunks = (size + gSlabClasses[i] - 1) / gSlabClasses[i];
+        if (chunks > 1 && size <= gSlabClasses[SLAB_CLASS_COUNT - 1]) //a class of its own fits it
+            continue;
+        if (chunks <= SlabChunkCount(i) && chunks * gSlabClasses[i] < best_alloc) {
+            best = i;
+            best_alloc = chunks * gSlabClasses[i];
+            best_chunks = chunks;
+        }
+    }
+    if (pChunks)
+        *pChunks = best_chunks;
+    return best;
+}
+
+/*
+** int alloc = SlabRound(const SlabCache *pCache, int size)
+** the number of bytes a request of this size really takes, a run of chunks or a buddy block
+*/
+int SlabRound(const SlabCache *pCache, int size) {
+    int chunks;
+    int class = SlabClass(pCache, size, &chunks);
+    return class == -1 ? pCache->mpBlockRound(size) : chunks * gSlabClasses[class];
+}
+
+int SlabFindRun(const Slab *pSlab, int chunks) { //first of chunks free neighbouring chunks, -1 if there is no such run
+    unsigned int run = (1u << chunks) - 1;
+    for (int i = 0; i + chunks <= SlabChunkCount(pSlab->mClass); ++i)
+        if ((pSlab->mFreeMask >> i & run) == run)
+            return i;
+    return -1;
+}
+
+/*
+** int addr = SlabAlloc(SlabCache *pCache, int size)
+** take a chunk from a partial slab of the right class, carving a new slab if none has room
+** sizes without a class go straight to the buddy allocator, returns -1 if no memory is available
+*/
+int SlabAlloc(SlabCache *pCache, int size) {
+    int chunks;
+    int class = SlabClass(pCache, size, &chunks);
+    if (class == -1)
+        return pCache->mpBlockAlloc(pCache->mpBlockRound(size));
+
+    Slab *pSlab = NULL;
+    int chunk = -1;
+    for (int i = 0; i < pCache->mCount && chunk == -1; ++i) { //look for a partial slab of this class with room
+        if (pCache->mpSlabs[i].mBase != -1 && pCache->mpSlabs[i].mClass == class) {
+            pSlab = &pCache->mpSlabs[i];
+            chunk = SlabFindRun(pSlab, chunks);
+        }
+    }
+    if (chunk == -1) { //no slab of this class has room, carve a new one
+        int base = pCache->mpBlockAlloc(SLAB_SIZE);
+        if (base == -1)
+            return -1;
+        pSlab = &pCache->mpSlabs[base / SLAB_SIZE];
+        pSlab->mBase = base;
+        pSlab->mClass = class;
+        pSlab->mFreeMask = (1u << SlabChunkCount(class)) - 1;
+        chunk = 0;
+    }
+    pSlab->mFreeMask &= ~(((1u << chunks) - 1) << chunk);
+    return pSlab->mBase + chunk * gSlabClasses[class];
+}
+
+/*
+** void SlabFree(SlabCache *pCache, int addr, int size)
+** return the chunks of a request of size bytes to their slab, the slab goes back to the buddy allocator once all its
+** chunks are free
+*/
+void SlabFree(SlabCache *pCache, int addr, int size) {
+    Slab *pSlab = &pCache->mpSlabs[addr / SLAB_SIZE];
+    if (pSlab->mBase == -1) { //not carved into a slab so it is a plain buddy block
+        pCache->mpBlockFree(addr, size);
+        return;
+    }
+    int chunk = (addr - pSlab->mBase) / gSlabClasses[pSlab->mClass];
+    int chunks = size / gSlabClasses[pSlab->mClass]; //size is the run the request was given
+    pSlab->mFreeMask |= ((1u << chunks) - 1) << chunk;
+    if (pSlab->mFreeMask == (1u << SlabChunkCount(pSlab->mClass)) - 1) {
+        pCache->mpBlockFree(pSlab->mBase, SLAB_SIZE);
+        pSlab->mBase = -1;
+    }
+}
+
+int SlabSave(const SlabCache *pCache, FILE *pFile) { //the slabs only, their blocks belong to the buddy allocator
+    size_t count = (size_t) pCache->mCount;
+    return fwrite(&pCache->mCount, sizeof(int), 1, pFile) == 1 &&
+           fwrite(pCache->mpSlabs, sizeof(Slab), count, pFile) == count ? 0 : -1;
+}
+
+int SlabLoad(SlabCache *pCache, FILE *pFile) { //-1 if the slabs were saved for a pool of another size
+    int count;
+    if (fread(&count, sizeof(int), 1, pFile) != 1 || count != pCache->mCount)
+        return -1;
+    return fread(pCache->mpSlabs, sizeof(Slab), (size_t) count, pFile) == (size_t) count ? 0 : -1;
+}
+
+#endif //SRTN_BUDDY_SLAB_H
@@ -0,0 +1,255 @@
+//
+// Buddy allocators whose blocks do not split in halves
+// a split rule maps a block size to the sizes of its left and right parts, the weighted rule splits 2^k into 3 * 2^(k-2)
+// and 2^(k-2) and 3 * 2^k into 2^(k+1) and 2^k, the Fibonacci rule splits F(n) into F(n-1) and F(n-2). Both give size
+// classes closer together than powers of 2, so less of a request is lost to rounding.
+// The split rule fixes every block a root can ever be cut into, so the blocks are built once as an explicit tree and
+// handled like Headers/BuddyTree.h: every node keeps the largest free block below it, allocation walks down from a root
+// and freeing walks back up merging parts with their buddy. Sizes are counted in units of mMinBlock.
+//
+
+#ifndef SRTN_BUDDY_SPLITBUDDY_H
+#define SRTN_BUDDY_SPLITBUDDY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum SplitRule {
+    SPLIT_WEIGHTED, //2^k and 3 * 2^k
+    SPLIT_FIBONACCI, //1, 2, 3, 5, 8, 13, ...
+};
+
+typedef struct SplitBuddy {
+    int mPoolSize;
+    int mMinBlock;
+    int mFreeMem;
+    enum SplitRule mRule;
+    int mNodes;
+    int mRoots;
+    int *mpSize; //per node, in units
+    int *mpOffset; //per node, in units
+    int *mpLongest; //per node, largest free block below it in units, mpSize if the node is a free block
+    int *mpLeft; //per node, -1 for blocks of one unit
+    int *mpRight;
+    int *mpParent; //-1 for roots
+    int *mpRootNodes; //node of every root
+    int *mpAllocNode; //per unit, node of the allocated block starting there, -1 if none
+    int mClasses;
+    int *mpClasses; //every block size in units, ascending
+} SplitBuddy;
+
+/*
+** int split = SplitBuddyRule(enum SplitRule rule, int size, int *pRight)
+** size in units of the left part of a block, its right part in *pRight, 0 if the block cannot split
+*/
+int SplitBuddyRule(enum SplitRule rule, int size, int *pRight) {
+    int left;
+    if (size < 2)
+        return 0;
+    if (size == 2)
+        left = 1;
+    else if (rule == SPLIT_WEIGHTED)
+        left = (size & (size - 1)) ? size / 3 * 2 : size / 4 * 3; //3 * 2^k or 2^k
+    else {
+        int previous = 1, current = 2;
+        while (current < size) { //F(n-1) of size = F(n)
+            int next = previous + current;
+            previous = current;
+            current = next;
+        }
+        left = previous;
+    }
+    *pRight = size - left;
+    return left;
+}
+
+int SplitBuddyIsClass(enum SplitRule rule, int size) { //1 if size in units is a block size of the rule
+    if (rule == SPLIT_WEIGHTED)
+        return !(size & (size - 1)) || (size % 3 == 0 && !((size / 3) & (size / 3 - 1)));
+    int previous = 1, current = 1;
+    while (current < size) {
+        int next = previous + current;
+        previous = current;
+        current = next;
+    }
+    return current == size;
+}
+
+int SplitBuddyBuild(SplitBuddy *pBuddy, int size, int offset, int parent) { //index of the new node
+    int node = pBuddy->mNodes++;
+    int right_size, left_size = SplitBuddyRule(pBuddy->mRule, size, &right_size);
+    pBuddy->mpSize[node] = pBuddy->mpLongest[node] = size;
+    pBuddy->mpOffset[node] = offset;
+    pBuddy->mpParent[node] = parent;
+    pBuddy->mpLeft[node] = pBuddy->mpRight[node] = -1;
+    if (left_size) {
+        pBuddy->mpLeft[node] = SplitBuddyBuild(pBuddy, left_size, offset, node);
+        pBuddy->mpRight[node] = SplitBuddyBuild(pBuddy, right_size, offset + left_size, node);
+    }
+    return node;
+}
+
+/*
+** SplitBuddy *pBuddy = SplitBuddyCreate(int pool_size, int min_block, int max_block, enum SplitRule rule)
+** the pool is cut into roots of the largest block size up to max_block that still fits, NULL if memory is exhausted
+*/
+SplitBuddy *SplitBuddyCreate(int pool_size, int min_block, int max_block, enum SplitRule rule) {
+    if (min_block <= 0 || pool_size < min_block || max_block < min_block)
+        return NULL;
+    int units = pool_size / min_block;
+    SplitBuddy *pBuddy = calloc(1, sizeof(SplitBuddy));
+    if (!pBuddy)
+        return NULL;
+    pBuddy->mPoolSize = units * min_block;
+    pBuddy->mMinBlock = min_block;
+    pBuddy->mFreeMem = pBuddy->mPoolSize;
+    pBuddy->mRule = rule;
+    int **ppArrays[] = {&pBuddy->mpSize, &pBuddy->mpOffset, &pBuddy->mpLongest, &pBuddy->mpLeft, &pBuddy->mpRight,
+                        &pBuddy->mpParent, &pBuddy->mpRootNodes, &pBuddy->mpAllocNode, &pBuddy->mpClasses};
+    for (int i = 0; i < (int) (sizeof(ppArrays) / sizeof(int **)); ++i) //every node is a unit or splits in 2
+        if (!(*ppArrays[i] = malloc(2 * units * sizeof(int)))) {
+            for (int j = 0; j < i; ++j)
+                free(*ppArrays[j]);
+            free(pBuddy);
+            return NULL;
+        }
+    for (int size = 1; size <= max_block / min_block && size <= units; ++size)
+        if (SplitBuddyIsClass(rule, size))
+            pBuddy->mpClasses[pBuddy->mClasses++] = size;
+    for (int offset = 0; offset < units;) {
+        int root = pBuddy->mClasses - 1;
+        while (pBuddy->mpClasses[root] > units - offset)
+            root--;
+        pBuddy->mpRootNodes[pBuddy->mRoots++] = SplitBuddyBuild(pBuddy, pBuddy->mpClasses[root], offset, -1);
+        offset += pBuddy->mpClasses[root];
+    }
+    for (int i = 0; i < units; ++i)
+        pBuddy->mpAllocNode[i] = -1;
+    return pBuddy;
+}
+
+void SplitBuddyDestroy(SplitBuddy *pBuddy) {
+    int *pArrays[] = {pBuddy->mpSize, pBuddy->mpOffset, pBuddy->mpLongest, pBuddy->mpLeft, pBuddy->mpRight,
+                      pBuddy->mpParent, pBuddy->mpRootNodes, pBuddy->mpAllocNode, pBuddy->mpClasses};
+    for (int i = 0; i < (int) (sizeof(pArrays) / sizeof(int *)); ++i)
+        free(pArrays[i]);
+    free(pBuddy);
+}
+
+int SplitBuddyClassOf(const SplitBuddy *pBuddy, int size) { //smallest block size in units holding size bytes, -1 if none
+    int units = (size + pBuddy->mMinBlock - 1) / pBuddy->mMinBlock;
+    int low = 0, high = pBuddy->mClasses;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (pBuddy->mpClasses[middle] < units)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low < pBuddy->mClasses ? pBuddy->mpClasses[low] : -1;
+}
+
+/*
+** int bytes = SplitBuddyRound(const SplitBuddy *pBuddy, int size)
+** bytes a request of size bytes really takes, -1 if it is larger than any block
+*/
+int SplitBuddyRound(const SplitBuddy *pBuddy, int size) {
+    int units = SplitBuddyClassOf(pBuddy, size > 0 ? size : 1);
+    return units == -1 ? -1 : units * pBuddy->mMinBlock;
+}
+
+void SplitBuddyUpdate(SplitBuddy *pBuddy, int node) { //recompute a node from its parts, two whole free parts merge
+    int left = pBuddy->mpLeft[node], right = pBuddy->mpRight[node];
+    int left_free = pBuddy->mpLongest[left], right_free = pBuddy->mpLongest[right];
+    if (left_free == pBuddy->mpSize[left] && right_free == pBuddy->mpSize[right])
+        pBuddy->mpLongest[node] = pBuddy->mpSize[node];
+    else
+        pBuddy->mpLongest[node] = left_free > right_free ? left_free : right_free;
+}
+
+/*
+** int addr = SplitBuddyAlloc(SplitBuddy *pBuddy, int size)
+** address of a free block of the smallest size class holding size bytes, -1 if none is free
+** every smaller size class can be cut out of a free block, so the walk follows the parts with a large enough free block
+** and takes the tighter one when both fit
+*/
+int SplitBuddyAlloc(SplitBuddy *pBuddy, int size) {
+    int units = size > 0 ? SplitBuddyClassOf(pBuddy, size) : -1;
+    if (units == -1)
+        return -1;
+    int node = -1;
+    for (int i = 0; i < pBuddy->mRoots; ++i) {
+        int root = pBuddy->mpRootNodes[i];
+        if (pBuddy->mpLongest[root] >= units && (node == -1 || pBuddy->mpLongest[root] < pBuddy->mpLongest[node]))
+            node = root;
+    }
+    if (node == -1)
+        return -1;
+    while (pBuddy->mpSize[node] != units) {
+        int left = pBuddy->mpLeft[node], right = pBuddy->mpRight[node];
+        int left_free = pBuddy->mpLongest[left], right_free = pBuddy->mpLongest[right];
+        if (left_free >= units && right_free >= units)
+            node = right_free < left_free ? right : left;
+        else
+            node = left_free >= units ? left : right;
+    }
+    pBuddy->mpLongest[node] = 0;
+    pBuddy->mpAllocNode[pBuddy->mpOffset[node]] = node;
+    pBuddy->mFreeMem -= units * pBuddy->mMinBlock;
+    int addr = pBuddy->mpOffset[node] * pBuddy->mMinBlock;
+    while ((node = pBuddy->mpParent[node]) != -1)
+        SplitBuddyUpdate(pBuddy, node);
+    return addr;
+}
+
+void SplitBuddyFree(SplitBuddy *pBuddy, int addr) {
+    int node = -1;
+    if (addr >= 0 && addr < pBuddy->mPoolSize && addr % pBuddy->mMinBlock == 0)
+        node = pBuddy->mpAllocNode[addr / pBuddy->mMinBlock];
+    if (node == -1) {
+        fprintf(stderr, "SPLIT: *** Invalid free of address %d\n", addr);
+        return;
+    }
+    pBuddy->mpAllocNode[addr / pBuddy->mMinBlock] = -1;
+    pBuddy->mpLongest[node] = pBuddy->mpSize[node];
+    pBuddy->mFreeMem += pBuddy->mpSize[node] * pBuddy->mMinBlock;
+    while ((node = pBuddy->mpParent[node]) != -1)
+        SplitBuddyUpdate(pBuddy, node);
+}
+
+int SplitBuddyFreeBytes(const SplitBuddy *pBuddy) {
+    return pBuddy->mFreeMem;
+}
+
+int SplitBuddyLargestFree(const SplitBuddy *pBuddy) {
+    int longest = 0;
+    for (int i = 0; i < pBuddy->mRoots; ++i)
+        if (pBuddy->mpLongest[pBuddy->mpRootNodes[i]] > longest)
+            longest = pBuddy->mpLongest[pBuddy->mpRootNodes[i]];
+    return longest * pBuddy->mMinBlock;
+}
+
+int SplitBuddySave(const SplitBuddy *pBuddy, FILE *pFile) { //only what allocations change, the tree shape is fixed
+    int header[] = {pBuddy->mPoolSize, pBuddy->mMinBlock, pBuddy->mNodes, pBuddy->mFreeMem};
+    size_t nodes = (size_t) pBuddy->mNodes, units = (size_t) (pBuddy->mPoolSize / pBuddy->mMinBlock);
+    return fwrite(header, sizeof(header), 1, pFile) == 1 &&
+           fwrite(pBuddy->mpLongest, sizeof(int), nodes, pFile) == nodes &&
+           fwrite(pBuddy->mpAllocNode, sizeof(int), units, pFile) == units ? 0 : -1;
+}
+
+/*
+** int error = SplitBuddyLoad(SplitBuddy *pBuddy, FILE *pFile)
+** replace the state with one SplitBuddySave wrote, -1 if it was saved from an allocator of another shape
+*/
+int SplitBuddyLoad(SplitBuddy *pBuddy, FILE *pFile) {
+    int header[4];
+    size_t nodes = (size_t) pBuddy->mNodes, units = (size_t) (pBuddy->mPoolSize / pBuddy->mMinBlock);
+    if (fread(header, sizeof(header), 1, pFile) != 1 || header[0] != pBuddy->mPoolSize ||
+        header[1] != pBuddy->mMinBlock || header[2] != pBuddy->mNodes)
+        return -1;
+    pBuddy->mFreeMem = header[3];
+    return fread(pBuddy->mpLongest, sizeof(int), nodes, pFile) == nodes &&
+           fread(pBuddy->mpAllocNode, sizeof(int), units, pFile) == units ? 0 : -1;
+}
+
+#endif //SRTN_BUDDY_SPLITBUDDY_H
@@ -0,0 +1,225 @@
+//
+// Record and replay of everything a scheduler run does not decide by itself
+// a recorded run writes a text trace of its inputs in the order the scheduler saw them: the process table, the
+// value of every clock read, the arrivals drained by one wake up, the children reaped together, the
+// pid every job got, the resizes fired by the alarm, and the outcome of every allocation. Handlers only run while the
+// scheduler waits, so feeding the same inputs at the same waits reproduces the run: a replay reads the clock and the
+// events from the trace instead of the clock process, the message queue and the children, at full speed and with no
+// other process involved. Allocations are not fed back, they are computed again and checked against the trace, every
+// mismatch or line the replay did not expect counts as a divergence.
+//
+
+#ifndef SRTN_BUDDY_TRACE_H
+#define SRTN_BUDDY_TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers.h"
+#include "MessageBuffer.h"
+#include "Options.h"
+
+#define TRACE_LINE_SIZE 256
+
+enum TraceMode {
+    TRACE_OFF,
+    TRACE_RECORD,
+    TRACE_REPLAY,
+};
+
+typedef struct Trace {
+    enum TraceMode mMode;
+    FILE *mpFile;
+    int mClock; //last clock value read
+    char mLine[TRACE_LINE_SIZE]; //replay: next line not consumed yet, empty at the end of the file
+    unsigned long mDivergences;
+    ArrivalRecord *mpPending; //record: arrivals drained by the current wake up, written together
+    int mPendingCount;
+    int mPendingSize;
+} Trace;
+
+Trace gTrace = {.mMode = TRACE_OFF};
+
+void TraceAdvance() { //replay: read the next line
+    if (!fgets(gTrace.mLine, TRACE_LINE_SIZE, gTrace.mpFile))
+        gTrace.mLine[0] = '\0';
+}
+
+int TraceIs(const char *pKind) { //replay: the next line is a pKind line
+    size_t len = strlen(pKind);
+    return !strncmp(gTrace.mLine, pKind, len) && (gTrace.mLine[len] == ' ' || gTrace.mLine[len] == '\n');
+}
+
+/*
+** int error = TraceOpen(enum TraceMode mode, const char *pPath)
+** start recording to or replaying from pPath, -1 if it cannot be opened or is not a trace
+** the options a recording ran with are written to it, a replay takes them over
+*/
+int TraceOpen(enum TraceMode mode, const char *pPath) {
+    gTrace.mpFile = fopen(pPath, mode == TRACE_RECORD ? "w" : "r");
+    if (!gTrace.mpFile)
+        return -1;
+    gTrace.mMode = mode;
+    if (mode == TRACE_RECORD) {
+        fprintf(gTrace.mpFile, "srtn-trace 3\n");
+        fprintf(gTrace.mpFile, "options %d %d %g %g %s %d %d %s %d %d", gOptions.mSlab, gOptions.mLazyBuddy,
+                gOptions.mCompactCost, gOptions.mSwapCost, gPolicies[gOptions.mPolicy].mpName, gOptions.mQuantum,
+                gOptions.mAging, gOptions.mpMemVariant, gOptions.mPlacement, gOptions.mPoolCount);
+        for (int i = 0; i < gOptions.mPoolCount; ++i)
+            fprintf(gTrace.mpFile, " %d", gOptions.mPoolSizes[i]);
+        fprintf(gTrace.mpFile, "\n");
+        return 0;
+    }
+    static char variant[64]; //gOptions keeps pointing at it
+    char policy[16];
+    int slab, placement, read = 0;
+    TraceAdvance();
+    if (!TraceIs("srtn-trace") || atoi(gTrace.mLine + 11) != 3) //version 2 had no policy, 1 no swap cost either
+        return -1;
+    TraceAdvance();
+    if (sscanf(gTrace.mLine, "options %d %d %lf %lf %15s %d %d %63s %d %d%n", &slab, &gOptions.mLazyBuddy,
+               &gOptions.mCompactCost, &gOptions.mSwapCost, policy, &gOptions.mQuantum, &gOptions.mAging, variant,
+               &placement, &gOptions.mPoolCount, &read) != 10 ||
+        gOptions.mPoolCount > MAX_POOLS || !FindMemEngine(variant) || FindPolicy(policy) == -1)
+        return -1;
+    for (int i = 0, used; i < gOptions.mPoolCount; ++i, read += used)
+        if (sscanf(gTrace.mLine + read, " %d%n", &gOptions.mPoolSizes[i], &used) != 1)
+            return -1;
+    gOptions.mSlab = slab;
+    gOptions.mpMemVariant = variant;
+    gOptions.mPlacement = placement;
+    gOptions.mPolicy = FindPolicy(policy);
+    TraceAdvance();
+    return 0;
+}
+
+void TraceClose() {
+    if (gTrace.mMode == TRACE_OFF)
+        return;
+    if (gTrace.mMode == TRACE_RECORD)
+        fprintf(gTrace.mpFile, "end\n");
+    fclose(gTrace.mpFile);
+    free(gTrace.mpPending);
+    gTrace.mMode = TRACE_OFF;
+}
+
+/*
+** int clk = TraceClock()
+** getClk() for the scheduler: every read is recorded, so a replayed read gets the value the same read saw, not a
+** later one that had moved on
+*/
+int TraceClock() {
+    if (gTrace.mMode == TRACE_REPLAY) {
+        if (TraceIs("clock")) {
+            gTrace.mClock = atoi(gTrace.mLine + 6);
+            TraceAdvance();
+        } else {
+            gTrace.mDivergences++; //the recorded run did not read the clock here, keep the last value
+        }
+        return gTrace.mClock;
+    }
+    gTrace.mClock = getClk();
+    if (gTrace.mMode == TRACE_RECORD)
+        fprintf(gTrace.mpFile, "clock %d\n", gTrace.mClock);
+    return gTrace.mClock;
+}
+
+void TraceWaitClk(int last_clk) { //a replay does not wait, the next read takes the recorded value
+    if (gTrace.mMode != TRACE_REPLAY)
+        waitClk(last_clk);
+}
+
+void TraceTable(int count, unsigned int max_id) {
+    if (gTrace.mMode == TRACE_RECORD)
+        fprintf(gTrace.mpFile, "table %d %u\n", count, max_id);
+}
+
+void TraceArrival(const ArrivalRecord *pRecord) { //kept until TraceArrivals, a wake up may drain several messages
+    if (gTrace.mMode != TRACE_RECORD)
+        return;
+    if (gTrace.mPendingCount == gTrace.mPendingSize) {
+        int size = gTrace.mPendingSize ? gTrace.mPendingSize * 2 : ARRIVAL_BATCH;
+        ArrivalRecord *pPending = realloc(gTrace.mpPending, size * sizeof(ArrivalRecord));
+        if (!pPending) {
+            perror("TRACE: *** Malloc failed, the trace misses an arrival");
+            return;
+        }
+        gTrace.mpPending = pPending;
+        gTrace.mPendingSize = size;
+    }
+    gTrace.mpPending[gTrace.mPendingCount++] = *pRecord;
+}
+
+void TraceArrivals() {
+    if (gTrace.mMode != TRACE_RECORD)
+        return;
+    fprintf(gTrace.mpFile, "arrive %d\n", gTrace.mPendingCount);
+    for (int i = 0; i < gTrace.mPendingCount; ++i) {
+        const ArrivalRecord *pRecord = &gTrace.mpPending[i];
+        fprintf(gTrace.mpFile, "  %u %u %u %u %u %u %u\n", pRecord->mId, pRecord->mArrivalTime, pRecord->mRuntime,
+                pRecord->mPriority, pRecord->mMemSize, pRecord->mResizeAt, pRecord->mResizeSize);
+    }
+    gTrace.mPendingCount = 0;
+}
+
+int TraceReadArrival(ArrivalRecord *pRecord) { //replay: one record line of an arrive event, -1 if there is none
+    if (sscanf(gTrace.mLine, " %u %u %u %u %u %u %u", &pRecord->mId, &pRecord->mArrivalTime, &pRecord->mRuntime,
+               &pRecord->mPriority, &pRecord->mMemSize, &pRecord->mResizeAt, &pRecord->mResizeSize) != 7)
+        return -1;
+    TraceAdvance();
+    return 0;
+}
+
+void TraceExits(Process **pFinished, int count) { //one line per child reaped in the same pass, same order
+    if (gTrace.mMode != TRACE_RECORD || !count)
+        return;
+    fprintf(gTrace.mpFile, "exit %d\n", count);
+    for (int i = 0; i < count; ++i)
+        fprintf(gTrace.mpFile, "  %u\n", pFinished[i]->mId);
+}
+
+void TracePid(const Process *pProcess) {
+    if (gTrace.mMode == TRACE_RECORD)
+        fprintf(gTrace.mpFile, "pid %u %d\n", pProcess->mId, pProcess->mPid);
+}
+
+/*
+** int pid = TraceReadPid(const Process *pProcess)
+** replay: the pid the recorded run got for pProcess, so the pid index fills up the same way
+*/
+int TraceReadPid(const Process *pProcess) {
+    unsigned int id;
+    int pid;
+    while (gTrace.mLine[0] && !(TraceIs("pid") && sscanf(gTrace.mLine, "pid %u %d", &id, &pid) == 2 &&
+                                id == pProcess->mId)) {
+        gTrace.mDivergences++; //the recorded run did something else here
+        TraceAdvance();
+    }
+    if (!gTrace.mLine[0])
+        return (int) pProcess->mId + 1; //past the end, any unique positive pid will do
+    TraceAdvance();
+    return pid;
+}
+
+void TraceResize(const Process *pProcess) {
+    if (gTrace.mMode == TRACE_RECORD)
+        fprintf(gTrace.mpFile, "resize %u\n", pProcess->mId);
+}
+
+void TraceAlloc(const Process *pProcess, int addr) { //recorded, or checked against the recording
+    if (gTrace.mMode == TRACE_RECORD) {
+        fprintf(gTrace.mpFile, "alloc %u %d\n", pProcess->mId, addr);
+    } else if (gTrace.mMode == TRACE_REPLAY) {
+        unsigned int id;
+        int recorded;
+        if (!TraceIs("alloc") || sscanf(gTrace.mLine, "alloc %u %d", &id, &recorded) != 2 || id != pProcess->mId ||
+            recorded != addr) {
+            gTrace.mDivergences++;
+            LOG(LOG_DEBUG, "TRACE: *** Allocation of process %u diverged from the recording\n", pProcess->mId);
+            return; //leave the line to whatever expects it
+        }
+        TraceAdvance();
+    }
+}
+
+#endif //SRTN_BUDDY_TRACE_H
@@ -0,0 +1,141 @@
+//
+// Keeps a pool of pre-spawned process.out workers parked on a pipe so starting a job does not pay for fork + execv
+// a parked worker blocks on its stdin until the scheduler writes a WorkerJob to it, then runs that job and exits
+//
+
+#ifndef SRTN_BUDDY_WORKERPOOL_H
+#define SRTN_BUDDY_WORKERPOOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+
+#define WORKER_POOL_MAX 256 //upper bound for the number of parked workers
+
+extern char **environ;
+
+typedef struct WorkerJob { //record handed to a parked worker through its pipe
+    unsigned int mId;
+    unsigned int mRuntime;
+    unsigned int mClockMode; //count emulated clock ticks instead of spinning on cpu time
+} WorkerJob;
+
+typedef struct Worker {
+    pid_t mPid;
+    int mFd; //write end of the pipe connected to the stdin of the worker
+} Worker;
+
+typedef struct WorkerPool {
+    Worker mWorkers[WORKER_POOL_MAX];
+    int mLen; //number of parked workers
+    int mTarget; //number of parked workers the pool is refilled to
+    const char *mpPath; //worker executable
+} WorkerPool;
+
+/*
+** int WorkerSpawn(WorkerPool *pPool)
+** spawn one parked worker and add it to the pool, return 0 on success and -1 on failure
+** the caller must block SIGCHLD since the pool is also touched by the child handler
+*/
+int WorkerSpawn(WorkerPool *pPool) {
+    if (pPool->mLen == WORKER_POOL_MAX)
+        return -1;
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("POOL: *** Error creating worker pipe");
+        return -1;
+    }
+    //close on exec so other workers never inherit a write end and miss EOF
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO); //dup2 clears close on exec on stdin
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t empty_set;
+    sigemptyset(&empty_set);
+    posix_spawnattr_setsigmask(&attr, &empty_set); //the caller has SIGCHLD blocked, the worker must not inherit it
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    char *argv[] = {(char *) pPool->mpPath, NULL}; //no runtime argument means worker mode
+    pid_t pid;
+    int err = posix_spawn(&pid, pPool->mpPath, &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(fds[0]);
+    if (err) {
+        errno = err;
+        perror("POOL: *** Error spawning worker");
+        close(fds[1]);
+        return -1;
+    }
+
+    pPool->mWorkers[pPool->mLen].mPid = pid;
+    pPool->mWorkers[pPool->mLen].mFd = fds[1];
+    pPool->mLen++;
+    return 0;
+}
+
+void WorkerPoolRefill(WorkerPool *pPool) {
+    while (pPool->mLen < pPool->mTarget)
+        if (WorkerSpawn(pPool) == -1)
+            return;
+}
+
+void WorkerPoolInit(WorkerPool *pPool, const char *pPath, int target) {
+    pPool->mLen = 0;
+    pPool->mTarget = target < WORKER_POOL_MAX ? target : WORKER_POOL_MAX;
+    pPool->mpPath = pPath;
+    WorkerPoolRefill(pPool);
+}
+
+/*
+** pid_t pid = WorkerPoolDispatch(WorkerPool *pPool, const WorkerJob *pJob)
+** hand the job to a parked worker and return its pid, or -1 if no worker could be started
+** an empty pool spawns a worker on the spot and grows its target so the next burst finds enough workers
+*/
+pid_t WorkerPoolDispatch(WorkerPool *pPool, const WorkerJob *pJob) {
+    while (1) {
+        if (!pPool->mLen) {
+            if (pPool->mTarget < WORKER_POOL_MAX)
+                pPool->mTarget = pPool->mTarget ? pPool->mTarget * 2 : 1;
+            if (WorkerSpawn(pPool) == -1)
+                return -1;
+        }
+        Worker worker = pPool->mWorkers[--pPool->mLen];
+        ssize_t written = write(worker.mFd, pJob, sizeof(WorkerJob)); //atomic since it is smaller than PIPE_BUF
+        close(worker.mFd);
+        if (written == sizeof(WorkerJob))
+            return worker.mPid;
+        perror("POOL: *** Error handing job to worker"); //the worker died while parked, try the next one
+    }
+}
+
+/*
+** void WorkerPoolForget(WorkerPool *pPool, pid_t pid)
+** drop a parked worker that exited on its own, called from the child handler
+*/
+void WorkerPoolForget(WorkerPool *pPool, pid_t pid) {
+    for (int i = 0; i < pPool->mLen; ++i) {
+        if (pPool->mWorkers[i].mPid != pid)
+            continue;
+        close(pPool->mWorkers[i].mFd);
+        pPool->mWorkers[i] = pPool->mWorkers[--pPool->mLen];
+        return;
+    }
+}
+
+void WorkerPoolDestroy(WorkerPool *pPool) {
+    pPool->mTarget = 0;
+    while (pPool->mLen) //closing the pipe makes the parked worker read EOF and exit
+        close(pPool->mWorkers[--pPool->mLen].mFd);
+}
+
+#endif //SRTN_BUDDY_WORKERPOOL_H
@@ -14,6 +14,9 @@
 #include <unistd.h>
 #include <signal.h>
 #include <sys/queue.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
 
 typedef short bool;
 #define true 1
@@ -37,16 +40,28 @@ int getClk() {
 }
 
 
+/*
+ * Block until the clock moves past last_clk without burning cpu.
+ * The clock does a futex wake on its shared counter after every tick, so waiters sleep on that same word.
+ * Returns early if a signal interrupts the wait, callers should re-check the clock.
+*/
+void waitClk(int last_clk) {
+    if (*shmaddr == last_clk)
+        syscall(SYS_futex, shmaddr, FUTEX_WAIT, last_clk, NULL, NULL, 0);
+}
+
+
 /*
  * All process call this function at the beginning to establish communication between them and the clock module.
  * Again, remember that the clock is only emulation!
 */
 void initClk() {
     int shmid = shmget(SHKEY, 4, 0444);
-    while ((int) shmid == -1) {
-        //Make sure that the clock exists
+    if ((int) shmid == -1)
         printf("Wait! The clock not initialized yet!\n");
-        sleep(1);
+    while ((int) shmid == -1) {
+        //Make sure that the clock exists, ticks may be much shorter than a second so do not oversleep
+        usleep(10000);
         shmid = shmget(SHKEY, 4, 0444);
     }
     shmaddr = (int *) shmat(shmid, (void *) 0, 0);
@@ -0,0 +1,139 @@
+//
+// Stress benchmark of the buddy allocator library
+// every thread keeps a working set of live blocks and randomly allocates and frees, the run is repeated for 1 to 64
+// threads with and without per-thread caches.
+// the burst runs allocate and free BURST_SIZE blocks at a time, one call each or through BuddyAllocMany/BuddyFreeMany
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Headers/BuddyAllocator.h"
+
+#define POOL_SIZE (16 << 20)
+#define MIN_BLOCK 16
+#define MAX_BLOCK (64 << 10)
+#define LIVE_BLOCKS 256 //working set of every thread
+#define OPS_PER_THREAD 2000000
+#define BURST_SIZE 32
+
+typedef struct BenchThread {
+    pthread_t mThread;
+    BuddyAllocator *mpBuddy;
+    int mBatched; //burst runs only, use the batch calls
+    unsigned int mSeed;
+    long mFailures;
+} BenchThread;
+
+pthread_barrier_t gStartBarrier;
+
+unsigned int XorShift(unsigned int *pState) {
+    unsigned int x = *pState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *pState = x;
+}
+
+int RandomSize(unsigned int *pState) {
+    unsigned int r = XorShift(pState);
+    if (r % 16) //mostly small requests that hit the cached orders
+        return 1 + (int) (r >> 8) % 128;
+    return 1 + (int) (r >> 8) % 4096;
+}
+
+void *BenchWorker(void *pArg) {
+    BenchThread *pThread = pArg;
+    int live[LIVE_BLOCKS];
+    int count = 0;
+    pthread_barrier_wait(&gStartBarrier);
+    for (int op = 0; op < OPS_PER_THREAD; ++op) {
+        unsigned int r = XorShift(&pThread->mSeed);
+        if (count < LIVE_BLOCKS && (count == 0 || r & 1)) {
+            int addr = BuddyAlloc(pThread->mpBuddy, RandomSize(&pThread->mSeed));
+            if (addr == -1)
+                pThread->mFailures++;
+            else
+                live[count++] = addr;
+        } else {
+            int i = (int) (r >> 1) % count;
+            BuddyFree(pThread->mpBuddy, live[i]);
+            live[i] = live[--count];
+        }
+    }
+    while (count)
+        BuddyFree(pThread->mpBuddy, live[--count]);
+    BuddyFlushCache(pThread->mpBuddy);
+    return NULL;
+}
+
+void *BurstWorker(void *pArg) {
+    BenchThread *pThread = pArg;
+    int sizes[BURST_SIZE], addrs[BURST_SIZE];
+    pthread_barrier_wait(&gStartBarrier);
+    for (int op = 0; op < OPS_PER_THREAD; op += 2 * BURST_SIZE) {
+        for (int i = 0; i < BURST_SIZE; ++i)
+            sizes[i] = RandomSize(&pThread->mSeed);
+        if (pThread->mBatched) {
+            pThread->mFailures += BURST_SIZE - BuddyAllocMany(pThread->mpBuddy, sizes, BURST_SIZE, addrs);
+            BuddyFreeMany(pThread->mpBuddy, addrs, BURST_SIZE);
+        } else {
+            for (int i = 0; i < BURST_SIZE; ++i)
+                if ((addrs[i] = BuddyAlloc(pThread->mpBuddy, sizes[i])) == -1)
+                    pThread->mFailures++;
+            for (int i = 0; i < BURST_SIZE; ++i)
+                if (addrs[i] != -1)
+                    BuddyFree(pThread->mpBuddy, addrs[i]);
+        }
+    }
+    return NULL;
+}
+
+double RunBench(int threads, int cache_orders, void *(*pWorker)(void *), int batched, long *pFailures) {
+    BuddyAllocator *pBuddy = BuddyCreate(POOL_SIZE, MIN_BLOCK, MAX_BLOCK, cache_orders);
+    if (!pBuddy) {
+        perror("BENCH: *** Error creating the buddy allocator");
+        exit(EXIT_FAILURE);
+    }
+    BenchThread *pThreads = calloc(threads, sizeof(BenchThread));
+    pthread_barrier_init(&gStartBarrier, NULL, threads + 1);
+    for (int i = 0; i < threads; ++i) {
+        pThreads[i].mpBuddy = pBuddy;
+        pThreads[i].mBatched = batched;
+        pThreads[i].mSeed = 2463534242u + i * 7919u;
+        pthread_create(&pThreads[i].mThread, NULL, pWorker, &pThreads[i]);
+    }
+    struct timespec start, end;
+    pthread_barrier_wait(&gStartBarrier);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < threads; ++i)
+        pthread_join(pThreads[i].mThread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *pFailures = 0;
+    for (int i = 0; i < threads; ++i)
+        *pFailures += pThreads[i].mFailures;
+    if (BuddyFreeBytes(pBuddy) != POOL_SIZE)
+        fprintf(stderr, "BENCH: *** %d bytes leaked\n", POOL_SIZE - BuddyFreeBytes(pBuddy));
+    pthread_barrier_destroy(&gStartBarrier);
+    free(pThreads);
+    BuddyDestroy(pBuddy);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double) threads * OPS_PER_THREAD / seconds;
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+    printf("%8s %18s %18s %18s %18s %10s\n", "threads", "locked Mops/s", "cached Mops/s", "burst Mops/s",
+           "batched Mops/s", "failures");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        long locked_failures, cached_failures, burst_failures, batched_failures;
+        double locked = RunBench(threads, 0, BenchWorker, 0, &locked_failures);
+        double cached = RunBench(threads, BUDDY_CACHE_ORDERS, BenchWorker, 0, &cached_failures);
+        double burst = RunBench(threads, 0, BurstWorker, 0, &burst_failures);
+        double batched = RunBench(threads, 0, BurstWorker, 1, &batched_failures);
+        printf("%8d %18.2f %18.2f %18.2f %18.2f %10ld\n", threads, locked / 1e6, cached / 1e6, burst / 1e6,
+               batched / 1e6, locked_failures + cached_failures + burst_failures + batched_failures);
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+//
+// LD_PRELOAD shim that routes the malloc family of a program to the buddy arena
+// build with make and run: LD_PRELOAD=./libbuddy_preload.so <program>
+// BUDDY_ARENA_MB sets the arena size (default 256, at most 1024), BUDDY_HUGE_PAGES=1 asks for huge pages
+//
+
+#include <stdlib.h>
+#include <malloc.h>
+#include "Headers/BuddyArena.h"
+
+void BuddyPrepareFork() { //hold the arena lock across fork so the child never inherits it taken
+    if (gpBuddyArena)
+        pthread_mutex_lock(&gpBuddyArena->mpBuddy->mLock);
+}
+
+void BuddyAfterFork() {
+    if (gpBuddyArena)
+        pthread_mutex_unlock(&gpBuddyArena->mpBuddy->mLock);
+}
+
+__attribute__((constructor)) void BuddyPreloadInit() {
+    pthread_once(&gBuddyArenaOnce, BuddyArenaInitDefault);
+    pthread_atfork(BuddyPrepareFork, BuddyAfterFork, BuddyAfterFork);
+}
+
+void *malloc(size_t size) {
+    return buddy_malloc(size);
+}
+
+void free(void *ptr) {
+    buddy_free(ptr);
+}
+
+void *calloc(size_t count, size_t size) {
+    return buddy_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    return buddy_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    return buddy_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return buddy_memalign(alignment, size);
+}
+
+int posix_memalign(void **pPtr, size_t alignment, size_t size) {
+    if (!alignment || (alignment & (alignment - 1)) || alignment % sizeof(void *))
+        return EINVAL;
+    void *ptr = buddy_memalign(alignment, size);
+    if (!ptr)
+        return ENOMEM;
+    *pPtr = ptr;
+    return 0;
+}
+
+void *valloc(size_t size) {
+    return buddy_memalign(sysconf(_SC_PAGESIZE), size);
+}
+
+void *pvalloc(size_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return buddy_memalign(page, (size + page - 1) & ~(page - 1));
+}
+
+size_t malloc_usable_size(void *ptr) {
+    return buddy_usable_size(ptr);
+}
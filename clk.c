@@ -6,6 +6,8 @@
  */
 
 #include "Headers/headers.h"
+#include <errno.h>
+#include <time.h>
 
 int shmid;
 
@@ -21,8 +23,9 @@ void cleanup(int signum)
 int main(int argc, char * argv[])
 {
     printf("Clock starting\n");
+    long tick_us = argc > 1 ? atol(argv[1]) : 1000000; //length of a tick, process_generator passes --tick
     signal(SIGINT, cleanup);
-    int clk = 0;
+    int clk = argc > 2 ? atoi(argv[2]) : 0; //a restored run counts on from its checkpoint
     //Create shared memory for one integer variable 4 bytes
     shmid = shmget(SHKEY, 4, IPC_CREAT | 0644);
     if ((long)shmid == -1)
@@ -37,9 +40,16 @@ int main(int argc, char * argv[])
         exit(-1);
     }
     *shmaddr = clk; /* initialize shared memory */
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
     while (1)
     {
-        sleep(1);
+        //sleep until an absolute deadline so the time spent waking others does not add up over a run
+        next.tv_nsec += (tick_us % 1000000) * 1000;
+        next.tv_sec += tick_us / 1000000 + next.tv_nsec / 1000000000;
+        next.tv_nsec %= 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
         (*shmaddr)++;
+        syscall(SYS_futex, shmaddr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0); //wake everyone waiting for this tick
     }
 }
@@ -0,0 +1,138 @@
+//
+// A/B comparison of the memory engines on the same workload
+// a seeded stream of processes arrives every tick, each one waits until its memory can be allocated and then holds it
+// for its runtime, like the scheduler without the CPU. Waiting processes are retried in arrival order every tick, so a
+// large request does not block smaller ones behind it. Every engine replays the exact same stream.
+// usage: engine_ab.out [seed] [uniform|above-pow2], the second mix draws sizes just above powers of 2, the worst case for
+// binary buddy rounding
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Headers/MemEngine.h"
+
+#define TICKS 50000
+#define MAX_PROCESSES 4096 //waiting and running at the same time
+
+typedef struct AbProcess {
+    int mMemSize;
+    int mArrival;
+    int mRuntime;
+    int mMemAddr; //-1 while waiting
+    int mFinish;
+} AbProcess;
+
+typedef struct AbResult {
+    long mArrivals;
+    long mAdmitted;
+    long mAdmittedOnArrival; //allocated on the tick they arrived
+    long mWaitTicks;
+    long mFailedAllocs;
+    double mRequested; //sums over ticks of the bytes requested and allocated by the running processes
+    double mAllocated;
+    double mAllocNs;
+    double mFreeNs;
+    long mFrees;
+} AbResult;
+
+unsigned int XorShift(unsigned int *pState) {
+    unsigned int x = *pState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *pState = x;
+}
+
+double NowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+int RandomMemSize(unsigned int *pState, int above_pow2) {
+    if (!above_pow2)
+        return 1 + (int) (XorShift(pState) % 256); //same range as test_generator
+    int power = 16 << XorShift(pState) % 4; //16 to 128
+    return power + 1 + (int) (XorShift(pState) % (power / 2)); //up to 1.5 times the power of 2
+}
+
+void RunWorkload(const MemEngine *pEngine, unsigned int seed, int above_pow2, AbResult *pResult) {
+    static AbProcess processes[MAX_PROCESSES];
+    int count = 0;
+    pEngine->mpInit();
+    for (int tick = 0; tick < TICKS; ++tick) {
+        if (count < MAX_PROCESSES && XorShift(&seed) % 3 == 0) { //on average one arrival every 3 ticks
+            AbProcess *pProcess = &processes[count++];
+            pProcess->mMemSize = RandomMemSize(&seed, above_pow2);
+            pProcess->mArrival = tick;
+            pProcess->mRuntime = 1 + (int) (XorShift(&seed) % 30);
+            pProcess->mMemAddr = -1;
+            pResult->mArrivals++;
+        }
+        int kept = 0;
+        for (int i = 0; i < count; ++i) { //finished processes free their memory first, the rest keep their order
+            AbProcess *pProcess = &processes[i];
+            if (pProcess->mMemAddr == -1 || pProcess->mFinish != tick) {
+                processes[kept++] = *pProcess;
+                continue;
+            }
+            double start = NowNs();
+            pEngine->mpFree(pProcess->mMemAddr);
+            pResult->mFreeNs += NowNs() - start;
+            pResult->mFrees++;
+        }
+        count = kept;
+        for (int i = 0; i < count; ++i) {
+            AbProcess *pProcess = &processes[i];
+            if (pProcess->mMemAddr != -1)
+                continue;
+            double start = NowNs();
+            pProcess->mMemAddr = pEngine->mpAlloc(pProcess->mMemSize);
+            pResult->mAllocNs += NowNs() - start;
+            if (pProcess->mMemAddr == -1) {
+                pResult->mFailedAllocs++;
+                continue;
+            }
+            pProcess->mFinish = tick + pProcess->mRuntime;
+            pResult->mAdmitted++;
+            pResult->mWaitTicks += tick - pProcess->mArrival;
+            pResult->mAdmittedOnArrival += tick == pProcess->mArrival;
+        }
+        for (int i = 0; i < count; ++i)
+            if (processes[i].mMemAddr != -1) {
+                pResult->mRequested += processes[i].mMemSize;
+                pResult->mAllocated += pEngine->mpRound(processes[i].mMemSize);
+            }
+    }
+    for (int i = 0; i < count; ++i)
+        if (processes[i].mMemAddr != -1)
+            pEngine->mpFree(processes[i].mMemAddr);
+    if (pEngine->mpFreeBytes() != pEngine->mPoolSize)
+        fprintf(stderr, "AB: *** %s leaked %d bytes\n", pEngine->mpName, pEngine->mPoolSize - pEngine->mpFreeBytes());
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int seed = argc > 1 ? (unsigned int) strtoul(argv[1], NULL, 10) : 2463534242u;
+    if (!seed)
+        seed = 1; //xorshift never leaves 0
+    int above_pow2 = argc > 2 && !strcmp(argv[2], "above-pow2");
+    if (argc > 2 && !above_pow2 && strcmp(argv[2], "uniform")) {
+        fprintf(stderr, "usage: %s [seed] [uniform|above-pow2]\n", argv[0]);
+        return 1;
+    }
+    printf("%d ticks, seed %u, %s sizes\n", TICKS, seed, above_pow2 ? "above-pow2" : "uniform");
+    printf("%-16s %10s %10s %10s %10s %12s %12s %10s %10s\n", "engine", "admitted", "on arrival", "mean wait",
+           "failed", "used bytes", "efficiency", "alloc ns", "free ns");
+    for (int i = 0; i < MEM_ENGINE_COUNT; ++i) {
+        AbResult result = {0};
+        RunWorkload(&gMemEngines[i], seed, above_pow2, &result);
+        printf("%-16s %10ld %9.1f%% %10.2f %10ld %12.1f %11.1f%% %10.1f %10.1f\n", gMemEngines[i].mpName,
+               result.mAdmitted, 100.0 * result.mAdmittedOnArrival / result.mArrivals,
+               result.mAdmitted ? (double) result.mWaitTicks / result.mAdmitted : 0, result.mFailedAllocs,
+               result.mRequested / TICKS, result.mAllocated ? 100 * result.mRequested / result.mAllocated : 0,
+               result.mAllocNs / (result.mAdmitted + result.mFailedAllocs), result.mFreeNs / result.mFrees);
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+//
+// Allocation benchmark that only uses the standard malloc family
+// run it as is to measure glibc malloc and with LD_PRELOAD=./libbuddy_preload.so to measure the buddy arena
+// every workload runs in its own child so throughput, peak RSS and page faults are reported per workload
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+typedef struct Workload {
+    const char *mpName;
+    int mLive; //blocks kept alive at the same time
+    int mMinSize;
+    int mMaxSize;
+    int mRealloc; //grow live blocks with realloc instead of replacing them
+    long mOps;
+} Workload;
+
+const Workload gWorkloads[] = {
+        {"small-churn",   16384, 8,    256,   0, 8000000},
+        {"mixed-sizes",   4096,  16,   65536, 0, 2000000},
+        {"realloc-grow",  1024,  16,   4096,  1, 4000000},
+};
+
+int gThreads = 1;
+
+unsigned int XorShift(unsigned int *pState) {
+    unsigned int x = *pState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *pState = x;
+}
+
+void *RunWorkload(void *pArg) {
+    const Workload *pLoad = pArg;
+    char **pBlocks = calloc(pLoad->mLive, sizeof(char *));
+    size_t *pSizes = calloc(pLoad->mLive, sizeof(size_t));
+    unsigned int seed = 2463534242u ^ (unsigned int) (size_t) &seed;
+    for (long op = 0; op < pLoad->mOps / gThreads; ++op) {
+        unsigned int r = XorShift(&seed);
+        int i = (int) (r % pLoad->mLive);
+        size_t size = pLoad->mMinSize + XorShift(&seed) % (pLoad->mMaxSize - pLoad->mMinSize + 1);
+        if (pLoad->mRealloc && pBlocks[i]) {
+            size = pSizes[i] + 1 + size / 64; //grow a little every time, restart once too large
+            if (size > (size_t) pLoad->mMaxSize) {
+                free(pBlocks[i]);
+                pBlocks[i] = NULL;
+                continue;
+            }
+            pBlocks[i] = realloc(pBlocks[i], size);
+        } else {
+            free(pBlocks[i]);
+            pBlocks[i] = malloc(size);
+        }
+        if (!pBlocks[i]) {
+            perror("BENCH: *** Allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        pBlocks[i][0] = pBlocks[i][size - 1] = (char) op; //touch both ends so the pages are really faulted in
+        pSizes[i] = size;
+    }
+    for (int i = 0; i < pLoad->mLive; ++i)
+        free(pBlocks[i]);
+    free(pBlocks);
+    free(pSizes);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    gThreads = argc > 1 ? atoi(argv[1]) : 1;
+    if (gThreads < 1)
+        gThreads = 1;
+    const char *pLabel = getenv("LD_PRELOAD") ? "preload" : "glibc";
+    printf("%-8s %-14s %8s %12s %12s %10s %10s\n", "malloc", "workload", "threads", "Mops/s", "maxrss KB",
+           "minflt", "majflt");
+    fflush(stdout);
+    for (size_t w = 0; w < sizeof(gWorkloads) / sizeof(Workload); ++w) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("BENCH: *** Error forking workload");
+            exit(EXIT_FAILURE);
+        }
+        if (!pid) {
+            pthread_t threads[64];
+            int count = gThreads < 64 ? gThreads : 64;
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int i = 0; i < count; ++i)
+                pthread_create(&threads[i], NULL, RunWorkload, (void *) &gWorkloads[w]);
+            for (int i = 0; i < count; ++i)
+                pthread_join(threads[i], NULL);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+            printf("%-8s %-14s %8d %12.2f ", pLabel, gWorkloads[w].mpName, count,
+                   gWorkloads[w].mOps / gThreads * count / seconds / 1e6);
+            fflush(stdout);
+            _exit(EXIT_SUCCESS);
+        }
+        int status;
+        struct rusage usage;
+        wait4(pid, &status, 0, &usage);
+        printf("%12ld %10ld %10ld\n", usage.ru_maxrss, usage.ru_minflt, usage.ru_majflt);
+        fflush(stdout); //or the next child inherits and prints this line again
+    }
+    return 0;
+}
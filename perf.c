@@ -0,0 +1,449 @@
+//
+// Performance regression harness for the whole pipeline
+// every workload is a processes.txt written by test_generator from a fixed seed and run through process_generator
+// with short clock ticks in perf/work. For each run the wall time, the cpu time of every process of the run, the
+// cpu time and peak RSS of the scheduler and the scheduling metrics of Stats.txt are written to a JSON file and
+// compared with a committed baseline. A metric regresses when it is worse than the baseline by more than its relative
+// tolerance, and at least by its absolute slack so tiny values do not flap; the exit status is 1 if any did.
+// The pressure workloads run round robin with long jobs, so stopped processes hold the memory and arrivals wait for
+// it; such a run fails if no allocation failed, or with --compact if nothing was compacted. Which waiting job gets
+// memory first depends on signal timing there, so the metrics that swing with it are printed but not compared.
+// With -c one workload, medium unless -w names another, is run once per scheduling policy instead and throughput,
+// cpu utilization, context switches and the waiting time tail of every policy are printed side by side.
+// usage: perf.out [-w WORKLOAD] [-o RESULTS] [-b BASELINE] [-u] [-c], -u writes the results as the new baseline
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <limits.h>
+#include "Headers/Policy.h"
+
+#define WORK_DIR "perf/work"
+#define RUN_LIMIT 300 //seconds before a run is interrupted
+
+typedef struct Workload {
+    const char *mpName;
+    int mCount;
+    const char *mpSeed;
+    const char *mpMaxGap; //test_generator limits
+    const char *mpMaxRuntime;
+    const char *mpMaxMemSize;
+    const char *mpTickUs;
+    const char *mpPolicy; //scheduling policy, NULL for the default
+    const char *mpOption; //extra scheduler option, NULL for none
+    const char *mpOptionValue;
+    int mPressure; //1 if jobs must wait for memory, the run fails when no allocation failed
+} Workload;
+
+//round robin starts every job before the long ones finish, so the stopped ones fill the memory
+const Workload gWorkloads[] = {
+        {"small",            20,   "101", "10", "30", "256", "1000", NULL, NULL,        NULL,   0},
+        {"medium",           200,  "102", "10", "30", "256", "1000", NULL, NULL,        NULL,   0},
+        {"huge",             2000, "103", "10", "30", "256", "500",  NULL, NULL,        NULL,   0},
+        {"pressure",         300,  "104", "2",  "60", "256", "1000", "rr", NULL,        NULL,   1},
+        {"pressure-compact", 300,  "104", "2",  "60", "256", "1000", "rr", "--compact", "0.01", 1},
+        {"pressure-slab",    300,  "105", "1",  "60", "128", "1000", "rr", "--slab",    NULL,   1},
+};
+
+#define WORKLOAD_COUNT (int) (sizeof(gWorkloads) / sizeof(gWorkloads[0]))
+
+typedef struct Metric {
+    const char *mpKey;
+    double mTolerance; //relative
+    double mSlack; //absolute, in the unit of the metric
+    int mHigherIsBetter;
+    int mOrderDependent; //swings with which waiting job gets memory first, not compared on pressure workloads
+} Metric;
+
+enum MetricIndex {
+    M_WALL, M_RUN_CPU, M_SCHED_CPU, M_SCHED_RSS, M_CPU_UTIL, M_AVG_WAIT, M_AVG_WTA, M_STD_WTA, M_WAIT_P99, M_WTA_P99,
+    M_DISPATCH_P99, M_FAILED_ALLOCS, M_PEAK_RESIDENT, METRIC_COUNT
+};
+
+const Metric gMetrics[METRIC_COUNT] = {
+        {"wall_s",            0.25, 0.5,  0, 0}, //mostly ticks times tick length, catches the scheduler falling behind
+        {"run_cpu_s",         0.50, 0.10, 0, 0},
+        {"scheduler_cpu_s",   0.50, 0.05, 0, 0},
+        {"scheduler_rss_kb",  0.20, 512,  0, 0},
+        {"cpu_utilization",   0.02, 0.5,  1, 0},
+        {"avg_waiting",       0.05, 1,    0, 0},
+        {"avg_wta",           0.05, 0.05, 0, 1}, //one tick jobs that waited long dominate it
+        {"std_wta",           0.10, 0.05, 0, 1},
+        {"waiting_p99",       0.10, 2,    0, 0},
+        {"wta_p99",           0.10, 0.1,  0, 1},
+        {"dispatch_p99_us",   3.00, 500,  0, 0}, //microseconds of a shared machine, only catches big jumps
+        {"failed_allocs",     0.50, 20,   0, 1}, //retries, how many depends on when arrivals are signalled
+        {"peak_resident",     0.25, 1,    1, 1},
+};
+
+typedef struct Result {
+    char mName[32];
+    int mOk; //the run finished and wrote Stats.txt
+    int mPressure; //of the workload, not saved
+    double mValues[METRIC_COUNT];
+} Result;
+
+typedef struct PolicyResult { //what -c prints for one policy, from Stats.txt
+    int mOk;
+    double mThroughput; //finished processes per tick
+    double mCpuUtil;
+    double mSwitches;
+    double mPreemptions;
+    double mAvgWait;
+    double mWait[4]; //p50, p90, p99, max
+    double mAvgWta;
+    double mWall;
+} PolicyResult;
+
+pid_t gRunPid = 0;
+
+void RunTimeout(int signum) { //process_generator cleans everything up on SIGINT
+    if (gRunPid)
+        kill(gRunPid, SIGINT);
+}
+
+int Run(char *const argv[], const char *pOutput) { //exit status of the program, -1 if it could not run
+    pid_t pid = fork();
+    if (pid == -1)
+        return -1;
+    if (pid == 0) {
+        int fd = open(pOutput, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd != -1) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+        }
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    gRunPid = pid;
+    alarm(RUN_LIMIT);
+    int status;
+    while (waitpid(pid, &status, 0) == -1);
+    alarm(0);
+    gRunPid = 0;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+double CpuSeconds(const struct rusage *pUsage) {
+    return pUsage->ru_utime.tv_sec + pUsage->ru_utime.tv_usec / 1e6 + pUsage->ru_stime.tv_sec +
+           pUsage->ru_stime.tv_usec / 1e6;
+}
+
+/*
+** int error = ReadStats(Result *pResult, const Workload *pWorkload)
+** -1 if Stats.txt is missing or incomplete, not every process finished, or the run did not put the memory under the
+** pressure the workload is there for
+*/
+int ReadStats(Result *pResult, const Workload *pWorkload) {
+    FILE *pFile = fopen("Stats.txt", "r");
+    if (!pFile)
+        return -1;
+    double *pValues = pResult->mValues, user = 0, system = 0;
+    int found = 0, finished = -1, compactions = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), pFile)) {
+        double p50, p90;
+        found += sscanf(line, "Avg Waiting = %lf", &pValues[M_AVG_WAIT]);
+        found += sscanf(line, "CPU utilization = %lf", &pValues[M_CPU_UTIL]);
+        found += sscanf(line, "Avg WTA = %lf", &pValues[M_AVG_WTA]);
+        found += sscanf(line, "STD WTA = %lf", &pValues[M_STD_WTA]);
+        if (sscanf(line, "Waiting p50 = %lf, p90 = %lf, p99 = %lf", &p50, &p90, &pValues[M_WAIT_P99]) == 3)
+            found++;
+        if (sscanf(line, "WTA p50 = %lf, p90 = %lf, p99 = %lf", &p50, &p90, &pValues[M_WTA_P99]) == 3)
+            found++;
+        if (sscanf(line, "Dispatch us p50 = %lf, p90 = %lf, p99 = %lf", &p50, &p90, &pValues[M_DISPATCH_P99]) == 3)
+            found++;
+        found += sscanf(line, "Failed allocations = %lf", &pValues[M_FAILED_ALLOCS]);
+        found += sscanf(line, "Peak resident processes = %lf", &pValues[M_PEAK_RESIDENT]);
+        if (sscanf(line, "Scheduler cpu = %lf s user, %lf s system, peak RSS = %lf", &user, &system,
+                   &pValues[M_SCHED_RSS]) == 3) {
+            pValues[M_SCHED_CPU] = user + system;
+            found++;
+        }
+        sscanf(line, "Finished processes = %d", &finished);
+        sscanf(line, "Compactions = %d", &compactions);
+    }
+    fclose(pFile);
+    if (finished != pWorkload->mCount) {
+        fprintf(stderr, "perf: *** %d of %d processes finished\n", finished, pWorkload->mCount);
+        return -1;
+    }
+    if (pWorkload->mPressure && pValues[M_FAILED_ALLOCS] <= 0) {
+        fprintf(stderr, "perf: *** %s never waited for memory\n", pWorkload->mpName);
+        return -1;
+    }
+    if (pWorkload->mPressure && pWorkload->mpOption && !strcmp(pWorkload->mpOption, "--compact") && !compactions) {
+        fprintf(stderr, "perf: *** %s never compacted\n", pWorkload->mpName);
+        return -1;
+    }
+    return found == METRIC_COUNT - 3 ? 0 : -1; //wall and run cpu are measured here, one line has two
+}
+
+/*
+** void RunWorkload(const Workload *pWorkload, const char *pPolicy, Result *pResult)
+** generate the workload and run it, with --policy pPolicy instead of the workload's own unless it is NULL,
+** Stats.txt of the run is left behind
+*/
+void RunWorkload(const Workload *pWorkload, const char *pPolicy, Result *pResult) {
+    memset(pResult, 0, sizeof(Result));
+    snprintf(pResult->mName, sizeof(pResult->mName), "%s", pWorkload->mpName);
+    pResult->mPressure = pWorkload->mPressure;
+    char count[16];
+    snprintf(count, sizeof(count), "%d", pWorkload->mCount);
+    char *generator_argv[] = {"./test_generator.out", "-n", count, "-s", (char *) pWorkload->mpSeed, "-a",
+                              (char *) pWorkload->mpMaxGap, "-r", (char *) pWorkload->mpMaxRuntime, "-m",
+                              (char *) pWorkload->mpMaxMemSize, NULL};
+    if (Run(generator_argv, "generator.log")) {
+        fprintf(stderr, "perf: *** test_generator failed for %s\n", pWorkload->mpName);
+        return;
+    }
+    char *run_argv[10] = {"./process_generator.out", "--tick", (char *) pWorkload->mpTickUs, "--log-level", "error"};
+    int run_argc = 5;
+    if (pWorkload->mpOption) {
+        run_argv[run_argc++] = (char *) pWorkload->mpOption;
+        if (pWorkload->mpOptionValue)
+            run_argv[run_argc++] = (char *) pWorkload->mpOptionValue;
+    }
+    if (!pPolicy)
+        pPolicy = pWorkload->mpPolicy;
+    if (pPolicy) {
+        run_argv[run_argc++] = "--policy";
+        run_argv[run_argc++] = (char *) pPolicy;
+    }
+    remove("Stats.txt");
+    struct rusage before, after;
+    struct timespec start, end;
+    getrusage(RUSAGE_CHILDREN, &before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = Run(run_argv, "run.log");
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_CHILDREN, &after); //every process of the run was waited for by its parent
+    if (status || ReadStats(pResult, pWorkload)) {
+        fprintf(stderr, "perf: *** %s did not finish, see %s/run.log\n", pWorkload->mpName, WORK_DIR);
+        return;
+    }
+    pResult->mValues[M_WALL] = end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+    pResult->mValues[M_RUN_CPU] = CpuSeconds(&after) - CpuSeconds(&before);
+    pResult->mOk = 1;
+}
+
+int ReadPolicyStats(PolicyResult *pResult) { //-1 if Stats.txt is missing or incomplete
+    FILE *pFile = fopen("Stats.txt", "r");
+    if (!pFile)
+        return -1;
+    int found = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), pFile)) {
+        double finished, ticks, p99_9;
+        found += sscanf(line, "Avg Waiting = %lf", &pResult->mAvgWait);
+        found += sscanf(line, "CPU utilization = %lf", &pResult->mCpuUtil);
+        found += sscanf(line, "Avg WTA = %lf", &pResult->mAvgWta);
+        if (sscanf(line, "Waiting p50 = %lf, p90 = %lf, p99 = %lf, p99.9 = %lf, max = %lf", &pResult->mWait[0],
+                   &pResult->mWait[1], &pResult->mWait[2], &p99_9, &pResult->mWait[3]) == 5)
+            found++;
+        if (sscanf(line, "Context switches = %lf, preemptions = %lf", &pResult->mSwitches,
+                   &pResult->mPreemptions) == 2)
+            found++;
+        if (sscanf(line, "Finished processes = %lf in %lf ticks, throughput = %lf", &finished, &ticks,
+                   &pResult->mThroughput) == 3)
+            found++;
+    }
+    fclose(pFile);
+    return found == 6 ? 0 : -1;
+}
+
+/*
+** int failed = ComparePolicies(const Workload *pWorkload)
+** run the workload under every scheduling policy and print one row per policy, the number of runs that failed
+*/
+int ComparePolicies(const Workload *pWorkload) {
+    PolicyResult results[POLICY_COUNT];
+    Result result;
+    int failed = 0;
+    for (int i = 0; i < POLICY_COUNT; ++i) {
+        printf("perf: running %s with --policy %s, %d processes...\n", pWorkload->mpName, gPolicies[i].mpName,
+               pWorkload->mCount);
+        fflush(stdout);
+        memset(&results[i], 0, sizeof(PolicyResult));
+        RunWorkload(pWorkload, gPolicies[i].mpName, &result);
+        results[i].mOk = result.mOk && !ReadPolicyStats(&results[i]);
+        results[i].mWall = result.mValues[M_WALL];
+        failed += !results[i].mOk;
+    }
+    printf("%-8s %10s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n", "policy", "throughput", "cpu_util", "switches",
+           "preempts", "avg_wait", "wait_p50", "wait_p90", "wait_p99", "wait_max", "avg_wta", "wall_s");
+    for (int i = 0; i < POLICY_COUNT; ++i) {
+        if (!results[i].mOk) {
+            printf("%-8s did not finish, see %s/run.log\n", gPolicies[i].mpName, WORK_DIR);
+            continue;
+        }
+        printf("%-8s %10.3f %8.2f %8.0f %8.0f %8.2f %8.0f %8.0f %8.0f %8.0f %8.2f %8.2f\n", gPolicies[i].mpName,
+               results[i].mThroughput, results[i].mCpuUtil, results[i].mSwitches, results[i].mPreemptions,
+               results[i].mAvgWait, results[i].mWait[0], results[i].mWait[1], results[i].mWait[2],
+               results[i].mWait[3], results[i].mAvgWta, results[i].mWall);
+    }
+    return failed;
+}
+
+int WriteResults(const char *pPath, const Result *pResults, int count) {
+    FILE *pFile = fopen(pPath, "w");
+    if (!pFile)
+        return -1;
+    fprintf(pFile, "{\n  \"workloads\": [\n");
+    for (int i = 0; i < count; ++i) {
+        fprintf(pFile, "    {\n      \"name\": \"%s\",\n      \"ok\": %s", pResults[i].mName,
+                pResults[i].mOk ? "true" : "false");
+        for (int j = 0; j < METRIC_COUNT && pResults[i].mOk; ++j)
+            fprintf(pFile, ",\n      \"%s\": %.3f", gMetrics[j].mpKey, pResults[i].mValues[j]);
+        fprintf(pFile, "\n    }%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(pFile, "  ]\n}\n");
+    return fclose(pFile);
+}
+
+/*
+** int count = ReadResults(const char *pPath, Result *pResults)
+** read a file written by WriteResults, one key per line is all it understands, -1 if it cannot be opened
+*/
+int ReadResults(const char *pPath, Result *pResults) {
+    FILE *pFile = fopen(pPath, "r");
+    if (!pFile)
+        return -1;
+    int count = 0;
+    char line[256], key[64], name[32];
+    double value;
+    while (fgets(line, sizeof(line), pFile)) {
+        if (sscanf(line, " \"name\": \"%31[^\"]\"", name) == 1 && count < WORKLOAD_COUNT) {
+            memset(&pResults[count], 0, sizeof(Result));
+            strcpy(pResults[count++].mName, name);
+        } else if (count && strstr(line, "\"ok\": true")) {
+            pResults[count - 1].mOk = 1;
+        } else if (count && sscanf(line, " \"%63[^\"]\": %lf", key, &value) == 2) {
+            for (int j = 0; j < METRIC_COUNT; ++j)
+                if (!strcmp(key, gMetrics[j].mpKey))
+                    pResults[count - 1].mValues[j] = value;
+        }
+    }
+    fclose(pFile);
+    return count;
+}
+
+int Compare(const Result *pResult, const Result *pBaseline) { //number of regressed metrics, printed as it goes
+    int regressions = 0;
+    for (int j = 0; j < METRIC_COUNT; ++j) {
+        const Metric *pMetric = &gMetrics[j];
+        double base = pBaseline->mValues[j], now = pResult->mValues[j];
+        double allowed = base * pMetric->mTolerance > pMetric->mSlack ? base * pMetric->mTolerance : pMetric->mSlack;
+        double worse = pMetric->mHigherIsBetter ? base - now : now - base; //positive when it got worse
+        int compared = !(pResult->mPressure && pMetric->mOrderDependent);
+        const char *pVerdict = worse > allowed ? "REGRESSED" : -worse > allowed ? "improved" : "ok";
+        if (!compared)
+            pVerdict = "not compared";
+        regressions += compared && worse > allowed;
+        printf("%-18s %-18s %12.3f %12.3f %+8.1f%%  %s\n", pResult->mName, pMetric->mpKey, base, now,
+               base ? 100 * (now - base) / base : 0, pVerdict);
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    const char *pOnly = NULL, *pOutput = WORK_DIR "/results.json", *pBaseline = "perf/baseline.json";
+    int update = 0, compare = 0, opt;
+    while ((opt = getopt(argc, argv, "w:o:b:uc")) != -1) {
+        switch (opt) {
+            case 'w': pOnly = optarg; break;
+            case 'o': pOutput = optarg; break;
+            case 'b': pBaseline = optarg; break;
+            case 'u': update = 1; break;
+            case 'c': compare = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-w WORKLOAD] [-o RESULTS] [-b BASELINE] [-u] [-c]\n", argv[0]);
+                return 2;
+        }
+    }
+    //paths given on the command line are relative to where we started, the runs happen in the work directory
+    char output[PATH_MAX], baseline[PATH_MAX], cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd)))
+        return 2;
+    snprintf(output, sizeof(output), "%s%s%s", pOutput[0] == '/' ? "" : cwd, pOutput[0] == '/' ? "" : "/", pOutput);
+    snprintf(baseline, sizeof(baseline), "%s%s%s", pBaseline[0] == '/' ? "" : cwd, pBaseline[0] == '/' ? "" : "/",
+             pBaseline);
+    mkdir("perf", 0755);
+    mkdir(WORK_DIR, 0755);
+    const char *pLinks[] = {"process_generator.out", "srtn.out", "clk.out", "process.out", "test_generator.out",
+                            "ftokfile"};
+    for (int i = 0; i < (int) (sizeof(pLinks) / sizeof(pLinks[0])); ++i) {
+        char target[PATH_MAX], link[PATH_MAX];
+        snprintf(target, sizeof(target), "%s/%s", cwd, pLinks[i]);
+        snprintf(link, sizeof(link), "%s/%s", WORK_DIR, pLinks[i]);
+        unlink(link);
+        if (symlink(target, link)) {
+            perror("perf: *** Error preparing " WORK_DIR);
+            return 2;
+        }
+    }
+    if (chdir(WORK_DIR)) {
+        perror("perf: *** Error entering " WORK_DIR);
+        return 2;
+    }
+    signal(SIGALRM, RunTimeout);
+
+    if (compare) { //the policies side by side, nothing is compared with the baseline
+        const char *pName = pOnly ? pOnly : "medium";
+        for (int i = 0; i < WORKLOAD_COUNT; ++i)
+            if (!strcmp(pName, gWorkloads[i].mpName))
+                return ComparePolicies(&gWorkloads[i]) ? 1 : 0;
+        fprintf(stderr, "perf: *** no workload named %s\n", pName);
+        return 2;
+    }
+
+    Result results[WORKLOAD_COUNT];
+    int count = 0;
+    for (int i = 0; i < WORKLOAD_COUNT; ++i) {
+        if (pOnly && strcmp(pOnly, gWorkloads[i].mpName))
+            continue;
+        printf("perf: running %s, %d processes...\n", gWorkloads[i].mpName, gWorkloads[i].mCount);
+        fflush(stdout);
+        RunWorkload(&gWorkloads[i], NULL, &results[count++]);
+    }
+    if (!count) {
+        fprintf(stderr, "perf: *** no workload named %s\n", pOnly);
+        return 2;
+    }
+    if (WriteResults(output, results, count))
+        perror("perf: *** Error writing the results");
+    else
+        printf("perf: results written to %s\n", pOutput);
+    if (update) {
+        if (WriteResults(baseline, results, count))
+            perror("perf: *** Error writing the baseline");
+        else
+            printf("perf: baseline %s updated\n", pBaseline);
+        return 0;
+    }
+
+    Result base[WORKLOAD_COUNT];
+    int base_count = ReadResults(baseline, base);
+    if (base_count == -1) {
+        printf("perf: no baseline at %s, run with -u to record one\n", pBaseline);
+        return 0;
+    }
+    int regressions = 0, failed = 0;
+    printf("%-18s %-18s %12s %12s %9s\n", "workload", "metric", "baseline", "current", "change");
+    for (int i = 0; i < count; ++i) {
+        failed += !results[i].mOk;
+        for (int j = 0; j < base_count; ++j)
+            if (results[i].mOk && base[j].mOk && !strcmp(results[i].mName, base[j].mName))
+                regressions += Compare(&results[i], &base[j]);
+    }
+    printf("perf: %d regressions, %d failed runs\n", regressions, failed);
+    return regressions || failed;
+}
@@ -1,10 +1,89 @@
 #include "Headers/headers.h"
+#include "Headers/WorkerPool.h"
 #include "time.h"
 
+int ReadJob(WorkerJob *);
+
+void RunOnClock(int);
+
+void StopHandler(int);
+
+void ContinueHandler(int);
+
+volatile int gConsumed = 0; //clock ticks spent running before the last stop
+volatile int gLastStart = 0; //clock value at which we started or were last resumed
+volatile sig_atomic_t gContinued = 0; //set by SIGCONT while StopHandler waits for it
+
 int main(int agrc, char *argv[]) {
 
-    int runtime = atoi(argv[1]);
-    while ((clock() / CLOCKS_PER_SEC) < runtime);
+    int runtime;
+    bool clock_mode = false;
+    if (agrc > 1) { //runtime passed on the command line
+        runtime = atoi(argv[1]);
+    } else { //worker mode, stay parked until the scheduler hands us a job
+        WorkerJob job;
+        if (ReadJob(&job) == -1) //pool was destroyed before we got a job
+            exit(EXIT_SUCCESS);
+        runtime = job.mRuntime;
+        clock_mode = job.mClockMode;
+    }
+    if (clock_mode)
+        RunOnClock(runtime);
+    else
+        while ((clock() / CLOCKS_PER_SEC) < runtime);
 
     exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+}
+
+int ReadJob(WorkerJob *pJob) {
+    size_t received = 0;
+    while (received < sizeof(WorkerJob)) {
+        ssize_t n = read(STDIN_FILENO, (char *) pJob + received, sizeof(WorkerJob) - received);
+        if (n == 0 || (n == -1 && errno != EINTR))
+            return -1;
+        if (n > 0)
+            received += n;
+    }
+    return 0;
+}
+
+void RunOnClock(int runtime) {
+    initClk();
+    gLastStart = getClk();
+    signal(SIGCONT, ContinueHandler); //first, a StopHandler without it would never wake up
+    struct sigaction stop_action = {0};
+    stop_action.sa_handler = StopHandler;
+    sigaddset(&stop_action.sa_mask, SIGCONT); //taken only inside the sigsuspend of StopHandler
+    sigaction(SIGTSTP, &stop_action, NULL);
+
+    sigset_t tstp_set;
+    sigemptyset(&tstp_set);
+    sigaddset(&tstp_set, SIGTSTP);
+    while (1) {
+        sigprocmask(SIG_BLOCK, &tstp_set, NULL); //read both counters without a stop in between
+        int now = getClk();
+        int consumed = gConsumed + (now - gLastStart);
+        sigprocmask(SIG_UNBLOCK, &tstp_set, NULL);
+        if (consumed >= runtime)
+            break;
+        waitClk(now); //sleep until the next tick or until a stop/continue interrupts us
+    }
+    destroyClk(false);
+}
+
+void StopHandler(int signum) {
+    gConsumed += getClk() - gLastStart; //ticks run up to this stop
+    //sleep until SIGCONT instead of raising SIGSTOP: on short ticks the scheduler may resume us before we got to
+    //raise it, and we would then stop for good. A SIGCONT sent meanwhile stays blocked and pending until here
+    sigset_t wait_set;
+    sigprocmask(SIG_SETMASK, NULL, &wait_set);
+    sigdelset(&wait_set, SIGCONT);
+    gContinued = 0;
+    while (!gContinued)
+        sigsuspend(&wait_set);
+    gLastStart = getClk(); //ticks spent stopped do not count
+}
+
+void ContinueHandler(int signum) {
+    gContinued = 1;
+}
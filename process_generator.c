@@ -1,37 +1,84 @@
 #include "Headers/headers.h"
 #include "Headers/ProcessQueue.h"
 #include "Headers/MessageBuffer.h"
+#include "Headers/Options.h"
+#include "Headers/Checkpoint.h"
 #include <string.h>
+#include <sys/socket.h>
+#include <fcntl.h>
 #include "math.h"
 
 void ClearResources(int);
 
+void RemoveQueue();
+
 void ReadFile();
 
 void InitIPC();
 
 void ExecuteClock();
 
-void ExecuteScheduler();
+pid_t ExecuteScheduler(int);
+
+void SendTable();
+
+void SendArrivals(Message *);
+
+void SkipArrived();
+
+void StartNodes();
+
+void ShardProcess(const Process *);
+
+void FlushNodes();
 
-void SendProcess(Process *);
+void EndNodes();
+
+void MergeEvents();
+
+void MergeStats();
 
 queue gProcessQueue;
 int gMsgQueueId = 0;
 pid_t gClockPid = 0;
 pid_t gSchedulerPid = 0;
+char **gpArgv; //command line options, forwarded to the scheduler
+int gProcessCount = 0;
+unsigned int gMaxId = 0; //largest process id in the input file
+int gClockStart = 0; //clock value to count from, where a restored checkpoint left off
+ClusterNode gNodes[MAX_NODES]; //schedulers of a cluster, --nodes of them
+int gNodeSocket = -1; //node end of the socket pair of the node being started
 
 int main(int argc, char *argv[]) {
+    ParseOptions(argc, argv);
+    if (gOptions.mpReplayPath) { //nothing to generate, the trace has every input already
+        fprintf(stderr, "A replay needs no processes or clock, run srtn.out --replay %s directly\n",
+                gOptions.mpReplayPath);
+        exit(EXIT_FAILURE);
+    }
+    if (gOptions.mNodes && (gOptions.mpRestorePath || gOptions.mpRecordPath || gOptions.mCheckpointEvery)) {
+        fprintf(stderr, "A cluster can neither be recorded nor checkpointed, run without --nodes for that\n");
+        exit(EXIT_FAILURE);
+    }
+    LogStart();
+    gpArgv = argv;
     //initialize the process queue
     gProcessQueue = NewProcQueue();
     //catch SIGINT
     signal(SIGINT, ClearResources);
     // 1. Read the input files.
     ReadFile();
-    //initialize the IPC
-    InitIPC();
+    if (gOptions.mpRestorePath) //the scheduler has the processes that had arrived in its snapshot
+        SkipArrived();
     // 3. Initiate and create the scheduler and clock processes.
-    ExecuteScheduler();
+    if (gOptions.mNodes) {
+        StartNodes(); //every node gets its table over its own socket, there is no queue
+    } else {
+        //initialize the IPC
+        InitIPC();
+        SendTable(); //queued before the scheduler starts, so it is the first message it reads
+        gSchedulerPid = ExecuteScheduler(-1);
+    }
     ExecuteClock();
     // 4. Use this function after creating the clock process to initialize clock
     initClk();
@@ -39,52 +86,71 @@ int main(int argc, char *argv[]) {
     while (!ProcQueueEmpty(gProcessQueue)) {
         //get current time
         int current_time = getClk();
+        for (int i = 0; i < gOptions.mNodes; ++i) //latest load of every node before placing this tick's arrivals
+            ClusterDrain(&gNodes[i], 0);
         //temporary process pointer
         Process *pTempProcess;
         //peek the processes queue
         ProcPeek(gProcessQueue, &pTempProcess);
         //keep looping as long as the process on top has arrival time equal to the current time
         bool is_time = false; //flag to indicate whether at least one process matches current time or not
-        while (pTempProcess->mArrivalTime == current_time) {
+        bool has_next = true;
+        Message msg;
+        msg.mCount = 0;
+        while (has_next && pTempProcess->mArrivalTime <= current_time) { //<= catches up after a late start on short ticks
             is_time = true;
-            SendProcess(pTempProcess); //send this process to the scheduler
+            if (gOptions.mNodes) {
+                ShardProcess(pTempProcess);
+            } else {
+                ProcessToRecord(pTempProcess, &msg.mRecords[msg.mCount++]); //pack this process into the next message
+                if (msg.mCount == ARRIVAL_BATCH)
+                    SendArrivals(&msg);
+            }
             ProcDequeue(gProcessQueue, &pTempProcess); //dequeue this process from the processes queue
             free(pTempProcess); //free memory allocated by this process
-            ProcPeek(gProcessQueue, &pTempProcess); //peek the next process in the queue
+            has_next = ProcPeek(gProcessQueue, &pTempProcess); //peek the next process, the queue may be empty now
         }
-        if (is_time) //if at least one process was sent to the scheduler
+        if (msg.mCount)
+            SendArrivals(&msg);
+        if (gOptions.mNodes)
+            FlushNodes();
+        else if (is_time) //if at least one process was sent to the scheduler
             kill(gSchedulerPid, SIGUSR1); //send SIGUSR1 to the scheduler
-        usleep(900000); //sleep 0.9 sec
+        waitClk(current_time); //sleep until the next tick, however long ticks are
     }
+    EndNodes();
     // invoke ClearResources() but use zero as parameter to indicate normal exit not interrupt
     ClearResources(0);
 }
 
 void ClearResources(int signum) {
-    //Clear IPC resources
-    if (gMsgQueueId != 0) {
-        printf("PG: *** Cleaning IPC resources...\n");
-        if (msgctl(gMsgQueueId, IPC_RMID, NULL) == -1)
-            perror("PG: *** Error");
-        else
-            printf("PG: *** IPC cleaned!\n");
-    }
+    //a scheduler that is still busy, compacting or swapping memory, has not drained the last arrivals yet, the queue
+    //stays until it exits
+    if (signum == SIGINT)
+        RemoveQueue();
+    int failed = signum == SIGINT; //interrupted, or a scheduler left processes unfinished
 
     //free queue memory
-    printf("PG: *** Cleaning processes queue...\n");
+    LOG(LOG_INFO, "PG: *** Cleaning processes queue...\n");
     Process *pTemp;
     while (ProcDequeue(gProcessQueue, &pTemp)) {
         free(pTemp);
     }
-    printf("PG: *** Process queue cleaned!\n");
+    LOG(LOG_INFO, "PG: *** Process queue cleaned!\n");
 
     //if this function is invoked due to an interrupt signal then immediately interrupt all processes
     if (signum == SIGINT) {
         //Interrupt forked processes
-        printf("PG: *** Sending interrupt to scheduler\n");
+        LOG(LOG_INFO, "PG: *** Sending interrupt to scheduler\n");
         if (gSchedulerPid)
             kill(gSchedulerPid, SIGINT);
-        printf("PG: *** Sending interrupt to clock\n");
+        for (int i = 0; i < gOptions.mNodes; ++i) {
+            if (gNodes[i].mPid) {
+                kill(gNodes[i].mPid, SIGINT);
+                waitpid(gNodes[i].mPid, NULL, 0);
+            }
+        }
+        LOG(LOG_INFO, "PG: *** Sending interrupt to clock\n");
         if (gClockPid) {
             destroyClk(false);
             kill(gClockPid, SIGINT);
@@ -93,10 +159,24 @@ void ClearResources(int signum) {
         wait(NULL);
         wait(NULL);
     } else { //we need to wait until Scheduler exits by itself
-        printf("PG: *** Waiting for scheduler to do its job...\n");
-        waitpid(gSchedulerPid, NULL, 0); //wait until scheduler exits
-        printf("PG: *** Scheduler exit signal received\n");
-        printf("PG: *** Sending interrupt to clock\n");
+        LOG(LOG_INFO, "PG: *** Waiting for scheduler to do its job...\n");
+        int status;
+        if (gSchedulerPid) { //wait until scheduler exits, it fails if processes were left unfinished
+            waitpid(gSchedulerPid, &status, 0);
+            failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+        }
+        RemoveQueue();
+        for (int i = 0; i < gOptions.mNodes; ++i) { //its summary is the last thing a node sends
+            ClusterDrain(&gNodes[i], 1);
+            waitpid(gNodes[i].mPid, &status, 0);
+            failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+        }
+        if (gOptions.mNodes) {
+            MergeEvents();
+            MergeStats();
+        }
+        LOG(LOG_INFO, "PG: *** Scheduler exit signal received\n");
+        LOG(LOG_INFO, "PG: *** Sending interrupt to clock\n");
         if (gClockPid) {
             destroyClk(false);
             kill(gClockPid, SIGINT);
@@ -104,12 +184,22 @@ void ClearResources(int signum) {
         //do not leave before clock is done
         wait(NULL);
     }
-    printf("PG: *** Clean!\n");
-    exit(EXIT_SUCCESS);
+    LOG(LOG_INFO, "PG: *** Clean!\n");
+    exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+void RemoveQueue() { //clear IPC resources
+    if (gMsgQueueId == 0)
+        return;
+    LOG(LOG_INFO, "PG: *** Cleaning IPC resources...\n");
+    if (msgctl(gMsgQueueId, IPC_RMID, NULL) == -1)
+        perror("PG: *** Error");
+    else
+        LOG(LOG_INFO, "PG: *** IPC cleaned!\n");
 }
 
 void ReadFile() {
-    printf("PG: *** Attempting to open input file...\n");
+    LOG(LOG_INFO, "PG: *** Attempting to open input file...\n");
     FILE *pFile;
     char *pLine = NULL;
     size_t len = 0;
@@ -119,7 +209,7 @@ void ReadFile() {
         perror("PG: *** Error reading from input file");
         exit(EXIT_FAILURE);
     }
-    printf("PG: *** Reading input file...\n");
+    LOG(LOG_INFO, "PG: *** Reading input file...\n");
     unsigned int runtime_sum = 0, runtime_squared_sum = 0, count = 0;
     while ((read = getline(&pLine, &len, pFile)) != -1) {
         if (pLine[0] == '#') //skip hashes as they are just comments in the input file
@@ -128,7 +218,7 @@ void ReadFile() {
         Process *pProcess = malloc(sizeof(Process));
         while (!pProcess) {
             perror("PG: *** Malloc failed");
-            printf("PG: *** Trying again");
+            LOG(LOG_ERROR, "PG: *** Trying again\n");
             pProcess = malloc(sizeof(Process));
         }
 
@@ -137,25 +227,62 @@ void ReadFile() {
         pProcess->mRuntime = atoi(strtok(NULL, "\t"));
         pProcess->mPriority = atoi(strtok(NULL, "\t"));
         pProcess->mMemSize = atoi(strtok(NULL, "\t"));
-        pProcess->mRemainTime = pProcess->mRuntime;
+        //optional columns: the process needs resize_size bytes once it has run for resize_at ticks
+        char *pResizeAt = strtok(NULL, "\t");
+        char *pResizeSize = pResizeAt ? strtok(NULL, "\t") : NULL;
+        pProcess->mResizeAt = pResizeSize ? atoi(pResizeAt) : 0;
+        pProcess->mResizeSize = pResizeSize ? atoi(pResizeSize) : 0;
+        if (pProcess->mResizeAt >= pProcess->mRuntime || !pProcess->mResizeSize) //would never happen
+            pProcess->mResizeAt = 0;
         pProcess->mWaitTime = 0;
         runtime_sum += pProcess->mRuntime;
         runtime_squared_sum += pProcess->mRuntime * pProcess->mRuntime;
         count++;
-        PrintProcess(pProcess);
+        if (pProcess->mId > gMaxId)
+            gMaxId = pProcess->mId;
+        LOG(LOG_DEBUG, "PG: *** Read process %d, arrives %d, runs %d, priority %d, %d bytes\n", pProcess->mId,
+            pProcess->mArrivalTime, pProcess->mRuntime, pProcess->mPriority, pProcess->mMemSize);
         ProcEnqueue(gProcessQueue, pProcess);
     }
 
+    gProcessCount = count;
     double runtime_avg = (double) runtime_sum / count;
     double runtime_std = sqrt(
             (runtime_squared_sum - (2 * runtime_sum * runtime_avg) + (runtime_avg * runtime_avg * count)) / count);
-    printf("PG: *** Releasing file resources...\n");
+    LOG(LOG_INFO, "PG: *** Releasing file resources...\n");
     fclose(pFile);
     if (pLine)
         free(pLine);
-    printf("PG: *** Input file done successfully!\n");
-    printf("\nPG: *** Total runtime %d/s, %.2f/m, %.2f/h\n", runtime_sum, runtime_sum / 60.0, runtime_sum / (60.0 * 60.0));
-    printf("PG: *** Average runtime = %.2f, STD = %.2f\n", runtime_avg, runtime_std);
+    LOG(LOG_INFO, "PG: *** Input file done successfully!\n");
+    LOG(LOG_INFO, "\nPG: *** Total runtime %d/s, %.2f/m, %.2f/h\n", runtime_sum, runtime_sum / 60.0, runtime_sum / (60.0 * 60.0));
+    LOG(LOG_INFO, "PG: *** Average runtime = %.2f, STD = %.2f\n", runtime_avg, runtime_std);
+}
+
+/*
+** void SkipArrived()
+** drop the processes that had arrived when the checkpoint was taken and continue the clock from its time
+*/
+void SkipArrived() {
+    CheckpointHeader header;
+    unsigned char *pArrived = CheckpointReadArrived(gOptions.mpRestorePath, &header);
+    if (!pArrived || header.mTableSize != gMaxId + 1) {
+        LOG(LOG_ERROR, "PG: *** %s is not a checkpoint of this process file\n", gOptions.mpRestorePath);
+        exit(EXIT_FAILURE);
+    }
+    int count = gProcessCount, skipped = 0;
+    for (int i = 0; i < count; ++i) { //the queue keeps its order, the ones still to come go back to its end
+        Process *pProcess;
+        ProcDequeue(gProcessQueue, &pProcess);
+        if (pArrived[pProcess->mId]) {
+            free(pProcess);
+            skipped++;
+        } else {
+            ProcEnqueue(gProcessQueue, pProcess);
+        }
+    }
+    free(pArrived);
+    gClockStart = header.mClock;
+    LOG(LOG_INFO, "PG: *** Restoring at time %d, %d processes had arrived\n", gClockStart, skipped);
 }
 
 void InitIPC() {
@@ -165,20 +292,24 @@ void InitIPC() {
         perror("PG: *** IPC init failed");
         raise(SIGINT);
     }
-    printf("PG: *** IPC ready!\n");
+    LOG(LOG_INFO, "PG: *** IPC ready!\n");
 }
 
 void ExecuteClock() {
     gClockPid = fork();
     while (gClockPid == -1) {
         perror("PG: *** Error forking clock");
-        printf("PG: *** Trying again...\n");
+        LOG(LOG_ERROR, "PG: *** Trying again...\n");
         gClockPid = fork();
     }
     if (gClockPid == 0) {
-        printf("PG: *** Clock forking done!\n");
-        printf("PG: *** Executing clock...\n");
-        char *argv[] = {"clk.out", NULL};
+        LOG(LOG_INFO, "PG: *** Clock forking done!\n");
+        LOG(LOG_INFO, "PG: *** Executing clock...\n");
+        char tick[24];
+        snprintf(tick, sizeof(tick), "%ld", gOptions.mTickUs);
+        char start[24];
+        snprintf(start, sizeof(start), "%d", gClockStart);
+        char *argv[] = {"clk.out", tick, start, NULL};
         execv("clk.out", argv);
         perror("PG: *** Clock execution failed");
         exit(EXIT_FAILURE);
@@ -186,33 +317,229 @@ void ExecuteClock() {
 
 }
 
-void ExecuteScheduler() {
-    gSchedulerPid = fork();
-    while (gSchedulerPid == -1) {
+pid_t ExecuteScheduler(int node) { //node -1 starts the only scheduler, reading from the message queue
+    pid_t pid = fork();
+    while (pid == -1) {
         perror("PG: *** Error forking scheduler");
-        printf("PG: *** Trying again...\n");
-        gSchedulerPid = fork();
-    }
-    if (gSchedulerPid == 0) {
-        printf("PG: *** Scheduler forking done!\n");
-        printf("PG: *** Executing scheduler...\n");
-        char *argv[2];
-        argv[1] = NULL;
-        argv[0] = "srtn.out";
-        execv("srtn.out", argv);
+        LOG(LOG_ERROR, "PG: *** Trying again...\n");
+        pid = fork();
+    }
+    if (pid == 0) {
+        LOG(LOG_INFO, "PG: *** Scheduler forking done!\n");
+        LOG(LOG_INFO, "PG: *** Executing scheduler...\n");
+        //keep arrivals pending until the scheduler has installed its handler, the default action would kill it
+        sigset_t arrival_set;
+        sigemptyset(&arrival_set);
+        sigaddset(&arrival_set, SIGUSR1);
+        sigprocmask(SIG_BLOCK, &arrival_set, NULL);
+        gpArgv[0] = "srtn.out"; //the scheduler gets the same options we were started with
+        if (node < 0) {
+            execv("srtn.out", gpArgv);
+        } else { //a node has its socket at CLUSTER_SOCKET_FD and is told its index after the forwarded options
+            if (gNodeSocket != CLUSTER_SOCKET_FD) { //the coordinator's ends close on exec
+                dup2(gNodeSocket, CLUSTER_SOCKET_FD);
+                close(gNodeSocket);
+            } else {
+                fcntl(CLUSTER_SOCKET_FD, F_SETFD, 0);
+            }
+            int argc = 0;
+            while (gpArgv[argc])
+                argc++;
+            char **pArgv = calloc(argc + 2, sizeof(char *)), option[32];
+            snprintf(option, sizeof(option), "--node=%d", node);
+            memcpy(pArgv, gpArgv, argc * sizeof(char *));
+            pArgv[argc] = option;
+            execv("srtn.out", pArgv);
+        }
         perror("PG: *** Scheduler execution failed");
         exit(EXIT_FAILURE);
     }
+    return pid;
+}
+
+/*
+** void StartNodes()
+** connect to and start every scheduler of the cluster, then send each the table of all processes
+*/
+void StartNodes() {
+    Message table = {MSG_TABLE, 0, gMaxId}; //no count, a node does not know how many it gets until MSG_END
+    for (int i = 0; i < gOptions.mNodes; ++i) {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) == -1) {
+            perror("PG: *** Error connecting to a node");
+            raise(SIGINT);
+        }
+        gNodes[i].mSocket = sockets[0];
+        gNodeSocket = sockets[1];
+        gNodes[i].mPid = ExecuteScheduler(i);
+        close(sockets[1]);
+        gNodes[i].mBatch.mType = MSG_ARRIVALS;
+        if (ClusterSend(gNodes[i].mSocket, &table))
+            perror("PG: *** Error while sending the process table");
+    }
+    LOG(LOG_INFO, "PG: *** %d nodes started, sharding by %s\n", gOptions.mNodes, gpShardNames[gOptions.mShard]);
+}
+
+void ShardProcess(const Process *pProcess) { //pack an arriving process into the batch of the node picked for it
+    ClusterNode *pNode = &gNodes[ShardPick(gNodes, gOptions.mNodes, gOptions.mShard, pProcess)];
+    ProcessToRecord(pProcess, &pNode->mBatch.mRecords[pNode->mBatch.mCount++]);
+    pNode->mSentWork += pProcess->mRuntime;
+    pNode->mSentMem += pProcess->mMemSize;
+    pNode->mSent++;
+    pNode->mSignal = 1;
+    if (pNode->mBatch.mCount == ARRIVAL_BATCH) {
+        if (ClusterSend(pNode->mSocket, &pNode->mBatch))
+            perror("PG: *** Error while sending processes");
+        pNode->mBatch.mCount = 0;
+    }
 }
 
-void SendProcess(Process *pProcess) {
+void FlushNodes() { //send what is left of this tick's batches and wake the nodes that got processes
+    for (int i = 0; i < gOptions.mNodes; ++i) {
+        ClusterNode *pNode = &gNodes[i];
+        if (pNode->mBatch.mCount && ClusterSend(pNode->mSocket, &pNode->mBatch))
+            perror("PG: *** Error while sending processes");
+        pNode->mBatch.mCount = 0;
+        if (pNode->mSignal)
+            kill(pNode->mPid, SIGUSR1);
+        pNode->mSignal = 0;
+    }
+}
+
+void EndNodes() { //tell every node no process is left, an idle node ends its run on it
+    Message end = {MSG_END, 0};
+    for (int i = 0; i < gOptions.mNodes; ++i) {
+        if (ClusterSend(gNodes[i].mSocket, &end))
+            perror("PG: *** Error while ending a node");
+        kill(gNodes[i].mPid, SIGUSR1);
+    }
+}
+
+/*
+** void MergeEvents()
+** merge the Events.N.txt of every node into Events.txt in time order, every line names the node it happened on
+*/
+void MergeEvents() {
+    FILE *pFiles[MAX_NODES], *pOut = fopen("Events.txt", "w");
+    char lines[MAX_NODES][256], path[32];
+    int times[MAX_NODES];
+    for (int i = 0; i < gOptions.mNodes; ++i) {
+        snprintf(path, sizeof(path), "Events.%d.txt", i);
+        pFiles[i] = fopen(path, "r");
+        times[i] = pFiles[i] && fgets(lines[i], sizeof(lines[i]), pFiles[i]) &&
+                   sscanf(lines[i], "At time %d", &times[i]) == 1 ? times[i] : -1;
+    }
+    for (;;) {
+        int next = -1; //node with the earliest line, the lower node on equal times
+        for (int i = 0; i < gOptions.mNodes; ++i)
+            if (times[i] != -1 && (next == -1 || times[i] < times[next]))
+                next = i;
+        if (next == -1)
+            break;
+        lines[next][strcspn(lines[next], "\n")] = '\0';
+        fprintf(pOut, "%s on node %d\n", lines[next], next);
+        times[next] = fgets(lines[next], sizeof(lines[next]), pFiles[next]) &&
+                      sscanf(lines[next], "At time %d", &times[next]) == 1 ? times[next] : -1;
+    }
+    for (int i = 0; i < gOptions.mNodes; ++i)
+        if (pFiles[i])
+            fclose(pFiles[i]);
+    fclose(pOut);
+}
+
+/*
+** void MergeStats()
+** global Stats.txt from the summaries of the nodes: histograms are merged, so the percentiles are those of every
+** process of the cluster, and the cpu utilization is the busy share of all nodes over the span of the whole run
+*/
+void MergeStats() {
+    Histogram wait, ta, wta, dispatch;
+    HistogramInit(&wait, 1);
+    HistogramInit(&ta, 1);
+    HistogramInit(&wta, 1000);
+    HistogramInit(&dispatch, 1);
+    unsigned int finished = 0, runtime_sum = 0, waiting_sum = 0, failed = 0, start = UINT_MAX, end = 0;
+    unsigned int swap_outs = 0, swap_ins = 0, bytes_swapped = 0, swap_ticks = 0, switches = 0, preemptions = 0;
+    int peak_resident = 0;
+    double cpu_user = 0, cpu_system = 0;
+    long max_rss = 0;
+    for (int i = 0; i < gOptions.mNodes; ++i) {
+        const NodeSummary *pSummary = &gNodes[i].mSummary;
+        HistogramMerge(&wait, &pSummary->mWait);
+        HistogramMerge(&ta, &pSummary->mTa);
+        HistogramMerge(&wta, &pSummary->mWta);
+        HistogramMerge(&dispatch, &pSummary->mDispatch);
+        finished += pSummary->mFinished;
+        runtime_sum += pSummary->mRuntimeSum;
+        waiting_sum += pSummary->mWaitingSum;
+        failed += pSummary->mFailedAllocs;
+        swap_outs += pSummary->mSwapOuts;
+        swap_ins += pSummary->mSwapIns;
+        bytes_swapped += pSummary->mBytesSwapped;
+        swap_ticks += pSummary->mSwapTicks;
+        switches += pSummary->mContextSwitches;
+        preemptions += pSummary->mPreemptions;
+        if (pSummary->mFinished && pSummary->mStartTime < start) //a node that got nothing does not stretch the run
+            start = pSummary->mStartTime;
+        if (pSummary->mFinished && pSummary->mEndTime > end)
+            end = pSummary->mEndTime;
+        if (pSummary->mPeakResident > peak_resident)
+            peak_resident = pSummary->mPeakResident;
+        cpu_user += pSummary->mCpuUser;
+        cpu_system += pSummary->mCpuSystem;
+        if (pSummary->mMaxRss > max_rss)
+            max_rss = pSummary->mMaxRss;
+    }
+    unsigned int span = end > start ? end - start : 0;
+    FILE *pFile = fopen("Stats.txt", "w");
+    fprintf(pFile, "Avg Waiting = %.2f\n", finished ? (double) waiting_sum / finished : 0);
+    fprintf(pFile, "\nCPU utilization = %.2f\n", span ? runtime_sum * 100.0 / span / gOptions.mNodes : 0);
+    fprintf(pFile, "Avg WTA = %.2f\n", wta.mMean);
+    fprintf(pFile, "STD WTA = %.2f\n\n", HistogramStd(&wta));
+    PrintPercentiles(pFile, "Waiting", &wait, 0);
+    PrintPercentiles(pFile, "TA", &ta, 0);
+    PrintPercentiles(pFile, "WTA", &wta, 2);
+    PrintPercentiles(pFile, "Dispatch us", &dispatch, 0);
+    fprintf(pFile, "\n");
+    fprintf(pFile, "Peak resident processes = %d on one node\n", peak_resident);
+    fprintf(pFile, "Failed allocations = %u\n", failed);
+    fprintf(pFile, "Swap outs = %u, swap ins = %u, bytes swapped = %u, ticks charged = %u\n", swap_outs, swap_ins,
+            bytes_swapped, swap_ticks);
+    fprintf(pFile, "Scheduling policy = %s\n", gPolicies[gOptions.mPolicy].mpName);
+    fprintf(pFile, "Context switches = %u, preemptions = %u\n", switches, preemptions);
+    fprintf(pFile, "Scheduler cpu = %.3f s user, %.3f s system, peak RSS = %ld KB\n", cpu_user, cpu_system, max_rss);
+    fprintf(pFile, "Nodes = %d, sharding = %s\n", gOptions.mNodes, gpShardNames[gOptions.mShard]);
+    fprintf(pFile, "Finished processes = %u in %u ticks, throughput = %.3f per tick\n", finished, span,
+            span ? (double) finished / span : 0);
+    for (int i = 0; i < gOptions.mNodes; ++i) {
+        const NodeSummary *pSummary = &gNodes[i].mSummary;
+        unsigned int node_span = pSummary->mEndTime - pSummary->mStartTime;
+        fprintf(pFile, "Node %d: processes = %u, cpu utilization = %.2f, avg waiting = %.2f, failed allocations = %u, "
+                       "peak resident = %d\n", i, pSummary->mFinished,
+                pSummary->mFinished && node_span ? pSummary->mRuntimeSum * 100.0 / node_span : 0,
+                pSummary->mFinished ? (double) pSummary->mWaitingSum / pSummary->mFinished : 0,
+                pSummary->mFailedAllocs, pSummary->mPeakResident);
+    }
+    fclose(pFile);
+    LOG(LOG_INFO, "PG: *** Merged the results of %d nodes into Events.txt and Stats.txt\n", gOptions.mNodes);
+}
+
+void SendTable() {
     Message msg;
-    msg.mType = 10; //arbitrary value for mType
-    msg.mProcess = *pProcess;
-    printf("PG: *** Sending process with id %d to scheduler...\n", msg.mProcess.mId);
-    if (msgsnd(gMsgQueueId, (void *) &msg, sizeof(msg.mProcess), !IPC_NOWAIT) == -1) {
-        perror("PG: *** Error while sending process");
+    msg.mType = MSG_TABLE;
+    msg.mCount = gProcessCount;
+    msg.mMaxId = gMaxId;
+    if (msgsnd(gMsgQueueId, (void *) &msg, MessageSize(&msg), !IPC_NOWAIT) == -1)
+        perror("PG: *** Error while sending the process count");
+}
+
+void SendArrivals(Message *pMsg) { //send the packed records and start a new message
+    pMsg->mType = MSG_ARRIVALS;
+    LOG(LOG_DEBUG, "PG: *** Sending %d processes to scheduler...\n", pMsg->mCount);
+    if (msgsnd(gMsgQueueId, (void *) pMsg, MessageSize(pMsg), !IPC_NOWAIT) == -1) {
+        perror("PG: *** Error while sending processes");
     } else {
-        printf("PG: *** Process sent!\n");
+        LOG(LOG_DEBUG, "PG: *** Processes sent!\n");
     }
-}
\ No newline at end of file
+    pMsg->mCount = 0;
+}
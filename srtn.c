@@ -1,11 +1,37 @@
 #include "Headers/headers.h"
 #include "Headers/ProcessStruct.h"
 #include "Headers/ProcessHeap.h"
+#include "Headers/Policy.h"
 #include "Headers/MessageBuffer.h"
+#include "Headers/ProcessTable.h"
 #include "Headers/EventsQueue.h"
-#include "Headers/DoubleLinkedList.h"
 #include "Headers/ProcessQueue.h"
+#include "Headers/PidIndex.h"
+#include "Headers/WorkerPool.h"
+#include "Headers/Options.h"
+#include "Headers/Slab.h"
+#include "Headers/BuddyAllocator.h"
+#include "Headers/MemEngine.h"
+#include "Headers/MemPool.h"
+#include "Headers/Metrics.h"
+#include "Headers/Histogram.h"
+#include "Headers/Trace.h"
+#include "Headers/Checkpoint.h"
+#include "Headers/Cluster.h"
 #include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+//hot fields of a process, kept in the process table and reached through its id
+#define REMAIN(pProcess) TABLE_REMAIN(&gProcessTable, (pProcess)->mId)
+#define STATE(pProcess) TABLE_STATE(&gProcessTable, (pProcess)->mId)
+#define MEM_ADDR(pProcess) TABLE_MEM_ADDR(&gProcessTable, (pProcess)->mId)
+#define REAP_BATCH 64 //maximum number of finished children released together
+#define WORKER_POOL_SIZE 4 //number of process.out workers kept parked, the pool grows past this on demand
 
 void ProcessArrivalHandler(int);
 
@@ -13,316 +39,1610 @@ void InitIPC();
 
 void InitMemList();
 
+void InstallHandler(int, void (*)(int));
+
+void BlockHandlers(sigset_t *);
+
+void RestoreHandlers(const sigset_t *);
+
+void ReceiveTable();
+
 int ReceiveProcess();
 
+void AddArrival(const ArrivalRecord *);
+
+void PreemptIfDue();
+
+void WaitForEvent(const sigset_t *);
+
+void RequeueFailed();
+
+void ReplayEvent();
+
+void WaitForSwitch(const sigset_t *);
+
+bool ArrivalsPending();
+
+void ReportStatus();
+
+int LargestFreeBlock();
+
+int FreeBytes();
+
+FILE *OpenOutput(const char *);
+
+void CheckpointHandler(int);
+
+void CheckpointIfDue();
+
+void SaveCheckpoint(int);
+
+void RestoreCheckpointHeader();
+
+void RestoreCheckpoint();
+
+void StartWorker(unsigned int);
+
 void CleanResources();
 
 int ExecuteProcess();
 
 void ChildHandler(int);
 
+void ResizeHandler(int);
+
+void ArmResize();
+
+void SetResizeTimer(int);
+
+void ResizeProcessMem(Process *);
+
+void ReleaseFinished(Process **, int);
+
 void LogEvents(unsigned int, unsigned int);
 
 void AddEvent(enum EventType);
 
+Event *AddProcessEvent(enum EventType, Process *);
+
 int AllocateMem(int);
 
 void FreeMem(int, int);
 
-int IsEven(int);
+int AllocateProcessMem(Process *);
+
+bool ProcessMemMayFit(const Process *);
+
+BuddyAllocator *ProcessBuddy(const Process *);
+
+void FreeProcessMem(Process *);
+
+void FreeProcessMemBatch(Process **, int);
+
+void PublishMemory();
+
+int CompactMemory(Process *);
+
+bool HoldsMemory(const Process *);
+
+int CompactOn(BuddyAllocator *, Process **, int, int, int *);
+
+int CompareMemAlloc(const void *, const void *);
+
+void WaitTicks(int);
+
+int SwapPools(const Process *, int *);
+
+int SwapPoolOf(const Process *);
+
+int SwapVictims(const Process *, Process **);
+
+int SwapTarget(const Process *, Process **, int, const Process *);
+
+bool SwapMayFit(const Process *, const Process *);
+
+int SwapOutFor(Process *);
+
+int SwapIn(Process *);
+
+int CompareReadyKey(const void *, const void *);
 
 int gMsgQueueId = 0;
 Process *gpCurrentProcess = NULL;
-heap_t *gProcessHeap = NULL;
+ReadyQueue gReady; //processes waiting for the cpu, in the order of the scheduling policy
 short gSwitchContext = 0;
 event_queue gEventQueue = NULL;
-LIST gFreeMemList[8];
-int gFreeMem = 1024;
+const MemEngine *gpMemEngine = NULL; //engine managing the simulated memory
+BuddyAllocator *gpBuddy = NULL; //the library allocator if the engine is "buddy", lazy merging, resize and compaction need it
+MemPool gPools[MAX_POOLS]; //independent pools from --pools, each job's memory sits in one of them
+int gPoolCount = 0; //0 while the memory engine manages a single pool
+sigset_t gHandlerSignals; //signals whose handlers touch the scheduler state
 queue gTempQueue;
+PidIndex gPidIndex; //maps the pid of every live child to its process
+ProcessTable gProcessTable; //every process of the run, indexed by id
+WorkerPool gWorkerPool; //pre-spawned workers waiting for a job
+SlabCache gSlabCache; //size classes carved out of buddy blocks, only used with --slab
+int gResident = 0; //number of processes currently holding memory
+int gPeakResident = 0;
+unsigned int gFailedAllocs = 0;
+unsigned int gCompactions = 0;
+unsigned int gBytesMoved = 0;
+unsigned int gCompactTicks = 0; //clock ticks the cpu stayed idle moving memory
+unsigned int gResizes = 0;
+unsigned int gInPlaceResizes = 0; //resizes that kept their address
+unsigned int gFailedResizes = 0; //resizes that kept the old size because no block was free
+unsigned int gSwapOuts = 0;
+unsigned int gSwapIns = 0;
+unsigned int gBytesSwapped = 0; //both ways
+unsigned int gSwapTicks = 0; //clock ticks the cpu stayed idle swapping
+unsigned int gContextSwitches = 0; //processes started or resumed
+unsigned int gPreemptions = 0; //processes stopped before they finished
+unsigned int gSliceStart = 0; //ticks the running process had run when it was dispatched, its quantum counts from here
+Histogram gWaitHist; //per finished process, filled as FINISH events are added
+Histogram gTaHist;
+Histogram gWtaHist;
+Histogram gDispatchHist;
+unsigned int gStartTime = 0; //clock value the simulation started at, kept across a checkpoint
+short gCheckpointWanted = 0; //set by SIGUSR2, the snapshot is taken at the next wait
+int gNextCheckpoint = 0; //clock value the next periodic checkpoint is due at
+Checkpoint gRestore; //snapshot being restored, read in two steps around the memory setup
+int gExpected = 0; //processes announced by the table
+short gArrivalsEnded = 0; //a cluster node got MSG_END
+long gArrivedWork = 0; //runtime of every process received, reported to the coordinator of a cluster
+long gArrivedMem = 0;
+int gMaxBlock = 0; //largest block a process can ever get, larger ones are not worth swapping for
 
 int main(int argc, char *argv[]) {
-    printf("SRTN: *** Scheduler here\n");
-    initClk();
-    InitIPC();
-    //initialize processes heap
-    gProcessHeap = (heap_t *) calloc(1, sizeof(heap_t));
+    ParseOptions(argc, argv);
+    LogStart();
+    LOG(LOG_INFO, "SRTN: *** Scheduler here\n");
+    if (gOptions.mpReplayPath) { //no clock, no message queue and no children, everything comes from the trace
+        if (TraceOpen(TRACE_REPLAY, gOptions.mpReplayPath)) {
+            LOG(LOG_ERROR, "SRTN: *** %s is not a trace that can be replayed\n", gOptions.mpReplayPath);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        initClk();
+        InitIPC();
+        if (gOptions.mpRecordPath && TraceOpen(TRACE_RECORD, gOptions.mpRecordPath))
+            perror("SRTN: *** Error opening the trace, this run is not recorded");
+    }
+    ReceiveTable();
+    if (gOptions.mpRestorePath)
+        RestoreCheckpointHeader(); //the memory options of the snapshot replace ours before the memory is set up
+    ReadyInit(&gReady, &gPolicies[gOptions.mPolicy], gOptions.mAging, &gProcessTable);
     gTempQueue = NewProcQueue();
     gEventQueue = NewEventQueue();
+    HistogramInit(&gWaitHist, 1); //whole ticks
+    HistogramInit(&gTaHist, 1);
+    HistogramInit(&gWtaHist, 1000);
+    HistogramInit(&gDispatchHist, 1); //microseconds
     InitMemList();
+    gMaxBlock = LargestFreeBlock(); //nothing is allocated yet
+    if (MetricsCreate())
+        perror("SRTN: *** Error creating the metrics page, srtnstat will not see this run");
+    PublishMemory();
+    SlabInit(&gSlabCache, gpMemEngine->mPoolSize, AllocateMem, FreeMem, gpMemEngine->mpRound);
 
-    signal(SIGUSR1, ProcessArrivalHandler);
+    sigemptyset(&gHandlerSignals);
+    sigaddset(&gHandlerSignals, SIGUSR1);
+    sigaddset(&gHandlerSignals, SIGCHLD);
+    sigaddset(&gHandlerSignals, SIGALRM);
+    sigaddset(&gHandlerSignals, SIGUSR2);
+    InstallHandler(SIGUSR1, ProcessArrivalHandler);
+    InstallHandler(SIGCHLD, ChildHandler);
+    InstallHandler(SIGALRM, ResizeHandler);
+    InstallHandler(SIGUSR2, CheckpointHandler);
     signal(SIGINT, CleanResources);
-    signal(SIGCHLD, ChildHandler);
-
-    pause(); //wait for the first process to arrive
-    unsigned int start_time = getClk(); //store simulation start time
-    while ((gpCurrentProcess = HeapPop(gProcessHeap)) != NULL) {
-        if (ExecuteProcess() == -1) {//starts the process with the least remaining time and handles context switching
+    signal(SIGPIPE, SIG_IGN); //a parked worker that died shows up as EPIPE on dispatch instead of killing us
+    //handlers only run while we wait for them, so they never change the scheduler state halfway through a step and a
+    //replay can feed the recorded events at the same points
+    sigset_t wait_set;
+    BlockHandlers(&wait_set);
+    sigdelset(&wait_set, SIGUSR1); //process_generator starts us with arrivals blocked until the handler is in place
+    if (gTrace.mMode != TRACE_REPLAY)
+        WorkerPoolInit(&gWorkerPool, "process.out", WORKER_POOL_SIZE);
+    ReportStatus(); //a cluster node may get nothing for a while, the coordinator must know it is idle
+    if (gOptions.mpRestorePath) {
+        RestoreCheckpoint(); //starts the process that was running again, if one was
+        bool started = gProcessTable.mCount > 0; //a checkpoint can be taken before the first arrival
+        if (gpCurrentProcess)
+            WaitForSwitch(&wait_set);
+        while (!gpCurrentProcess && !ReadyLength(&gReady) && ArrivalsPending()) { //nothing was ready, wait for one
+            WaitForEvent(&wait_set);
+            CheckpointIfDue();
+        }
+        if (!started)
+            gStartTime = TraceClock();
+    } else {
+        if (gTrace.mMode != TRACE_REPLAY) //a replay has no clock and takes no checkpoints
+            gNextCheckpoint = getClk() + gOptions.mCheckpointEvery;
+        //wait for the first process to arrive, even if it was signalled before we got here
+        while (!ReadyLength(&gReady) && ArrivalsPending()) {
+            WaitForEvent(&wait_set);
+            if (!ReadyLength(&gReady)) //once one arrived the snapshot would need the start time set below
+                CheckpointIfDue();
+        }
+        gStartTime = TraceClock(); //store simulation start time
+        gNextCheckpoint = (int) gStartTime + gOptions.mCheckpointEvery;
+    }
+    while (true) {
+        gpCurrentProcess = ReadyPop(&gReady);
+        if (!gpCurrentProcess) { //nothing is ready, or nothing that is ready could get memory
+            if (!ArrivalsPending()) //whatever is left in the temp queue can never run
+                break;
+            //nothing runs, so nothing frees memory either, only an arrival changes what can be dispatched
+            unsigned int arrived = gProcessTable.mCount;
+            while (gProcessTable.mCount == arrived && ArrivalsPending()) {
+                WaitForEvent(&wait_set);
+                CheckpointIfDue(); //the failed processes are saved from the temp queue
+            }
+            RequeueFailed();
+            continue;
+        }
+        METRIC_SET(mReadyLength, ReadyLength(&gReady));
+        if (STATE(gpCurrentProcess) == FINISHED) //reaped while stopped, its memory and event were already handled
+            continue;
+        //toggle switch context off until a signal handler turns it on, before the dispatch: a handler may preempt the
+        //process as soon as it runs and its request must not be cleared afterwards
+        gSwitchContext = 0;
+        if (ExecuteProcess() == -1) {//starts the process the policy picked and handles context switching
             ProcEnqueue(gTempQueue, gpCurrentProcess); //if execution failed place this process in the temp queue
             continue;
         }
-        gSwitchContext = 0; //toggle switch context off until a signal handler turns it on
-        while (!ProcQueueEmpty(gTempQueue)) {//re-push all processes that failed to run in the main heap
-            Process *pProcess;
-            ProcDequeue(gTempQueue, &pProcess);
-            HeapPush(gProcessHeap, pProcess->mRemainTime, pProcess);
+        RequeueFailed();
+        //top the worker pool back up now that the job is running so spawning never delays a dispatch
+        if (gTrace.mMode != TRACE_REPLAY)
+            WorkerPoolRefill(&gWorkerPool);
+        WaitForSwitch(&wait_set);
+        while (!ReadyLength(&gReady) && ArrivalsPending()) { //idle until the next arrival, the run is not over
+            WaitForEvent(&wait_set);
+            CheckpointIfDue(); //an idle stretch can be longer than the checkpoint period
+        }
+    }
+    unsigned int end_time = TraceClock(); //store simulation end time
+    int unfinished = (int) ProcessTableUnfinished(&gProcessTable); //LogEvents frees the table
+    WorkerPoolDestroy(&gWorkerPool); //parked workers exit once their pipe is closed
+    LogEvents(gStartTime, end_time);
+    ReadyDestroy(&gReady);
+    TraceClose();
+    MetricsDestroy();
+    if (unfinished)
+        LOG(LOG_ERROR, "SRTN: *** %d processes did not finish\n", unfinished);
+    return unfinished ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void RequeueFailed() { //push the processes that failed to get memory back into the ready queue
+    while (!ProcQueueEmpty(gTempQueue)) {
+        Process *pProcess;
+        ProcDequeue(gTempQueue, &pProcess);
+        ReadyPush(&gReady, pProcess);
+    }
+}
+
+void WaitForEvent(const sigset_t *pWaitSet) {
+    if (gTrace.mMode == TRACE_REPLAY) {
+        ReplayEvent();
+        return;
+    }
+    //wake up every tick as well, a long job sends no signal in between and its quantum may be over
+    if (gOptions.mCheckpointEvery || gReady.mpPolicy->mSliced) {
+        struct timespec tick = {gOptions.mTickUs / 1000000, gOptions.mTickUs % 1000000 * 1000};
+        pselect(0, NULL, NULL, NULL, &tick, pWaitSet); //runs the pending handlers like sigsuspend
+    } else {
+        sigsuspend(pWaitSet); //every pending handler runs before it returns
+    }
+    if (gTrace.mMode == TRACE_RECORD)
+        fprintf(gTrace.mpFile, "wake\n"); //the events of this wait end here
+    ReportStatus();
+}
+
+bool ArrivalsPending() { //a process may still arrive
+    if (gOptions.mNode >= 0) //a cluster node only knows once the coordinator says so
+        return !gArrivalsEnded;
+    return gProcessTable.mCount < (unsigned int) gExpected;
+}
+
+void ReportStatus() { //a cluster node tells the coordinator how loaded it is after every wake up, it shards by that
+    if (gOptions.mNode < 0 || gArrivalsEnded) //no more sharding decisions once every process was sent
+        return;
+    static NodeReport report = {NODE_STATUS}; //only the status part is sent, the summary is not cleared every time
+    report.mStatus = (NodeStatus) {0};
+    report.mStatus.mWork = ProcessTableWaitingWork(&gProcessTable); //ready and stopped ones, with the time they had left
+    if (gpCurrentProcess && STATE(gpCurrentProcess) == RUNNING) {
+        int ran = getClk() - (int) (gpCurrentProcess->mArrivalTime + gpCurrentProcess->mWaitTime);
+        report.mStatus.mWork += ran < (int) gpCurrentProcess->mRuntime ? gpCurrentProcess->mRuntime - ran : 0;
+    }
+    report.mStatus.mArrivedWork = gArrivedWork;
+    report.mStatus.mArrivedMem = gArrivedMem;
+    report.mStatus.mLargestFree = LargestFreeBlock();
+    report.mStatus.mFreeBytes = FreeBytes();
+    ClusterReport(CLUSTER_SOCKET_FD, &report);
+}
+
+int LargestFreeBlock() { //largest block a process could get now, over all pools
+    if (!gPoolCount)
+        return gpMemEngine->mpLargestFree();
+    int largest = 0;
+    for (int i = 0; i < gPoolCount; ++i)
+        if (BuddyLargestFree(gPools[i].mpBuddy) > largest)
+            largest = BuddyLargestFree(gPools[i].mpBuddy);
+    return largest;
+}
+
+int FreeBytes() { //over all pools
+    if (!gPoolCount)
+        return gpMemEngine->mpFreeBytes();
+    int free_bytes = 0;
+    for (int i = 0; i < gPoolCount; ++i)
+        free_bytes += BuddyFreeBytes(gPools[i].mpBuddy);
+    return free_bytes;
+}
+
+void WaitForSwitch(const sigset_t *pWaitSet) { //sleep until a handler wants a context switch
+    while (!gSwitchContext) {
+        WaitForEvent(pWaitSet);
+        if (gReady.mpPolicy->mSliced) //no signal comes when the quantum is over
+            PreemptIfDue();
+        CheckpointIfDue(); //the handlers are done, every structure is consistent here
+    }
+}
+
+/*
+** void ReplayEvent()
+** replay: handle what the recorded run handled during one wait, the same way its signal handlers did
+*/
+void ReplayEvent() {
+    Process *finished[REAP_BATCH];
+    ArrivalRecord record;
+    unsigned int id;
+    int count;
+    for (;;) {
+        if (TraceIs("wake")) {
+            TraceAdvance();
+            return;
+        }
+        if (TraceIs("clock")) { //a read inside a handler, the resize one reads before deciding anything
+            TraceClock();
+        } else if (TraceIs("arrive")) {
+            count = atoi(gTrace.mLine + 7);
+            TraceAdvance();
+            for (int i = 0; i < count && !TraceReadArrival(&record); ++i)
+                AddArrival(&record);
+            PreemptIfDue();
+        } else if (TraceIs("exit")) {
+            count = atoi(gTrace.mLine + 5);
+            TraceAdvance();
+            int reaped = 0;
+            for (int i = 0; i < count && sscanf(gTrace.mLine, " %u", &id) == 1; ++i, TraceAdvance()) {
+                if (id < gProcessTable.mSize && reaped < REAP_BATCH &&
+                    PidIndexRemove(&gPidIndex, gProcessTable.mpProcesses[id].mPid))
+                    finished[reaped++] = &gProcessTable.mpProcesses[id];
+                else
+                    gTrace.mDivergences++; //not running here
+            }
+            ReleaseFinished(finished, reaped);
+        } else if (TraceIs("resize") && sscanf(gTrace.mLine, "resize %u", &id) == 1) {
+            TraceAdvance();
+            if (gpCurrentProcess && gpCurrentProcess->mId == id && STATE(gpCurrentProcess) == RUNNING)
+                ResizeProcessMem(gpCurrentProcess);
+            else
+                gTrace.mDivergences++;
+        } else if (!gTrace.mLine[0] || TraceIs("end")) {
+            LOG(LOG_ERROR, "SRTN: *** The trace ended while the scheduler still waits, %lu divergences\n",
+                gTrace.mDivergences);
+            MetricsDestroy(); //a replay owns nothing else outside this process
+            exit(EXIT_FAILURE);
+        } else { //the recorded run did something this one did not
+            gTrace.mDivergences++;
+            TraceAdvance();
         }
-        while (!gSwitchContext)
-            pause(); //pause to avoid busy waiting and only wakeup to handle signals
     }
-    unsigned int end_time = getClk(); //store simulation end time
-    LogEvents(start_time, end_time);
 }
 
 void ProcessArrivalHandler(int signum) {
     //keep looping as long as a process was received in the current iteration
     while (!ReceiveProcess());
+    TraceArrivals();
+    PreemptIfDue();
+}
 
-    if (!gpCurrentProcess) //if there's no process currently running no extra checking is needed
+void PreemptIfDue() { //stop the running process if the policy gives the cpu to the first ready one
+    //nothing to preempt if no process is running, including one that just finished and one that failed to start
+    //for lack of memory, which has no pid yet: kill(0) would stop the whole process group. A cluster node is also
+    //woken up by MSG_END, which brings no process
+    if (!gpCurrentProcess || STATE(gpCurrentProcess) != RUNNING || !ReadyLength(&gReady))
+        return;
+    const Policy *pPolicy = gReady.mpPolicy;
+    if (!pPolicy->mSliced && !pPolicy->mpPreempts) //only the end of the job switches
         return;
 
     //current runtime of a process = current time - (arrival time of process + total waiting time of the process)
     //then subtract this quantity from total runtime to get remaining runtime
-    gpCurrentProcess->mRemainTime =
-            gpCurrentProcess->mRuntime - (getClk() - (gpCurrentProcess->mArrivalTime + gpCurrentProcess->mWaitTime));
+    int now = TraceClock();
+    int remain = (int) gpCurrentProcess->mRuntime -
+                 (now - (int) (gpCurrentProcess->mArrivalTime + gpCurrentProcess->mWaitTime));
+    if (remain <= 0) //it is done, its SIGCHLD was just not handled yet, stopping it now would log it with nothing left
+        return;
+    REMAIN(gpCurrentProcess) = (unsigned int) remain;
 
-    Process *pNewProcess = HeapPeek(gProcessHeap);
-    if (pNewProcess->mRuntime < gpCurrentProcess->mRemainTime) { //if a new process has a shorter runtime
-        if (pNewProcess->mMemAlloc > gFreeMem) //no memory available for this process so no context switching
-            return;
+    Process *pNext = ReadyPeek(&gReady);
+    int slice = (int) (gpCurrentProcess->mRuntime - REMAIN(gpCurrentProcess) - gSliceStart); //ran since dispatch
+    bool expired = pPolicy->mSliced && slice >= gOptions.mQuantum;
+    if (!expired && !(pPolicy->mpPreempts &&
+                      pPolicy->mpPreempts(&gProcessTable, pNext->mId, gpCurrentProcess->mId, now, gReady.mAging)))
+        return;
+    //no memory available for the next process, even after swapping out the stopped ones, so no context switching.
+    //a stopped one that kept its memory needs none
+    if ((STATE(pNext) == READY || pNext->mSwapped) && !ProcessMemMayFit(pNext) &&
+        !SwapMayFit(pNext, gpCurrentProcess))
+        return;
 
-        if (kill(gpCurrentProcess->mPid, SIGTSTP) == -1) //stop current process
-            perror("RR: *** Error stopping process");
+    if (gTrace.mMode != TRACE_REPLAY && kill(gpCurrentProcess->mPid, SIGTSTP) == -1) //stop current process
+        perror("RR: *** Error stopping process");
 
-        gpCurrentProcess->mLastStop = getClk(); //store the stop time of the current process
-        gSwitchContext = 1; //toggle switch context on so main loop can execute a new process
-        HeapPush(gProcessHeap, gpCurrentProcess->mRemainTime, gpCurrentProcess); //push current process back into heap
-        AddEvent(STOP);
-    }
+    gpCurrentProcess->mLastStop = TraceClock(); //store the stop time of the current process
+    STATE(gpCurrentProcess) = STOPPED;
+    SetResizeTimer(0); //a pending resize waits until the process runs again
+    gSwitchContext = 1; //toggle switch context on so main loop can execute a new process
+    gPreemptions++;
+    ReadyPush(&gReady, gpCurrentProcess); //push current process back into the ready queue
+    METRIC_SET(mReadyLength, ReadyLength(&gReady));
+    METRIC_SET(mRunningId, 0);
+    AddEvent(STOP);
 }
 
 void InitIPC() {
+    if (gOptions.mNode >= 0) { //messages come from the coordinator's socket instead of the queue
+        if (fcntl(CLUSTER_SOCKET_FD, F_SETFD, FD_CLOEXEC) == -1) { //workers must not keep it open
+            perror("SRTN: *** Node has no socket to the coordinator");
+            raise(SIGINT);
+        }
+        gMetricsKey = METRICS_NODE_KEY(gOptions.mNode);
+        LOG(LOG_INFO, "SRTN: *** Scheduler of node %d connected\n", gOptions.mNode);
+        return;
+    }
     key_t key = ftok(gFtokFile, gFtokCode); //same parameters used in process_generator so we attach to same queue
     gMsgQueueId = msgget(key, 0);
     if (gMsgQueueId == -1) {
         perror("SRTN: *** Scheduler IPC init failed");
         raise(SIGINT);
     }
-    printf("SRTN: *** Scheduler IPC ready!\n");
+    LOG(LOG_INFO, "SRTN: *** Scheduler IPC ready!\n");
 
 }
 
+void ReceiveTable() { //wait for the number of processes and size the process table for them
+    Message msg;
+    if (gTrace.mMode == TRACE_REPLAY) {
+        if (sscanf(gTrace.mLine, "table %d %u", &msg.mCount, &msg.mMaxId) != 2) {
+            LOG(LOG_ERROR, "SRTN: *** The trace does not start with the process table\n");
+            exit(EXIT_FAILURE);
+        }
+        TraceAdvance();
+    }
+    if (gOptions.mNode >= 0 && (ClusterReceive(CLUSTER_SOCKET_FD, &msg, 0) == -1 || msg.mType != MSG_TABLE)) {
+        perror("SRTN: *** Error receiving the process table from the coordinator");
+        raise(SIGINT);
+    }
+    while (gTrace.mMode != TRACE_REPLAY && gOptions.mNode < 0 &&
+           msgrcv(gMsgQueueId, (void *) &msg, sizeof(msg) - sizeof(long), MSG_TABLE, 0) == -1) {
+        if (errno == EINTR)
+            continue;
+        perror("SRTN: *** Error receiving the process count");
+        raise(SIGINT);
+    }
+    TraceTable(msg.mCount, msg.mMaxId);
+    if (ProcessTableInit(&gProcessTable, msg.mMaxId)) {
+        perror("SRTN: *** Error creating the process table");
+        raise(SIGINT);
+    }
+    gExpected = msg.mCount;
+    if (gOptions.mNode >= 0)
+        LOG(LOG_INFO, "SRTN: *** Node %d expecting some of %d processes\n", gOptions.mNode, msg.mCount);
+    else
+        LOG(LOG_INFO, "SRTN: *** Expecting %d processes\n", msg.mCount);
+}
+
 int ReceiveProcess() {
     Message msg;
     //receive a message but do not wait, if not found return immediately
-    while (msgrcv(gMsgQueueId, (void *) &msg, sizeof(msg.mProcess), 0, IPC_NOWAIT) == -1) {
-        perror("SRTN: *** Error in receive");
+    if (gOptions.mNode >= 0) {
+        if (ClusterReceive(CLUSTER_SOCKET_FD, &msg, MSG_DONTWAIT) == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) { //the coordinator is gone, nothing else will arrive
+                perror("SRTN: *** Error in receive");
+                gArrivalsEnded = 1;
+            }
+            return -1;
+        }
+        if (msg.mType == MSG_END) {
+            LOG(LOG_DEBUG, "SRTN: *** Node %d got its last process\n", gOptions.mNode);
+            gArrivalsEnded = 1;
+            return 0;
+        }
+    }
+    while (gOptions.mNode < 0 &&
+           msgrcv(gMsgQueueId, (void *) &msg, sizeof(msg) - sizeof(long), MSG_ARRIVALS, IPC_NOWAIT) == -1) {
+        if (errno == ENOMSG) //drained every message of this tick, the usual way out
+            LOG(LOG_DEBUG, "SRTN: *** No more arrivals queued\n");
+        else
+            perror("SRTN: *** Error in receive");
         return -1;
     }
 
     //below is executed if a message was retrieved from the message queue
-    printf("SRTN: *** Received by scheduler\n");
-    Process *pProcess = malloc(sizeof(Process)); //allocate memory for the received process
-
-    while (!pProcess) {
-        perror("SRTN: *** Malloc failed");
-        printf("SRTN: *** Trying again");
-        pProcess = malloc(sizeof(Process));
-    }
-    *pProcess = msg.mProcess; //store the process received in the allocated space
-    pProcess->mMemAlloc = pow(2, ceil(log2(pProcess->mMemSize))); //approximate to the first power of 2
-    //push the process pointer into the process heap, and use the process runtime as the value to sort the heap with
-    HeapPush(gProcessHeap, pProcess->mRemainTime, pProcess);
+    LOG(LOG_DEBUG, "SRTN: *** Received %d processes by scheduler\n", msg.mCount);
+    for (int i = 0; i < msg.mCount; ++i)
+        AddArrival(&msg.mRecords[i]);
 
     return 0;
 }
 
+void AddArrival(const ArrivalRecord *pRecord) { //make one arrived process ready
+    TraceArrival(pRecord);
+    METRIC_ADD(mArrivals, 1);
+    Process *pProcess = ProcessTableAdd(&gProcessTable, pRecord); //the slot of this id in the table
+    if (!pProcess) {
+        LOG(LOG_ERROR, "SRTN: *** Dropped process %d, its id was not announced or arrived twice\n", pRecord->mId);
+        return;
+    }
+    gArrivedWork += pProcess->mRuntime;
+    gArrivedMem += pProcess->mMemSize;
+    if (gOptions.mSlab)
+        pProcess->mMemAlloc = SlabRound(&gSlabCache, pProcess->mMemSize); //tightest size class or buddy block
+    else
+        pProcess->mMemAlloc = gpMemEngine->mpRound(pProcess->mMemSize); //approximate to the engine's block size
+    if ((int) pProcess->mMemAlloc > gMaxBlock) { //it would wait for memory forever, and the run with it
+        LOG(LOG_ERROR, "SRTN: *** Rejected process %u, it needs %u bytes and the largest block is %d\n",
+            pProcess->mId, pProcess->mMemAlloc, gMaxBlock);
+        REMAIN(pProcess) = 0; //stays ready without being queued, the run ends with it unfinished
+        return;
+    }
+    STATE(pProcess) = READY;
+    ReadyPush(&gReady, pProcess); //where the policy puts it
+    METRIC_SET(mReadyLength, ReadyLength(&gReady));
+}
+
 void CleanResources() {
-    printf("SRTN: *** Cleaning scheduler resources\n");
-    Process *pProcess = NULL;
-    while ((pProcess = HeapPop(gProcessHeap)) != NULL) //while processes heap is not empty
-        free(pProcess); //free memory allocated by this process
+    LOG(LOG_INFO, "SRTN: *** Cleaning scheduler resources\n");
+    WorkerPoolDestroy(&gWorkerPool);
+    TraceClose();
+    ProcessTableDestroy(&gProcessTable); //processes live in the table, not in the heap
+    MetricsDestroy();
 
     Event *pEvent = NULL;
     while (EventQueueDequeue(gEventQueue, &pEvent)) //while event queue is not empty
         free(pEvent); //free memory allocated by the event
-    printf("SRTN: *** Scheduler clean!\n");
+    LOG(LOG_INFO, "SRTN: *** Scheduler clean!\n");
     exit(EXIT_SUCCESS);
 }
 
 int ExecuteProcess() {
-    if (gpCurrentProcess->mRuntime == gpCurrentProcess->mRemainTime) { //if this process never ran before
-        gpCurrentProcess->mMemAddr = AllocateMem(gpCurrentProcess->mMemAlloc); //allocate memory for this process
-        if (gpCurrentProcess->mMemAddr == -1) //if allocation failed
+    if (STATE(gpCurrentProcess) == READY) { //if this process never ran before
+        struct timespec dispatch_start, dispatch_end;
+        clock_gettime(CLOCK_MONOTONIC, &dispatch_start);
+        MEM_ADDR(gpCurrentProcess) = AllocateProcessMem(gpCurrentProcess); //allocate memory for this process
+        if (MEM_ADDR(gpCurrentProcess) == -1 && gOptions.mCompactCost > 0) //enough memory may be free but scattered
+            MEM_ADDR(gpCurrentProcess) = CompactMemory(gpCurrentProcess);
+        if (MEM_ADDR(gpCurrentProcess) == -1) //stopped processes that run after this one give up their memory
+            MEM_ADDR(gpCurrentProcess) = SwapOutFor(gpCurrentProcess);
+        if (MEM_ADDR(gpCurrentProcess) == -1) //if allocation failed
             return -1;
 
-        gpCurrentProcess->mPid = fork(); //fork a new child and store its pid in the process struct
-        while (gpCurrentProcess->mPid == -1) { //if forking fails
-            perror("SRTN: *** Error forking process");
-            printf("SRTN: *** Trying again...\n");
-            gpCurrentProcess->mPid = fork();
-        }
-        if (!gpCurrentProcess->mPid) { //if child then execute the process
-            char buffer[10]; //buffer to convert runtime from int to string
-            sprintf(buffer, "%d", gpCurrentProcess->mRuntime);
-            char *argv[] = {"process.out", buffer, NULL};
-            execv("process.out", argv);
-            perror("SRTN: *** Process execution failed");
-            exit(EXIT_FAILURE);
-        }
+        StartWorker(gpCurrentProcess->mRuntime);
+        STATE(gpCurrentProcess) = RUNNING;
+        clock_gettime(CLOCK_MONOTONIC, &dispatch_end);
+        gpCurrentProcess->mDispatchUs = (dispatch_end.tv_sec - dispatch_start.tv_sec) * 1000000 +
+                                        (dispatch_end.tv_nsec - dispatch_start.tv_nsec) / 1000;
         AddEvent(START);
-        gpCurrentProcess->mWaitTime = getClk() - gpCurrentProcess->mArrivalTime;
+        gpCurrentProcess->mWaitTime = TraceClock() - gpCurrentProcess->mArrivalTime;
+        ArmResize();
     } else { //this process was stopped and now we need to resume it
-        if (kill(gpCurrentProcess->mPid, SIGCONT) == -1) { //continue process
-            printf("SRTN: *** Error resuming process %d", gpCurrentProcess->mId);
+        if (gpCurrentProcess->mSwapped && SwapIn(gpCurrentProcess) == -1) //no room to bring its memory back yet
+            return -1;
+        if (!gpCurrentProcess->mPid) { //restored from a checkpoint, the worker it ran on is gone with that run
+            StartWorker(REMAIN(gpCurrentProcess));
+        } else if (gTrace.mMode != TRACE_REPLAY && kill(gpCurrentProcess->mPid, SIGCONT) == -1) { //continue process
+            LOG(LOG_ERROR, "SRTN: *** Error resuming process %d", gpCurrentProcess->mId);
             perror(NULL);
             return -1;
         }
-        gpCurrentProcess->mWaitTime += getClk() - gpCurrentProcess->mLastStop;  //update the waiting time of the process
+        gpCurrentProcess->mWaitTime += TraceClock() - gpCurrentProcess->mLastStop;  //update the waiting time of the process
+        STATE(gpCurrentProcess) = RUNNING;
         AddEvent(CONT);
+        ArmResize();
     }
+    METRIC_SET(mRunningId, (int) gpCurrentProcess->mId);
+    METRIC_SET(mRunningRemain, (int) REMAIN(gpCurrentProcess));
+    METRIC_ADD(mContextSwitches, 1);
+    gContextSwitches++;
+    gSliceStart = gpCurrentProcess->mRuntime - REMAIN(gpCurrentProcess);
     return 0;
 };
 
+void StartWorker(unsigned int runtime) { //hand gpCurrentProcess to a parked worker that runs it for runtime ticks
+    //block SIGCHLD until the pid is indexed, otherwise a child that exits immediately could not be matched
+    sigset_t old_set;
+    BlockHandlers(&old_set);
+    WorkerJob job = {gpCurrentProcess->mId, runtime, gOptions.mClockWorkers};
+    //hand the job to a parked worker and store its pid in the process struct, a replay takes the recorded one
+    if (gTrace.mMode == TRACE_REPLAY)
+        gpCurrentProcess->mPid = TraceReadPid(gpCurrentProcess);
+    while (gTrace.mMode != TRACE_REPLAY && (gpCurrentProcess->mPid = WorkerPoolDispatch(&gWorkerPool, &job)) == -1) {
+        LOG(LOG_ERROR, "SRTN: *** Error starting process %d, trying again...\n", gpCurrentProcess->mId);
+        sleep(1);
+    }
+    TracePid(gpCurrentProcess);
+    PidIndexInsert(&gPidIndex, gpCurrentProcess->mPid, gpCurrentProcess);
+    if (gPoolCount && gOptions.mPlacement == PLACE_CPU_AFFINE && gTrace.mMode != TRACE_REPLAY)
+        MemPoolPin(&gPools[gpCurrentProcess->mMemPool], gpCurrentProcess->mPid);
+    RestoreHandlers(&old_set);
+}
+
+void CheckpointHandler(int signum) {
+    gCheckpointWanted = 1;
+}
+
+void CheckpointIfDue() { //take the snapshot SIGUSR2 asked for or the periodic one
+    if (gTrace.mMode == TRACE_REPLAY) //a replay has no clock to resume with
+        return;
+    int now = getClk(); //not traced, checkpoints do not change what the scheduler does
+    if (!gCheckpointWanted && !(gOptions.mCheckpointEvery && now >= gNextCheckpoint))
+        return;
+    gCheckpointWanted = 0;
+    gNextCheckpoint = now + gOptions.mCheckpointEvery;
+    SaveCheckpoint(now);
+}
+
+/*
+** void SaveCheckpoint(int now)
+** write the scheduler, memory and arrival state to the checkpoint file, RestoreCheckpoint reads it in the same order
+** the running process is saved with the time it has left now, pids are not saved since the workers do not survive
+*/
+void SaveCheckpoint(int now) {
+    Checkpoint checkpoint;
+    CheckpointHeader header = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION, now, gStartTime, gProcessTable.mSize};
+    if (CheckpointBegin(&checkpoint, gOptions.mpCheckpointPath, &header, gProcessTable.mpArrived)) {
+        perror("SRTN: *** Error creating the checkpoint");
+        return;
+    }
+    //the memory options, the allocator state below only makes sense with them
+    char variant[32] = {0};
+    strncpy(variant, gOptions.mpMemVariant, sizeof(variant) - 1);
+    int memory[] = {gOptions.mSlab, gOptions.mLazyBuddy, gPoolCount};
+    CheckpointWrite(&checkpoint, variant, sizeof(variant));
+    CheckpointWrite(&checkpoint, memory, sizeof(memory));
+    CheckpointWrite(&checkpoint, gOptions.mPoolSizes, sizeof(gOptions.mPoolSizes));
+    CheckpointWrite(&checkpoint, &gOptions.mSwapCost, sizeof(double)); //swapped out processes need it to come back
+
+    CheckpointWrite(&checkpoint, &gProcessTable.mCount, sizeof(unsigned int));
+    CheckpointWrite(&checkpoint, gProcessTable.mpProcesses, gProcessTable.mSize * sizeof(Process));
+    CheckpointWrite(&checkpoint, gProcessTable.mpRemain, gProcessTable.mSize * sizeof(unsigned int));
+    CheckpointWrite(&checkpoint, gProcessTable.mpState, gProcessTable.mSize * sizeof(unsigned char));
+    CheckpointWrite(&checkpoint, gProcessTable.mpMemAddr, gProcessTable.mSize * sizeof(int));
+    int running = -1;
+    unsigned int remain = 0;
+    if (gpCurrentProcess && STATE(gpCurrentProcess) == RUNNING) {
+        running = (int) gpCurrentProcess->mId;
+        int ran = now - (int) (gpCurrentProcess->mArrivalTime + gpCurrentProcess->mWaitTime);
+        remain = ran < (int) gpCurrentProcess->mRuntime ? gpCurrentProcess->mRuntime - ran : 1;
+    }
+    CheckpointWrite(&checkpoint, &running, sizeof(int));
+    CheckpointWrite(&checkpoint, &remain, sizeof(unsigned int));
+    int count = ReadyLength(&gReady);
+    CheckpointWrite(&checkpoint, &count, sizeof(int));
+    for (int i = 0; i < count; ++i) //pushed again in this order, ties pop in the same order
+        CheckpointWrite(&checkpoint, &ReadyAt(&gReady, i)->mId, sizeof(unsigned int));
+    count = 0;
+    for (node pNode = HEAD(gTempQueue); pNode; pNode = pNode->next)
+        count++;
+    CheckpointWrite(&checkpoint, &count, sizeof(int));
+    for (node pNode = HEAD(gTempQueue); pNode; pNode = pNode->next)
+        CheckpointWrite(&checkpoint, &pNode->val->mId, sizeof(unsigned int));
+    count = 0;
+    for (e_node pNode = HEAD_E(gEventQueue); pNode; pNode = pNode->next)
+        count++;
+    CheckpointWrite(&checkpoint, &count, sizeof(int));
+    for (e_node pNode = HEAD_E(gEventQueue); pNode; pNode = pNode->next) {
+        Event event = *pNode->val;
+        event.mpProcess = NULL; //saved as the id in front of it
+        CheckpointWrite(&checkpoint, &pNode->val->mpProcess->mId, sizeof(unsigned int));
+        CheckpointWrite(&checkpoint, &event, sizeof(Event));
+    }
+
+    unsigned int counters[] = {gResident, gPeakResident, gFailedAllocs, gCompactions, gBytesMoved, gCompactTicks,
+                               gResizes, gInPlaceResizes, gFailedResizes, gSwapOuts, gSwapIns, gBytesSwapped,
+                               gSwapTicks, gContextSwitches, gPreemptions};
+    CheckpointWrite(&checkpoint, counters, sizeof(counters));
+    CheckpointWriteHistogram(&checkpoint, &gWaitHist);
+    CheckpointWriteHistogram(&checkpoint, &gTaHist);
+    CheckpointWriteHistogram(&checkpoint, &gWtaHist);
+    CheckpointWriteHistogram(&checkpoint, &gDispatchHist);
+    MetricsPage metrics = {0}; //the totals of the run, the live fields are set again as the restored run goes
+    if (gpMetrics)
+        metrics = *gpMetrics;
+    CheckpointWrite(&checkpoint, &metrics.mArrivals, sizeof(MetricsPage) - offsetof(MetricsPage, mArrivals));
+
+    if (gpMemEngine->mpSave(checkpoint.mpFile) || SlabSave(&gSlabCache, checkpoint.mpFile) ||
+        MemPoolsSave(gPools, gPoolCount, checkpoint.mpFile))
+        checkpoint.mFailed = 1;
+    if (CheckpointCommit(&checkpoint, gOptions.mpCheckpointPath))
+        perror("SRTN: *** Error writing the checkpoint, the previous one is kept");
+    else
+        LOG(LOG_INFO, "SRTN: *** Checkpoint at time %d written to %s\n", now, gOptions.mpCheckpointPath);
+}
+
+void RestoreFailed(const char *pWhat) { //a snapshot that does not fit this run cannot be resumed
+    LOG(LOG_ERROR, "SRTN: *** Cannot restore %s: %s\n", gOptions.mpRestorePath, pWhat);
+    MetricsDestroy();
+    exit(EXIT_FAILURE);
+}
+
+/*
+** void RestoreCheckpointHeader()
+** first part of a restore, before the memory is set up: arrived flags and memory options of the snapshot
+*/
+void RestoreCheckpointHeader() {
+    CheckpointHeader header;
+    if (gTrace.mMode != TRACE_OFF) //neither the recording nor the replay would have the state before the snapshot
+        RestoreFailed("a restored run can neither be recorded nor replayed");
+    if (CheckpointOpen(&gRestore, gOptions.mpRestorePath, &header))
+        RestoreFailed("not a checkpoint of this version");
+    if (header.mTableSize != gProcessTable.mSize)
+        RestoreFailed("it was taken of another process file");
+    gStartTime = header.mStartTime;
+    gNextCheckpoint = header.mClock + gOptions.mCheckpointEvery;
+    CheckpointRead(&gRestore, gProcessTable.mpArrived, header.mTableSize);
+    static char variant[32]; //gOptions keeps pointing at it
+    int memory[3];
+    CheckpointRead(&gRestore, variant, sizeof(variant));
+    CheckpointRead(&gRestore, memory, sizeof(memory));
+    CheckpointRead(&gRestore, gOptions.mPoolSizes, sizeof(gOptions.mPoolSizes));
+    CheckpointRead(&gRestore, &gOptions.mSwapCost, sizeof(double));
+    variant[sizeof(variant) - 1] = '\0';
+    if (gRestore.mFailed || !FindMemEngine(variant) || memory[2] < 0 || memory[2] > MAX_POOLS)
+        RestoreFailed("the memory options are damaged");
+    gOptions.mpMemVariant = variant;
+    gOptions.mSlab = memory[0];
+    gOptions.mLazyBuddy = memory[1];
+    gOptions.mPoolCount = memory[2];
+    LOG(LOG_INFO, "SRTN: *** Restoring the run at time %d from %s\n", header.mClock, gOptions.mpRestorePath);
+}
+
+Process *RestoredProcess(unsigned int id) { //process of an id read from the snapshot, NULL if it is out of range
+    if (id >= gProcessTable.mSize) {
+        gRestore.mFailed = 1;
+        return NULL;
+    }
+    return &gProcessTable.mpProcesses[id];
+}
+
+/*
+** void RestoreCheckpoint()
+** second part of a restore, once the memory is set up: everything SaveCheckpoint wrote after the memory options
+** the process that was running starts again on a new worker, stopped ones get one when they are resumed
+*/
+void RestoreCheckpoint() {
+    unsigned int id = 0;
+    CheckpointRead(&gRestore, &gProcessTable.mCount, sizeof(unsigned int));
+    CheckpointRead(&gRestore, gProcessTable.mpProcesses, gProcessTable.mSize * sizeof(Process));
+    CheckpointRead(&gRestore, gProcessTable.mpRemain, gProcessTable.mSize * sizeof(unsigned int));
+    CheckpointRead(&gRestore, gProcessTable.mpState, gProcessTable.mSize * sizeof(unsigned char));
+    CheckpointRead(&gRestore, gProcessTable.mpMemAddr, gProcessTable.mSize * sizeof(int));
+    for (unsigned int i = 0; i < gProcessTable.mSize; ++i)
+        gProcessTable.mpProcesses[i].mPid = 0; //no worker runs it yet
+    int running, len = 0, count = 0;
+    unsigned int remain;
+    CheckpointRead(&gRestore, &running, sizeof(int));
+    CheckpointRead(&gRestore, &remain, sizeof(unsigned int));
+    CheckpointRead(&gRestore, &len, sizeof(int));
+    if (len < 0 || len > (int) gProcessTable.mSize)
+        RestoreFailed("the ready processes are damaged");
+    for (int i = 0; i < len && !gRestore.mFailed; ++i) { //keyed by the policy of this run, it may be another one
+        CheckpointRead(&gRestore, &id, sizeof(unsigned int));
+        Process *pProcess = RestoredProcess(id);
+        if (pProcess)
+            ReadyPush(&gReady, pProcess);
+    }
+    CheckpointRead(&gRestore, &count, sizeof(int));
+    for (int i = 0; i < count && !gRestore.mFailed; ++i) {
+        CheckpointRead(&gRestore, &id, sizeof(unsigned int));
+        Process *pProcess = RestoredProcess(id);
+        if (pProcess)
+            ProcEnqueue(gTempQueue, pProcess);
+    }
+    CheckpointRead(&gRestore, &count, sizeof(int));
+    for (int i = 0; i < count && !gRestore.mFailed; ++i) {
+        Event *pEvent = malloc(sizeof(Event));
+        while (!pEvent) {
+            perror("SRTN: *** Malloc failed");
+            pEvent = malloc(sizeof(Event));
+        }
+        CheckpointRead(&gRestore, &id, sizeof(unsigned int));
+        CheckpointRead(&gRestore, pEvent, sizeof(Event));
+        pEvent->mpProcess = RestoredProcess(id);
+        EventQueueEnqueue(gEventQueue, pEvent);
+    }
+
+    unsigned int counters[15];
+    CheckpointRead(&gRestore, counters, sizeof(counters));
+    gResident = (int) counters[0];
+    gPeakResident = (int) counters[1];
+    gFailedAllocs = counters[2];
+    gCompactions = counters[3];
+    gBytesMoved = counters[4];
+    gCompactTicks = counters[5];
+    gResizes = counters[6];
+    gInPlaceResizes = counters[7];
+    gFailedResizes = counters[8];
+    gSwapOuts = counters[9];
+    gSwapIns = counters[10];
+    gBytesSwapped = counters[11];
+    gSwapTicks = counters[12];
+    gContextSwitches = counters[13];
+    gPreemptions = counters[14];
+    CheckpointReadHistogram(&gRestore, &gWaitHist);
+    CheckpointReadHistogram(&gRestore, &gTaHist);
+    CheckpointReadHistogram(&gRestore, &gWtaHist);
+    CheckpointReadHistogram(&gRestore, &gDispatchHist);
+    MetricsPage metrics;
+    CheckpointRead(&gRestore, &metrics.mArrivals, sizeof(MetricsPage) - offsetof(MetricsPage, mArrivals));
+    if (gpMetrics && !gRestore.mFailed)
+        memcpy(&gpMetrics->mArrivals, &metrics.mArrivals, sizeof(MetricsPage) - offsetof(MetricsPage, mArrivals));
+
+    if (!gRestore.mFailed && (gpMemEngine->mpLoad(gRestore.mpFile) || SlabLoad(&gSlabCache, gRestore.mpFile) ||
+                              MemPoolsLoad(gPools, gPoolCount, gRestore.mpFile)))
+        gRestore.mFailed = 1;
+    if (CheckpointClose(&gRestore))
+        RestoreFailed("the snapshot is damaged or cut short");
+    PublishMemory();
+    METRIC_SET(mReadyLength, ReadyLength(&gReady));
+    METRIC_SET(mResident, gResident);
+
+    if (running < 0)
+        return;
+    gpCurrentProcess = &gProcessTable.mpProcesses[running]; //in range, it was checked with the table
+    REMAIN(gpCurrentProcess) = remain;
+    gSliceStart = gpCurrentProcess->mRuntime - remain; //a fresh quantum
+    gSwitchContext = 0;
+    StartWorker(remain);
+    METRIC_SET(mRunningId, running);
+    METRIC_SET(mRunningRemain, (int) remain);
+    ArmResize();
+}
+
 void ChildHandler(int signum) {
-    if (!waitpid(gpCurrentProcess->mPid, NULL, WNOHANG)) //if current process did not terminate
+    //several SIGCHLDs may coalesce into one, so drain every pending child status instead of only the current one
+    Process *finished[REAP_BATCH];
+    int count = 0;
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        if (!WIFEXITED(status) && !WIFSIGNALED(status)) //only terminations free a process
+            continue;
+        Process *pProcess = PidIndexRemove(&gPidIndex, pid);
+        if (!pProcess) { //not running a job, so it was a parked worker
+            WorkerPoolForget(&gWorkerPool, pid);
+            continue;
+        }
+        finished[count++] = pProcess;
+        if (count == REAP_BATCH) { //batch is full, release it before reaping more
+            ReleaseFinished(finished, count);
+            count = 0;
+        }
+    }
+    ReleaseFinished(finished, count);
+}
+
+void ResizeHandler(int signum) {
+    Process *pProcess = gpCurrentProcess;
+    if (!pProcess || STATE(pProcess) != RUNNING || !pProcess->mResizeAt)
+        return;
+    //ticks this process has run so far, same bookkeeping as the arrival handler
+    int ran = (int) (TraceClock() - (pProcess->mArrivalTime + pProcess->mWaitTime));
+    //the timer and the clock process count the same tick length from different starts, so the timer may fire a
+    //little before the clock reaches the tick
+    if (ran < (int) pProcess->mResizeAt) {
+        SetResizeTimer((int) pProcess->mResizeAt - ran);
+        return;
+    }
+    TraceResize(pProcess);
+    ResizeProcessMem(pProcess);
+}
+
+void ArmResize() { //schedule the resize of the process that just started or resumed, if it still has one coming
+    if (!gpCurrentProcess->mResizeAt || gTrace.mMode == TRACE_REPLAY) //a replay resizes where the trace says
         return;
-    FreeMem(gpCurrentProcess->mMemAddr, gpCurrentProcess->mMemAlloc);  //free memory allocated for this process
-    gSwitchContext = 1; //set flag to 1 so main loop knows it's time to switch context
-    gpCurrentProcess->mRemainTime = 0; //process finished so remaining time should be zero
-    AddEvent(FINISH);
+    int delay = (int) gpCurrentProcess->mResizeAt - (int) (gpCurrentProcess->mRuntime - REMAIN(gpCurrentProcess));
+    SetResizeTimer(delay > 0 ? delay : 1);
+}
+
+void SetResizeTimer(int ticks) { //SIGALRM after that many clock ticks of wall time, 0 cancels a pending one
+    long long us = (long long) ticks * gOptions.mTickUs;
+    struct itimerval timer = {{0, 0}, {(time_t) (us / 1000000), (suseconds_t) (us % 1000000)}};
+    setitimer(ITIMER_REAL, &timer, NULL);
+}
+
+void ReleaseFinished(Process **pFinished, int count) {
+    TraceExits(pFinished, count);
+    Process *holders[REAP_BATCH]; //a job killed while swapped out has no memory to return
+    int held = 0;
+    for (int i = 0; i < count; ++i)
+        if (!pFinished[i]->mSwapped)
+            holders[held++] = pFinished[i];
+    FreeProcessMemBatch(holders, held); //return the memory of the whole batch first
+
+    for (int i = 0; i < count; ++i) {
+        Process *pProcess = pFinished[i];
+        REMAIN(pProcess) = 0; //process finished so remaining time should be zero
+        STATE(pProcess) = FINISHED;
+        if (pProcess == gpCurrentProcess) {
+            gSwitchContext = 1; //set flag to 1 so main loop knows it's time to switch context
+            METRIC_SET(mRunningId, 0);
+        }
+        Event *pEvent = AddProcessEvent(FINISH, pProcess);
+        MetricsFinished(pEvent->mCurrentWaitTime, pEvent->mWTaTime);
+    }
+    PublishMemory();
 }
 
 void LogEvents(unsigned int start_time, unsigned int end_time) {  //prints all events in the terminal
     unsigned int runtime_sum = 0, waiting_sum = 0, count = 0;
-    double wta_sum = 0, wta_squared_sum = 0;
+    unsigned int swapped = 0, swapped_waiting = 0; //finished processes that were swapped out at least once
+    double swapped_wta = 0, other_wta = 0;
 
-    FILE *pFile = fopen("Events.txt", "w");
+    FILE *pFile = OpenOutput("Events");
     Event *pEvent = NULL;
     while (EventQueueDequeue(gEventQueue, &pEvent)) { //while event queue is not empty
-        PrintEvent(pEvent);
+        if (gLogLevel >= LOG_DEBUG) //Events.txt has them all already
+            PrintEvent(pEvent);
         OutputEvent(pEvent, pFile);
         if (pEvent->mType == FINISH) {
             runtime_sum += pEvent->mpProcess->mRuntime;
             waiting_sum += pEvent->mCurrentWaitTime;
             count++;
-            wta_sum += pEvent->mWTaTime;
-            wta_squared_sum += pEvent->mWTaTime * pEvent->mWTaTime;
-            free(pEvent->mpProcess);
+            if (pEvent->mpProcess->mSwapOuts) {
+                swapped++;
+                swapped_waiting += pEvent->mCurrentWaitTime;
+                swapped_wta += pEvent->mWTaTime;
+            } else {
+                other_wta += pEvent->mWTaTime;
+            }
         }
         free(pEvent); //free memory allocated by the event
     }
     fclose(pFile);
+    ProcessTableDestroy(&gProcessTable); //no event refers to a process anymore
     //cpu utilization = useful time / total time
-    double cpu_utilization = runtime_sum * 100.0 / (end_time - start_time);
-    double avg_wta = wta_sum / count;
-    double avg_waiting = (double) waiting_sum / count;
-    double std_wta = sqrt((wta_squared_sum - (2 * wta_sum * avg_wta) + (avg_wta * avg_wta * count)) / count);
+    double cpu_utilization = end_time > start_time ? runtime_sum * 100.0 / (end_time - start_time) : 0;
+    double avg_wta = gWtaHist.mMean; //running mean and variance, no sums of squares to cancel out
+    double avg_waiting = count ? (double) waiting_sum / count : 0; //a cluster node may get no process
+    double std_wta = HistogramStd(&gWtaHist);
 
-    pFile = fopen("Stats.txt", "w");
-    printf("\nCPU utilization = %.2f\n", cpu_utilization);
-    printf("Avg WTA = %.2f\n", avg_wta);
-    printf("Avg Waiting = %.2f\n", avg_waiting);
-    printf("STD WTA = %.2f\n\n", std_wta);
+    pFile = OpenOutput("Stats");
+    LOG(LOG_INFO, "\nCPU utilization = %.2f\n", cpu_utilization);
+    LOG(LOG_INFO, "Avg WTA = %.2f\n", avg_wta);
+    LOG(LOG_INFO, "Avg Waiting = %.2f\n", avg_waiting);
+    LOG(LOG_INFO, "STD WTA = %.2f\n\n", std_wta);
 
     fprintf(pFile, "Avg Waiting = %.2f\n", avg_waiting);
     fprintf(pFile, "\nCPU utilization = %.2f\n", cpu_utilization);
     fprintf(pFile, "Avg WTA = %.2f\n", avg_wta);
     fprintf(pFile, "STD WTA = %.2f\n\n", std_wta);
+    PrintPercentiles(pFile, "Waiting", &gWaitHist, 0);
+    PrintPercentiles(pFile, "TA", &gTaHist, 0);
+    PrintPercentiles(pFile, "WTA", &gWtaHist, 2);
+    PrintPercentiles(pFile, "Dispatch us", &gDispatchHist, 0);
+    fprintf(pFile, "\n");
+    fprintf(pFile, "Peak resident processes = %d\n", gPeakResident);
+    fprintf(pFile, "Failed allocations = %u\n", gFailedAllocs);
+    fprintf(pFile, "Compactions = %u, bytes moved = %u, ticks charged = %u\n", gCompactions, gBytesMoved,
+            gCompactTicks);
+    fprintf(pFile, "Resizes = %u, in place = %u, failed = %u\n", gResizes, gInPlaceResizes, gFailedResizes);
+    fprintf(pFile, "Swap outs = %u, swap ins = %u, bytes swapped = %u, ticks charged = %u\n", gSwapOuts, gSwapIns,
+            gBytesSwapped, gSwapTicks);
+    if (gOptions.mSwapCost > 0) //what swapping did to the jobs it moved, against the ones it left in memory
+        fprintf(pFile, "Swapped processes = %u, avg waiting = %.2f, avg WTA = %.2f; others = %u, avg waiting = %.2f, "
+                       "avg WTA = %.2f\n", swapped, swapped ? (double) swapped_waiting / swapped : 0,
+                swapped ? swapped_wta / swapped : 0, count - swapped,
+                count > swapped ? (double) (waiting_sum - swapped_waiting) / (count - swapped) : 0,
+                count > swapped ? other_wta / (count - swapped) : 0);
+    fprintf(pFile, "Scheduling policy = %s", gReady.mpPolicy->mpName);
+    if (gReady.mpPolicy->mSliced)
+        fprintf(pFile, ", quantum = %d", gOptions.mQuantum);
+    if (gOptions.mPolicy == POLICY_AGING)
+        fprintf(pFile, ", aging = %d", gOptions.mAging);
+    fprintf(pFile, "\nContext switches = %u, preemptions = %u\n", gContextSwitches, gPreemptions);
+    fprintf(pFile, "Finished processes = %u in %u ticks, throughput = %.3f per tick\n", count, end_time - start_time,
+            end_time > start_time ? (double) count / (end_time - start_time) : 0);
+    fprintf(pFile, "Memory engine = %s\n", gpMemEngine->mpName);
+    struct rusage usage; //the scheduler alone, workers are separate processes
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(pFile, "Scheduler cpu = %.3f s user, %.3f s system, peak RSS = %ld KB\n",
+            usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6, usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+            usage.ru_maxrss);
+    if (gpBuddy) {
+        BuddyStats buddy_stats = BuddyGetStats(gpBuddy);
+        fprintf(pFile, "Buddy splits = %lu, avoided = %lu\n", buddy_stats.mSplits, buddy_stats.mSplitsAvoided);
+        fprintf(pFile, "Buddy merges = %lu, avoided = %lu\n", buddy_stats.mMerges, buddy_stats.mMergesAvoided);
+    }
+    if (gPoolCount)
+        fprintf(pFile, "Pool placement = %s\n", gpPlacementNames[gOptions.mPlacement]);
+    for (int i = 0; i < gPoolCount; ++i) {
+        BuddyStats buddy_stats = BuddyGetStats(gPools[i].mpBuddy);
+        fprintf(pFile, "Pool %d: %d bytes on cpu %d, allocations = %u, failed = %u, peak used = %d bytes, "
+                       "splits = %lu, merges = %lu\n", i, gPools[i].mSize, gPools[i].mCpu, gPools[i].mAllocs,
+                gPools[i].mFailedAllocs, gPools[i].mPeakUsed, buddy_stats.mSplits, buddy_stats.mMerges);
+    }
+    if (gTrace.mMode == TRACE_REPLAY) {
+        fprintf(pFile, "Replay divergences = %lu\n", gTrace.mDivergences);
+        LOG(LOG_INFO, "Replay divergences = %lu\n", gTrace.mDivergences);
+    }
+    fclose(pFile);
+    if (gOptions.mNode >= 0) { //the coordinator merges the runs of all nodes
+        NodeReport report = {NODE_SUMMARY};
+        report.mSummary = (NodeSummary) {count, runtime_sum, waiting_sum, start_time, end_time, gPeakResident,
+                                         gFailedAllocs, usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+                                         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6, usage.ru_maxrss,
+                                         gSwapOuts, gSwapIns, gBytesSwapped, gSwapTicks, gContextSwitches,
+                                         gPreemptions, gWaitHist, gTaHist, gWtaHist, gDispatchHist};
+        if (ClusterReport(CLUSTER_SOCKET_FD, &report))
+            perror("SRTN: *** Error sending the summary to the coordinator");
+    }
+}
+
+FILE *OpenOutput(const char *pName) { //Name.txt, Name.N.txt on node N of a cluster
+    char path[64];
+    if (gOptions.mNode >= 0)
+        snprintf(path, sizeof(path), "%s.%d.txt", pName, gOptions.mNode);
+    else
+        snprintf(path, sizeof(path), "%s.txt", pName);
+    return fopen(path, "w");
 }
 
 void AddEvent(enum EventType type) {
+    AddProcessEvent(type, gpCurrentProcess);
+}
+
+Event *AddProcessEvent(enum EventType type, Process *pProcess) {
     Event *pEvent = malloc(sizeof(Event));
     while (!pEvent) {
         perror("RR: *** Malloc failed");
-        printf("RR: *** Trying again");
+        LOG(LOG_ERROR, "RR: *** Trying again\n");
         pEvent = malloc(sizeof(Event));
     }
-    pEvent->mTimeStep = getClk();
+    pEvent->mTimeStep = TraceClock();
     if (type == FINISH) {
-        pEvent->mTaTime = getClk() - gpCurrentProcess->mArrivalTime;
-        pEvent->mWTaTime = (double) pEvent->mTaTime / gpCurrentProcess->mRuntime;
+        pEvent->mTaTime = TraceClock() - pProcess->mArrivalTime;
+        pEvent->mWTaTime = (double) pEvent->mTaTime / pProcess->mRuntime;
+        HistogramRecord(&gWaitHist, pProcess->mWaitTime);
+        HistogramRecord(&gTaHist, pEvent->mTaTime);
+        HistogramRecord(&gWtaHist, pEvent->mWTaTime);
+        HistogramRecord(&gDispatchHist, pProcess->mDispatchUs);
     }
-    pEvent->mpProcess = gpCurrentProcess;
-    pEvent->mCurrentWaitTime = gpCurrentProcess->mWaitTime;
+    pEvent->mpProcess = pProcess;
+    pEvent->mCurrentWaitTime = pProcess->mWaitTime;
     pEvent->mType = type;
-    pEvent->mCurrentRemTime = gpCurrentProcess->mRemainTime;
+    pEvent->mCurrentRemTime = REMAIN(pProcess);
+    pEvent->mMemAddr = MEM_ADDR(pProcess);
+    pEvent->mMemPool = gPoolCount ? pProcess->mMemPool : -1;
+    pEvent->mMemSize = pProcess->mMemSize;
+    pEvent->mMemAlloc = pProcess->mMemAlloc;
     EventQueueEnqueue(gEventQueue, pEvent);
+    return pEvent;
 }
 
 void InitMemList() {
-    //we have 8 different allocation sizes starting from 2 bytes up to 256 bytes
+    //the default engine manages 1024 bytes as four 256 byte roots at addresses 0, 256, 512 and 768
     //because a process only requests memory <= 256 bytes, so no need for bigger chunks of memory
-    for (int i = 0; i < 8; ++i)
-        gFreeMemList[i] = NewList();
-
-    //we have four 256 partitions at addresses 0, 256, 512, and 768
-    for (int i = 0; i < 1024; i += 256)
-        InsertSort(gFreeMemList[7], i);
+    gpMemEngine = FindMemEngine(gOptions.mpMemVariant);
+    if (gpMemEngine->mpInit()) { //the engines report no reason
+        LOG(LOG_ERROR, "SRTN: *** Error creating the %s memory engine\n", gpMemEngine->mpName);
+        exit(EXIT_FAILURE);
+    }
+    gpBuddy = gpMemEngine->mpInit == LibraryEngineInit ? gpEngineBuddy : NULL;
+    if (!gpBuddy && (gOptions.mLazyBuddy || gOptions.mCompactCost > 0 || gOptions.mPoolCount))
+        LOG(LOG_ERROR, "SRTN: *** --lazy-buddy, --compact and --pools need the buddy engine, ignored on %s\n",
+            gpMemEngine->mpName);
+    if (gOptions.mLazyBuddy && gpBuddy)
+        BuddySetLazy(gpBuddy, gOptions.mLazyBuddy);
+    //a slab is found from a chunk address as address / SLAB_SIZE, only binary blocks are aligned to their size
+    if (gOptions.mSlab && gpMemEngine->mpAlloc == SplitEngineAlloc) {
+        LOG(LOG_ERROR, "SRTN: *** --slab needs a binary buddy engine, ignored on %s\n", gpMemEngine->mpName);
+        gOptions.mSlab = false;
+    }
+    if (!gpBuddy || !gOptions.mPoolCount)
+        return;
+    //every pool is a buddy allocator of its own, the engine's pool stays unused
+    if (gOptions.mSlab || gOptions.mCompactCost > 0) {
+        LOG(LOG_ERROR, "SRTN: *** --slab and --compact need a single pool, ignored with --pools\n");
+        gOptions.mSlab = false;
+        gOptions.mCompactCost = 0;
+    }
+    if (MemPoolsCreate(gPools, gOptions.mPoolSizes, gOptions.mPoolCount)) {
+        perror("SRTN: *** Error creating the memory pools");
+        exit(EXIT_FAILURE);
+    }
+    gPoolCount = gOptions.mPoolCount;
+    for (int i = 0; i < gPoolCount && gOptions.mLazyBuddy; ++i)
+        BuddySetLazy(gPools[i].mpBuddy, gOptions.mLazyBuddy);
+    gpBuddy = NULL; //the features that only know one allocator see none
 }
 
 int AllocateMem(int mem_size) {
-    int desired_index = (int) log2(mem_size) - 1; //calculate the index of the list containing this allocation size
-    int found_index = desired_index; //start searching in the desired list
-    while (IsListEmpty(gFreeMemList[found_index])) { //as long as no allocation of this size is available in this list
-        found_index++; //increment index to search in the next list with larger allocation unit
+    return gpMemEngine->mpAlloc(mem_size); //address of the smallest fitting block, -1 if none is free
+}
 
-        if (found_index > 7) //no memory is available so reject this allocation request
-            return -1;
+void FreeMem(int mem_addr, int mem_size) {
+    gpMemEngine->mpFree(mem_addr); //the engine knows the block size from its address
+}
+
+int AllocateProcessMem(Process *pProcess) {
+    int addr;
+    sigset_t old_set;
+    BlockHandlers(&old_set); //the child handler frees memory, it must not run while the allocator lock is held
+    if (gPoolCount)
+        addr = MemPoolAlloc(gPools, gPoolCount, gOptions.mPlacement, (int) pProcess->mMemAlloc,
+                            MemPoolHome(gPoolCount, (int) pProcess->mId), &pProcess->mMemPool);
+    else if (gOptions.mSlab)
+        addr = SlabAlloc(&gSlabCache, pProcess->mMemSize);
+    else
+        addr = AllocateMem(pProcess->mMemAlloc);
+    RestoreHandlers(&old_set);
+    TraceAlloc(pProcess, addr);
+    if (addr == -1) {
+        gFailedAllocs++;
+        METRIC_ADD(mFailedAllocs, 1);
+        return -1;
     }
+    if (++gResident > gPeakResident)
+        gPeakResident = gResident;
+    METRIC_ADD(mAllocs, 1);
+    PublishMemory();
+    return addr;
+}
+
+bool ProcessMemMayFit(const Process *pProcess) { //enough bytes are free where the process may be placed
+    if (gPoolCount)
+        return MemPoolFits(gPools, gPoolCount, gOptions.mPlacement, (int) pProcess->mMemAlloc,
+                           MemPoolHome(gPoolCount, (int) pProcess->mId));
+    return (int) pProcess->mMemAlloc <= gpMemEngine->mpFreeBytes();
+}
+
+BuddyAllocator *ProcessBuddy(const Process *pProcess) { //library allocator holding the process memory, NULL if none
+    return gPoolCount ? gPools[pProcess->mMemPool].mpBuddy : gpBuddy;
+}
 
-    //if the free memory is in a list of a bigger allocation unit we need to split this large block to our desired size
-    while (found_index != desired_index) { //keep splitting bigger blocks until we find a suitable block
-        NODE node = RemHead(gFreeMemList[found_index]); //get the first available memory block in the current list
-        int addr = node->data; //store the address of the memory block
-        free(node); //remove this block from this unit as it will be divided in half
-        int current_alloc = pow(2, found_index + 1); //calculate the block size of the current unit
-        int split_addr = (2 * addr + current_alloc) / 2; //calculate the address which divides the block in half
-        //int split_addr = (addr + current_alloc) / 2; //calculate the address which divides the block in half
-        found_index--; //go down one allocation unit
-        //store the two new blocks in the smaller allocation unit
-        InsertSort(gFreeMemList[found_index], split_addr);
-        InsertSort(gFreeMemList[found_index], addr);
+void FreeProcessMem(Process *pProcess) {
+    if (gPoolCount)
+        MemPoolFree(&gPools[pProcess->mMemPool], MEM_ADDR(pProcess), (int) pProcess->mMemAlloc);
+    else if (gOptions.mSlab)
+        SlabFree(&gSlabCache, MEM_ADDR(pProcess), pProcess->mMemAlloc);
+    else
+        FreeMem(MEM_ADDR(pProcess), pProcess->mMemAlloc);
+    gResident--;
+}
+
+/*
+** void ResizeProcessMem(Process *pProcess)
+** give a running process the memory size it asked for, keeping its address when the buddy allows it
+** otherwise it moves to a new block, and if none is free it keeps running with the memory it has
+*/
+void ResizeProcessMem(Process *pProcess) {
+    sigset_t old_set;
+    BlockHandlers(&old_set);
+    int size = (int) pProcess->mResizeSize;
+    int alloc = gOptions.mSlab ? SlabRound(&gSlabCache, size) : gpMemEngine->mpRound(size);
+    //slab chunks have no buddies, only plain buddy blocks can change size in place
+    BuddyAllocator *pBuddy = ProcessBuddy(pProcess);
+    bool buddy_backed = pBuddy && (!gOptions.mSlab || (SlabClass(&gSlabCache, (int) pProcess->mMemSize, NULL) == -1 &&
+                                                       SlabClass(&gSlabCache, size, NULL) == -1));
+    bool done = alloc == (int) pProcess->mMemAlloc; //the block it has already fits
+    int old_addr = MEM_ADDR(pProcess);
+    if (!done && buddy_backed && !BuddyResize(pBuddy, MEM_ADDR(pProcess), alloc))
+        done = true;
+    if (!done) { //take the new block before giving back the old one so a failure leaves the process untouched
+        int addr;
+        if (gPoolCount) //stays in its pool, the cpu it may be pinned to is local to it
+            addr = BuddyAlloc(pBuddy, alloc);
+        else
+            addr = gOptions.mSlab ? SlabAlloc(&gSlabCache, size) : AllocateMem(alloc);
+        if (addr != -1) {
+            if (gPoolCount)
+                BuddyFree(pBuddy, MEM_ADDR(pProcess));
+            else if (gOptions.mSlab)
+                SlabFree(&gSlabCache, MEM_ADDR(pProcess), pProcess->mMemAlloc);
+            else
+                FreeMem(MEM_ADDR(pProcess), pProcess->mMemAlloc);
+            MEM_ADDR(pProcess) = addr;
+            done = true;
+        }
+    }
+    if (done) {
+        if (gPoolCount) {
+            MemPool *pPool = &gPools[pProcess->mMemPool];
+            if ((pPool->mUsed += alloc - (int) pProcess->mMemAlloc) > pPool->mPeakUsed)
+                pPool->mPeakUsed = pPool->mUsed;
+        }
+        pProcess->mMemSize = size;
+        pProcess->mMemAlloc = alloc;
+        gResizes++;
+        if (MEM_ADDR(pProcess) == old_addr)
+            gInPlaceResizes++;
+        AddProcessEvent(RESIZE, pProcess);
+    } else {
+        gFailedResizes++;
     }
-    //after the above loop we are sure that a block of the desired size is available
-    NODE node = RemHead(gFreeMemList[desired_index]); //get the first available memory block
-    int addr = node->data; //store the address of the memory block
-    free(node); //remove this block from this unit as it will be allocated to the requesting process
-    gFreeMem -= mem_size; //subtract this block size from the free memory
-    return addr; //return the address of this block to the requesting process
+    pProcess->mResizeAt = 0; //resizes happen once
+    PublishMemory();
+    RestoreHandlers(&old_set);
 }
 
-void FreeMem(int mem_addr, int mem_size) {
-    int index = (int) log2(mem_size) - 1; //calculate the index of the list containing this allocation size
-    InsertSort(gFreeMemList[index], mem_addr); //add this memory address to the corresponding list
-
-    while (index < 7) //if this block is less than 256 in size then we might need to join small blocks
-    {
-        NODE node = GetHead(gFreeMemList[index]); //get the first memory block in this list
-        int current_mem_size = (int) pow(2, index + 1); //calculate the block size of the current unit
-        while (node->succ != NULL) { //traverse this list until the tail's predecessor has been visited
-            //if this is a valid merge(index of this address is even and next address is exactly after one block)
-            if (IsEven(node->data / mem_size) && (node->succ->data - node->data) == current_mem_size) {
-                InsertSort(gFreeMemList[index + 1], node->data); //add the address of first block to the larger list
-                NODE temp = node->succ->succ; //get the first block after the two blocks that will be merged together
-                //remove both blocks from the current list as they have been merged into one in the next list
-                free(RemoveNode(gFreeMemList[index], node->succ));
-                free(RemoveNode(gFreeMemList[index], node));
-                //next node to traverse from is the one after the two merged blocks
-                node = temp;
-                if (!temp) //if this node is NULL then there are no more blocks to inspect in this list
-                    break;
-                continue; //otherwise start loop from beg and inspect the next node
-            }
-            node = node->succ; //iterate to the next node to insepct it
+/*
+** int addr = CompactMemory(Process *pProcess)
+** move the memory of stopped processes out of one aligned region so a block for pProcess forms there, return its
+** address or -1. regions are tried from the fewest bytes to move, each move is planned on a copy of the allocator
+** and only done if moving costs fewer ticks than the shortest remaining time of any memory holder. that is a lower
+** bound heuristic for the wait without compaction: the holder that finishes first may not free a block big enough.
+** holders are found in the process table, so stopped processes restored from a checkpoint count too.
+** the cpu stays idle while memory is moved, so the cost is charged by waiting that many ticks before dispatching
+*/
+int CompactMemory(Process *pProcess) {
+    int size = pProcess->mMemAlloc;
+    //slab chunks do not move, only the library allocator can be copied to plan on, and no layout would fit
+    if (gOptions.mSlab || !gpBuddy || size > BuddyFreeBytes(gpBuddy))
+        return -1;
+    sigset_t old_set;
+    BlockHandlers(&old_set); //nobody may finish and free memory while it is moved
+    int regions = gpBuddy->mPoolSize / size;
+    int *pRegionCost = calloc(regions, sizeof(int)); //bytes to move out of every region, -1 if something pins it
+    Process **pEvict = malloc(gProcessTable.mSize * sizeof(Process *));
+    int *pAddrs = malloc(gProcessTable.mSize * sizeof(int));
+    int min_remain = INT_MAX;
+    for (unsigned int i = 0; i < gProcessTable.mSize; ++i) {
+        Process *pHolder = &gProcessTable.mpProcesses[i];
+        if (!HoldsMemory(pHolder))
+            continue;
+        if (REMAIN(pHolder) < min_remain)
+            min_remain = REMAIN(pHolder);
+        for (int r = MEM_ADDR(pHolder) / size; r * size < MEM_ADDR(pHolder) + pHolder->mMemAlloc; ++r)
+            if (pRegionCost[r] != -1)
+                pRegionCost[r] = STATE(pHolder) == STOPPED ? pRegionCost[r] + pHolder->mMemAlloc : -1;
+    }
+
+    int addr = -1;
+    while (addr == -1) {
+        int best = -1;
+        for (int r = 0; r < regions; ++r)
+            if (pRegionCost[r] != -1 && (best == -1 || pRegionCost[r] < pRegionCost[best]))
+                best = r;
+        if (best == -1 || (int) ceil(pRegionCost[best] * gOptions.mCompactCost) >= min_remain)
+            break; //nothing left to try, or waiting is cheaper than any remaining move
+        int count = 0;
+        for (unsigned int i = 0; i < gProcessTable.mSize; ++i) {
+            Process *pHolder = &gProcessTable.mpProcesses[i];
+            if (HoldsMemory(pHolder) && MEM_ADDR(pHolder) < (best + 1) * size &&
+                MEM_ADDR(pHolder) + pHolder->mMemAlloc > best * size)
+                pEvict[count++] = pHolder;
+        }
+        pRegionCost[best] = -1;
+        qsort(pEvict, count, sizeof(Process *), CompareMemAlloc); //largest first so big blocks still find room
+
+        BuddyAllocator *pTrial = BuddyClone(gpBuddy);
+        if (!pTrial)
+            break;
+        int trial = CompactOn(pTrial, pEvict, count, size, pAddrs);
+        BuddyDestroy(pTrial);
+        if (trial == -1)
+            continue;
+        int moved = 0;
+        for (int i = 0; i < count; ++i)
+            if (pAddrs[i] != MEM_ADDR(pEvict[i]))
+                moved += pEvict[i]->mMemAlloc;
+        int cost = (int) ceil(moved * gOptions.mCompactCost);
+        if (cost >= min_remain)
+            continue;
+
+        //replay the plan for real, the allocator is deterministic so it ends the same way
+        addr = CompactOn(gpBuddy, pEvict, count, size, pAddrs);
+        for (int i = 0; i < count; ++i) {
+            if (pAddrs[i] == MEM_ADDR(pEvict[i]))
+                continue;
+            int old_addr = MEM_ADDR(pEvict[i]);
+            MEM_ADDR(pEvict[i]) = pAddrs[i];
+            AddProcessEvent(RELOCATE, pEvict[i])->mOldMemAddr = old_addr;
         }
-        index++; //after finishing inspecting the current list increment index to go the next list
+        gCompactions++;
+        gBytesMoved += moved;
+        gCompactTicks += cost;
+        WaitTicks(cost);
+        if (++gResident > gPeakResident)
+            gPeakResident = gResident;
+        METRIC_ADD(mAllocs, 1);
+        PublishMemory();
     }
-    gFreeMem += mem_size; //add the freed memory to the free memory variable
+    free(pRegionCost);
+    free(pEvict);
+    free(pAddrs);
+    RestoreHandlers(&old_set);
+    return addr;
+}
+
+bool HoldsMemory(const Process *pProcess) { //running or stopped and not swapped out
+    return gProcessTable.mpArrived[pProcess->mId] && (STATE(pProcess) == RUNNING || STATE(pProcess) == STOPPED) &&
+           !pProcess->mSwapped;
+}
+
+/*
+** int addr = CompactOn(BuddyAllocator *pBuddy, Process **pMovable, int count, int size, int *pAddrs)
+** free the blocks of pMovable, allocate size bytes, then allocate the freed blocks again in order
+** the new addresses go to pAddrs, returns the address of the new block or -1 if anything did not fit
+*/
+int CompactOn(BuddyAllocator *pBuddy, Process **pMovable, int count, int size, int *pAddrs) {
+    for (int i = 0; i < count; ++i)
+        pAddrs[i] = MEM_ADDR(pMovable[i]);
+    BuddyFreeMany(pBuddy, pAddrs, count);
+    int addr = BuddyAlloc(pBuddy, size);
+    for (int i = 0; i < count; ++i)
+        if ((pAddrs[i] = BuddyAlloc(pBuddy, pMovable[i]->mMemAlloc)) == -1)
+            addr = -1;
+    return addr;
+}
+
+int CompareMemAlloc(const void *pLeft, const void *pRight) { //larger blocks first, ties by id to stay deterministic
+    const Process *pA = *(Process *const *) pLeft, *pB = *(Process *const *) pRight;
+    if (pA->mMemAlloc != pB->mMemAlloc)
+        return pB->mMemAlloc - pA->mMemAlloc;
+    return pA->mId - pB->mId;
 }
 
-int IsEven(int num) {
-    if (num % 2 == 0)
+void WaitTicks(int ticks) { //the cpu stays idle, arrivals stay pending meanwhile and nothing runs they could preempt
+    if (ticks <= 0)
+        return;
+    int until = TraceClock() + ticks;
+    while (TraceClock() < until)
+        TraceWaitClk(gTrace.mClock);
+}
+
+/*
+** int count = SwapPools(const Process *pProcess, int *pOrder)
+** pools the placement may put pProcess in, in the order it tries them, one pool 0 standing for all memory without pools
+*/
+int SwapPools(const Process *pProcess, int *pOrder) {
+    if (!gPoolCount) {
+        pOrder[0] = 0;
         return 1;
+    }
+    return MemPoolOrder(gPools, gPoolCount, gOptions.mPlacement, MemPoolHome(gPoolCount, (int) pProcess->mId), pOrder);
+}
+
+int SwapPoolOf(const Process *pProcess) { //pool the memory of a process is in, 0 without pools
+    return gPoolCount ? pProcess->mMemPool : 0;
+}
+
+/*
+** int count = SwapVictims(const Process *pProcess, Process **pVictims)
+** stopped processes holding memory that the policy dispatches after pProcess, so they would not run before it anyway,
+** last to run first. they wait in the ready queue or, if they could not resume, in the temp queue, which goes back
+** behind the ready queue. with pools only those in a pool pProcess may be placed in free memory it can use
+*/
+int SwapVictims(const Process *pProcess, Process **pVictims) {
+    int pools[MAX_POOLS];
+    bool allowed[MAX_POOLS] = {false};
+    for (int i = SwapPools(pProcess, pools) - 1; i >= 0; --i)
+        allowed[pools[i]] = true;
+    int count = 0, len = ReadyLength(&gReady), position = len;
+    long order = ReadyOrder(&gReady, pProcess, -1);
+    for (int i = 0; i < len; ++i) {
+        Process *pStopped = ReadyAt(&gReady, i);
+        if (STATE(pStopped) == STOPPED && !pStopped->mSwapped && allowed[SwapPoolOf(pStopped)] &&
+            ReadyOrder(&gReady, pStopped, i) > order)
+            pVictims[count++] = pStopped;
+    }
+    for (node pNode = HEAD(gTempQueue); pNode; pNode = pNode->next, ++position)
+        if (STATE(pNode->val) == STOPPED && !pNode->val->mSwapped && allowed[SwapPoolOf(pNode->val)] &&
+            ReadyOrder(&gReady, pNode->val, position) > order)
+            pVictims[count++] = pNode->val;
+    if (gReady.mpPolicy->mpKey) {
+        qsort(pVictims, count, sizeof(Process *), CompareReadyKey);
+    } else { //collected front to back
+        for (int i = 0; i < count / 2; ++i) {
+            Process *pSwap = pVictims[i];
+            pVictims[i] = pVictims[count - 1 - i];
+            pVictims[count - 1 - i] = pSwap;
+        }
+    }
+    return count;
+}
+
+/*
+** int pool = SwapTarget(const Process *pProcess, Process **pVictims, int count, const Process *pStopping)
+** first pool, in placement order, with enough bytes free for pProcess once its victims there and pStopping, about to
+** be stopped, if it runs after pProcess are swapped out, -1 if there is none. 0 stands for all memory without pools
+*/
+int SwapTarget(const Process *pProcess, Process **pVictims, int count, const Process *pStopping) {
+    long bytes[MAX_POOLS];
+    int pools[MAX_POOLS], candidates = SwapPools(pProcess, pools);
+    for (int i = 0; i < candidates; ++i)
+        bytes[pools[i]] = gPoolCount ? BuddyFreeBytes(gPools[pools[i]].mpBuddy) : FreeBytes();
+    for (int i = 0; i < count; ++i) //victims are only taken from candidate pools
+        bytes[SwapPoolOf(pVictims[i])] += pVictims[i]->mMemAlloc;
+    if (pStopping && ReadyOrder(&gReady, pStopping, ReadyLength(&gReady)) > ReadyOrder(&gReady, pProcess, -1))
+        for (int i = 0; i < candidates; ++i) //goes back into the ready queue
+            if (pools[i] == SwapPoolOf(pStopping))
+                bytes[pools[i]] += pStopping->mMemAlloc;
+    for (int i = 0; i < candidates; ++i)
+        if (bytes[pools[i]] >= (long) pProcess->mMemAlloc)
+            return pools[i];
+    return -1;
+}
+
+/*
+** bool fits = SwapMayFit(const Process *pProcess, const Process *pStopping)
+** enough bytes would be free for pProcess in one pool it may be placed in once the stopped processes there and
+** pStopping, about to be stopped, that run after it are swapped out. the blocks may still be scattered, as with
+** ProcessMemMayFit
+*/
+bool SwapMayFit(const Process *pProcess, const Process *pStopping) {
+    if (gOptions.mSwapCost <= 0 || (int) pProcess->mMemAlloc > gMaxBlock)
+        return false;
+    Process **pVictims = malloc(gProcessTable.mSize * sizeof(Process *));
+    if (!pVictims)
+        return false;
+    int count = SwapVictims(pProcess, pVictims);
+    int pool = SwapTarget(pProcess, pVictims, count, pStopping);
+    free(pVictims);
+    return pool != -1;
+}
+
+/*
+** int addr = SwapOutFor(Process *pProcess)
+** write the memory of stopped processes that run after pProcess to the backing store, last to run first,
+** until a block for pProcess can be allocated, return its address or -1. only the first pool in which that frees
+** enough bytes gives up memory, nothing is swapped out if none would. the cpu stays idle while the blocks are
+** written, --swap ticks per byte
+*/
+int SwapOutFor(Process *pProcess) {
+    if (gOptions.mSwapCost <= 0 || (int) pProcess->mMemAlloc > gMaxBlock)
+        return -1;
+    sigset_t old_set;
+    BlockHandlers(&old_set); //nobody may finish and free memory while the victims are picked
+    Process **pVictims = malloc(gProcessTable.mSize * sizeof(Process *));
+    int count = pVictims ? SwapVictims(pProcess, pVictims) : 0;
+    int pool = pVictims ? SwapTarget(pProcess, pVictims, count, NULL) : -1;
+    int addr = -1, bytes = 0;
+    for (int i = 0; i < count && addr == -1 && pool != -1; ++i) {
+        Process *pVictim = pVictims[i];
+        if (SwapPoolOf(pVictim) != pool)
+            continue;
+        AddProcessEvent(SWAP_OUT, pVictim);
+        FreeProcessMem(pVictim);
+        MEM_ADDR(pVictim) = -1;
+        pVictim->mSwapped = true;
+        pVictim->mSwapOuts++;
+        bytes += (int) pVictim->mMemAlloc;
+        gSwapOuts++;
+        if (ProcessMemMayFit(pProcess)) //the freed blocks may not be buddies yet, try again with the next one then
+            addr = AllocateProcessMem(pProcess);
+    }
+    free(pVictims);
+    int cost = (int) ceil(bytes * gOptions.mSwapCost);
+    gBytesSwapped += bytes;
+    gSwapTicks += cost;
+    WaitTicks(cost);
+    PublishMemory();
+    RestoreHandlers(&old_set);
+    return addr;
+}
+
+/*
+** int error = SwapIn(Process *pProcess)
+** read the memory of a swapped out process back into a new block before it resumes, swapping out others if that
+** makes room, -1 if no block is free. the address may differ from the one it was swapped out of
+*/
+int SwapIn(Process *pProcess) {
+    int addr = AllocateProcessMem(pProcess);
+    if (addr == -1)
+        addr = SwapOutFor(pProcess);
+    if (addr == -1)
+        return -1;
+    sigset_t old_set;
+    BlockHandlers(&old_set);
+    MEM_ADDR(pProcess) = addr;
+    pProcess->mSwapped = false;
+    int cost = (int) ceil(pProcess->mMemAlloc * gOptions.mSwapCost);
+    gSwapIns++;
+    gBytesSwapped += pProcess->mMemAlloc;
+    gSwapTicks += cost;
+    AddProcessEvent(SWAP_IN, pProcess);
+    WaitTicks(cost);
+    RestoreHandlers(&old_set);
     return 0;
-}
\ No newline at end of file
+}
+
+int CompareReadyKey(const void *pLeft, const void *pRight) { //largest key of the policy first, ties by id
+    const Process *pA = *(Process *const *) pLeft, *pB = *(Process *const *) pRight;
+    int key_a = gReady.mpPolicy->mpKey(&gProcessTable, pA->mId, gReady.mAging);
+    int key_b = gReady.mpPolicy->mpKey(&gProcessTable, pB->mId, gReady.mAging);
+    if (key_a != key_b)
+        return key_a < key_b ? 1 : -1;
+    return pA->mId - pB->mId;
+}
+
+void FreeProcessMemBatch(Process **pProcesses, int count) { //count is at most REAP_BATCH
+    if ((gOptions.mSlab || !gpBuddy) && !gPoolCount) { //slabs free chunk by chunk, the variants block by block
+        for (int i = 0; i < count; ++i)
+            FreeProcessMem(pProcesses[i]);
+        return;
+    }
+    int addrs[REAP_BATCH];
+    if (!gPoolCount) {
+        for (int i = 0; i < count; ++i)
+            addrs[i] = MEM_ADDR(pProcesses[i]);
+        BuddyFreeMany(gpBuddy, addrs, count); //blocks finishing together are merged in one pass
+        gResident -= count;
+        return;
+    }
+    for (int pool = 0; pool < gPoolCount; ++pool) { //one batch per pool
+        int pool_count = 0;
+        for (int i = 0; i < count; ++i)
+            if (pProcesses[i]->mMemPool == pool) {
+                addrs[pool_count++] = MEM_ADDR(pProcesses[i]);
+                gPools[pool].mUsed -= (int) pProcesses[i]->mMemAlloc;
+            }
+        if (pool_count)
+            BuddyFreeMany(gPools[pool].mpBuddy, addrs, pool_count);
+    }
+    gResident -= count;
+}
+
+/*
+** void PublishMemory()
+** copy the resident count, free bytes and free blocks per order to the metrics page
+** orders are only known for the library allocator, with pools they are summed over all pools
+*/
+void PublishMemory() {
+    if (!gpMetrics)
+        return;
+    int counts[BUDDY_MAX_ORDERS], totals[METRICS_ORDERS] = {0}, orders = 0, free_bytes = 0, min_block = 0;
+    if (gPoolCount) {
+        min_block = gPools[0].mpBuddy->mMinBlock; //all pools split down to the same size
+        for (int i = 0; i < gPoolCount; ++i) {
+            orders = BuddyFreeCounts(gPools[i].mpBuddy, counts);
+            for (int order = 0; order < orders && order < METRICS_ORDERS; ++order)
+                totals[order] += counts[order];
+            free_bytes += BuddyFreeBytes(gPools[i].mpBuddy);
+        }
+    } else {
+        if (gpBuddy) {
+            min_block = gpBuddy->mMinBlock;
+            orders = BuddyFreeCounts(gpBuddy, counts);
+            for (int order = 0; order < orders && order < METRICS_ORDERS; ++order)
+                totals[order] = counts[order];
+        }
+        free_bytes = gpMemEngine->mpFreeBytes();
+    }
+    orders = orders < METRICS_ORDERS ? orders : METRICS_ORDERS;
+    for (int order = 0; order < orders; ++order)
+        METRIC_SET(mFreeBlocks[order], totals[order]);
+    METRIC_SET(mMinBlock, min_block);
+    METRIC_SET(mOrders, orders);
+    METRIC_SET(mFreeBytes, free_bytes);
+    METRIC_SET(mResident, gResident);
+}
+
+void InstallHandler(int signum, void (*pHandler)(int)) {
+    struct sigaction action;
+    action.sa_handler = pHandler;
+    action.sa_mask = gHandlerSignals; //handlers never interrupt each other
+    action.sa_flags = SA_RESTART;
+    sigaction(signum, &action, NULL);
+}
+
+void BlockHandlers(sigset_t *pOld) {
+    sigprocmask(SIG_BLOCK, &gHandlerSignals, pOld);
+}
+
+void RestoreHandlers(const sigset_t *pOld) {
+    sigprocmask(SIG_SETMASK, pOld, NULL);
+}
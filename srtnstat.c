@@ -0,0 +1,79 @@
+//
+// Live view of a running scheduler
+// attaches the metrics page read-only and prints one line per refresh until the scheduler is done, reading never
+// blocks or slows the scheduler.
+// usage: srtnstat.out [-i SECONDS] [-n COUNT]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "Headers/Metrics.h"
+
+const int *AttachClock() { //NULL if the clock is not running
+    int id = shmget(SHKEY, 4, 0444);
+    if (id == -1)
+        return NULL;
+    void *pClock = shmat(id, NULL, SHM_RDONLY);
+    return pClock == (void *) -1 ? NULL : pClock;
+}
+
+void PrintMetrics(const MetricsPage *pPage, const int *pClock) {
+    unsigned long finished = METRIC_READ(pPage, mFinished);
+    printf("clk %4d  ready %3d  running ", pClock ? __atomic_load_n(pClock, __ATOMIC_RELAXED) : -1,
+           METRIC_READ(pPage, mReadyLength));
+    int running = METRIC_READ(pPage, mRunningId);
+    if (running)
+        printf("%4d (%3d left)", running, METRIC_READ(pPage, mRunningRemain));
+    else
+        printf("%15s", "idle");
+    printf("  resident %3d  free %5d  allocs %5lu  failed %5lu  switches %5lu  done %5lu/%-5lu",
+           METRIC_READ(pPage, mResident), METRIC_READ(pPage, mFreeBytes), METRIC_READ(pPage, mAllocs),
+           METRIC_READ(pPage, mFailedAllocs), METRIC_READ(pPage, mContextSwitches), finished,
+           METRIC_READ(pPage, mArrivals));
+    printf("  wait %6.2f (%6.2f)  wta %5.2f (%5.2f)", METRIC_READ(pPage, mWaitRolling) / 1000.0,
+           finished ? METRIC_READ(pPage, mWaitSum) / 1000.0 / finished : 0, METRIC_READ(pPage, mWtaRolling) / 1000.0,
+           finished ? METRIC_READ(pPage, mWtaSum) / 1000.0 / finished : 0);
+    int orders = METRIC_READ(pPage, mOrders), min_block = METRIC_READ(pPage, mMinBlock);
+    if (orders)
+        printf("  |");
+    for (int order = 0; order < orders && order < METRICS_ORDERS; ++order)
+        printf(" %d:%d", min_block << order, METRIC_READ(pPage, mFreeBlocks[order]));
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    double interval = 1;
+    long count = 0; //0 until the scheduler is done
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:N:")) != -1) {
+        if (opt == 'i' && (interval = atof(optarg)) > 0)
+            continue;
+        if (opt == 'n' && (count = atol(optarg)) > 0)
+            continue;
+        if (opt == 'N' && atoi(optarg) >= 0) { //one scheduler of a cluster
+            gMetricsKey = METRICS_NODE_KEY(atoi(optarg));
+            continue;
+        }
+        fprintf(stderr, "usage: %s [-i SECONDS] [-n COUNT] [-N NODE]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const MetricsPage *pPage = MetricsAttach();
+    if (!pPage || METRIC_READ(pPage, mMagic) != METRICS_MAGIC) {
+        fprintf(stderr, "%s: no scheduler is publishing metrics\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    printf("scheduler %d, rolling averages with the mean of the run in parentheses\n",
+           METRIC_READ(pPage, mSchedulerPid));
+    const int *pClock = AttachClock();
+    struct timespec pause = {(time_t) interval, (long) ((interval - (time_t) interval) * 1e9)};
+    for (long i = 0; !count || i < count; ++i) {
+        PrintMetrics(pPage, pClock);
+        if (METRIC_READ(pPage, mDone))
+            break;
+        nanosleep(&pause, NULL);
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 #define null 0
+#define MAX_MEMSIZE 256 //largest block the scheduler can give a process, larger jobs would never run
 
 struct processData
 {
@@ -12,15 +14,46 @@ struct processData
     int id;
 };
 
+/*
+ * usage: test_generator.out [-n COUNT] [-s SEED] [-a MAX_GAP] [-r MAX_RUNTIME] [-m MAX_MEMSIZE]
+ * without -n the count is asked for, without -s the seed is the current time. The same seed and limits always
+ * write the same processes.txt, which is what the perf harness relies on.
+ */
 int main(int argc, char * argv[])
 {
     FILE * pFile;
-    pFile = fopen("processes.txt", "w");
-    int no;
     struct processData pData;
-    printf("Please enter the number of processes you want to generate: ");
-    scanf("%d", &no);
-    srand(time(null));
+    int no = 0, max_gap = 10, max_runtime = 30, max_memsize = 256;
+    unsigned int seed = time(null);
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:a:r:m:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': no = atoi(optarg); break;
+            case 's': seed = strtoul(optarg, NULL, 10); break;
+            case 'a': max_gap = atoi(optarg); break;
+            case 'r': max_runtime = atoi(optarg); break;
+            case 'm': max_memsize = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n COUNT] [-s SEED] [-a MAX_GAP] [-r MAX_RUNTIME] [-m MAX_MEMSIZE]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (max_gap < 0 || max_runtime < 1 || max_memsize < 1 || max_memsize > MAX_MEMSIZE)
+    {
+        fprintf(stderr, "%s: gaps are at least 0, runtimes at least 1 and sizes between 1 and %d\n", argv[0],
+                MAX_MEMSIZE);
+        return EXIT_FAILURE;
+    }
+    if (no <= 0)
+    {
+        printf("Please enter the number of processes you want to generate: ");
+        scanf("%d", &no);
+    }
+    pFile = fopen("processes.txt", "w");
+    srand(seed);
     //fprintf(pFile,"%d\n",no);
     fprintf(pFile, "#id arrival runtime priority memsize\n");
     pData.arrivaltime = 1;
@@ -29,10 +62,10 @@ int main(int argc, char * argv[])
         //generate Data Randomly
         //[min-max] = rand() % (max_number + 1 - minimum_number) + minimum_number
         pData.id = i;
-        pData.arrivaltime += rand() % (11); //processes arrives in order
-        pData.runningtime = 1 + rand() % (30);
+        pData.arrivaltime += rand() % (max_gap + 1); //processes arrives in order
+        pData.runningtime = 1 + rand() % (max_runtime);
         pData.priority = rand() % (11);
-        pData.memsize = 1 + rand() % 256;
+        pData.memsize = 1 + rand() % max_memsize;
         fprintf(pFile, "%d\t%d\t%d\t%d\t%d\n", pData.id, pData.arrivaltime, pData.runningtime, pData.priority, pData.memsize);
     }
     fclose(pFile);